@@ -0,0 +1,62 @@
+# vuml_add_shaders(<target> [EMBED_ONLY] <glsl files>...)
+#
+# Compile the GLSL shaders with glslangValidator and embed the SPIR-V in <target>, the shaders are then looked up by
+# the file name of their source with vuml::shaders::get("name.comp"), no .spv file has to be deployed next to the
+# binary.
+#
+# With EMBED_ONLY the shaders are not registered, the target includes "name.comp.h" itself and uses the array
+# vuml_shader_name_comp. Static libraries need it: nothing references a registration, so the linker drops it.
+
+function(vuml_add_shaders target)
+    cmake_parse_arguments(PARSE_ARGV 1 _vuml "EMBED_ONLY" "" "")
+    if (NOT GLSL_VALIDATOR)
+        find_program(GLSL_VALIDATOR glslangValidator)
+        if (NOT GLSL_VALIDATOR)
+            message(FATAL_ERROR "vuml_add_shaders(${target}) needs glslangValidator, install it or set GLSL_VALIDATOR")
+        endif ()
+    endif ()
+
+    set(_out_dir "${CMAKE_CURRENT_BINARY_DIR}/${target}_shaders")
+    set(_registry "${_out_dir}/${target}_shaders.cc")
+    set(_includes "")
+    set(_registrations "")
+    set(_headers "")
+    set(_index 0)
+
+    foreach (_glsl_file ${_vuml_UNPARSED_ARGUMENTS})
+        get_filename_component(_glsl_file ${_glsl_file} ABSOLUTE)
+        get_filename_component(_glsl_name ${_glsl_file} NAME)
+        string(MAKE_C_IDENTIFIER "vuml_shader_${_glsl_name}" _symbol)
+        set(_header "${_out_dir}/${_glsl_name}.h")
+        add_custom_command(
+                OUTPUT ${_header}
+                COMMAND ${CMAKE_COMMAND} -E make_directory "${_out_dir}"
+                COMMAND ${GLSL_VALIDATOR} -V ${_glsl_file} --vn ${_symbol} -o ${_header}
+                DEPENDS ${_glsl_file}
+                COMMENT "Embedding shader ${_glsl_name}")
+        list(APPEND _headers ${_header})
+        string(APPEND _includes "#include \"${_glsl_name}.h\"\n")
+        string(APPEND _registrations
+                "const ::vuml::shaders::Registration registration_${_index}(\"${_glsl_name}\", ${_symbol}, sizeof(${_symbol}));\n")
+        math(EXPR _index "${_index} + 1")
+    endforeach ()
+
+    if (_vuml_EMBED_ONLY)
+        add_custom_target(${target}_shaders DEPENDS ${_headers})
+        add_dependencies(${target} ${target}_shaders)
+        target_include_directories(${target} PRIVATE ${_out_dir})
+        return()
+    endif ()
+
+    set(_content "// generated by vuml_add_shaders(), do not edit\n\n#include <cstdint>\n\n#include \"vuml/shaders.h\"\n\n")
+    string(APPEND _content "${_includes}\nnamespace {\n\n${_registrations}\n} // namespace\n")
+    file(WRITE "${_registry}.in" "${_content}")
+    # only touch the source when the shader list changed
+    configure_file("${_registry}.in" "${_registry}" COPYONLY)
+
+    set_source_files_properties(${_registry} PROPERTIES OBJECT_DEPENDS "${_headers}")
+    add_custom_target(${target}_shaders DEPENDS ${_headers})
+    add_dependencies(${target} ${target}_shaders)
+    target_sources(${target} PRIVATE ${_registry})
+    target_include_directories(${target} PRIVATE ${_out_dir})
+endfunction()
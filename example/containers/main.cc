@@ -0,0 +1,139 @@
+//
+// Created by Homin Su on 2023/7/25.
+//
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <list>
+#include <tuple>
+#include <vector>
+
+#include "vuml/device.h"
+#include "vuml/image.h"
+#include "vuml/instance.h"
+#include "vuml/logger.h"
+#include "vuml/parallel.h"
+#include "vuml/program.h"
+#include "vuml/shaders.h"
+#include "vuml/soa_array.h"
+
+namespace {
+
+struct Params {
+  uint32_t size;
+  float a;
+};
+
+struct Point {
+  float y;
+  float x;
+
+  bool operator==(const Point &other) const { return y == other.y && x == other.x; }
+};
+
+int failures = 0;
+
+void check(bool ok, const char *what) {
+  if (!ok) {
+    ERROR("%s failed", what);
+    ++failures;
+  }
+}
+
+void soa(vuml::Device &device) {
+  const auto n = 10000u;
+  const auto a = 0.5f;
+  auto records = ::std::vector<::std::tuple<float, float>>(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    records[i] = {static_cast<float>(i), 2.0f};
+  }
+
+  // the fields bind as y and x of the saxpy shader
+  auto d_records = vuml::SoAArray<float, float>(device, records.begin(), records.end());
+  auto program = vuml::Program<vuml::type_list<uint32_t>, Params>(device, vuml::shaders::get("shader.comp"));
+  program.grid(vuml::div_up(n, 64u)).spec(64).run({n, a}, d_records);
+
+  auto result = ::std::vector<::std::tuple<float, float>>(n);
+  d_records.toHost(result.begin());
+  auto ok = true;
+  for (uint32_t i = 0; ok && i < n; ++i) {
+    ok = result[i] == ::std::make_tuple(static_cast<float>(i) + a * 2.0f, 2.0f);
+  }
+  check(ok, "soa saxpy");
+
+  // other records through split and join, from an iterator that only goes forward
+  auto points = ::std::list<Point>{};
+  for (uint32_t i = 0; i < n; ++i) {
+    points.push_back({static_cast<float>(i), -static_cast<float>(i)});
+  }
+  auto split = [](const Point &p) { return ::std::tie(p.y, p.x); };
+  auto join = [](float y, float x) { return Point{y, x}; };
+  auto d_points = vuml::SoAArray<float, float>(device, n);
+  d_points.fromHost(points.begin(), points.end(), split);
+  auto back = ::std::list<Point>(n);
+  d_points.toHost(back.begin(), join);
+  check(back == points, "soa round trip in order");
+
+  auto point_vector = ::std::vector<Point>(points.begin(), points.end());
+  auto d_par = vuml::SoAArray<float, float>(
+      device, vuml::parallel::par, point_vector.begin(), point_vector.end(), split
+  );
+  auto par_back = ::std::vector<Point>(n);
+  d_par.toHost(vuml::parallel::par, par_back.begin(), join);
+  check(par_back == point_vector, "soa round trip from the thread pool");
+}
+
+void images(vuml::Device &device) {
+  // odd sizes, the rows are not a multiple of any alignment
+  const auto width = 333u;
+  const auto height = 77u;
+
+  auto values = ::std::vector<float>(width * height);
+  for (::std::size_t i = 0; i < values.size(); ++i) {
+    values[i] = static_cast<float>(i) * 0.25f;
+  }
+  auto image = vuml::Image2D<float>(device, vk::Extent3D{width, height, 1}, values.begin(), values.end());
+  check(image.toHost<::std::vector<float>>() == values, "float image round trip");
+
+  auto pixels = ::std::vector<::std::array<uint8_t, 4>>(width * height);
+  for (::std::size_t i = 0; i < pixels.size(); ++i) {
+    pixels[i] = {static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i >> 16), 255};
+  }
+  auto rgba = vuml::Image2D<::std::array<uint8_t, 4>>(device, width, height);
+  rgba.fromHost(pixels.begin(), pixels.end());
+  check(rgba.toHost<::std::vector<::std::array<uint8_t, 4>>>() == pixels, "rgba image round trip");
+
+  auto volume = vuml::Image3D<uint32_t>(device, 17, 9, 5);
+  auto texels = ::std::vector<uint32_t>(17 * 9 * 5);
+  for (::std::size_t i = 0; i < texels.size(); ++i) {
+    texels[i] = static_cast<uint32_t>(i * 2654435761u);
+  }
+  volume.fromHost(texels.begin(), texels.end());
+  check(volume.toHost<::std::vector<uint32_t>>() == texels, "3d image round trip");
+}
+
+} // namespace
+
+int main() {
+#ifndef NDEBUG
+  vuml::logger::set_log_level(vuml::logger::Level::DEBUG);
+#else
+  vuml::logger::set_log_level(vuml::logger::Level::INFO);
+#endif
+  vuml::logger::set_log_file(stdout);
+
+  auto instance = vuml::Instance();
+  auto device = instance.select();
+
+  soa(device);
+  images(device);
+
+  if (failures != 0) {
+    ERROR("%d checks failed", failures);
+    return 1;
+  }
+  INFO("container checks passed");
+  return 0;
+}
@@ -0,0 +1,133 @@
+//
+// Created by Homin Su on 2023/7/25.
+//
+
+#include <cstddef>
+#include <cstdint>
+
+#include <numeric>
+#include <vector>
+
+#include "vuml/array.h"
+#include "vuml/device.h"
+#include "vuml/device_group.h"
+#include "vuml/instance.h"
+#include "vuml/logger.h"
+#include "vuml/program.h"
+#include "vuml/shaders.h"
+
+namespace {
+
+struct Params {
+  uint32_t size;
+  float a;
+};
+
+using Saxpy = vuml::Program<vuml::type_list<uint32_t>, Params>;
+
+int failures = 0;
+
+void check(bool ok, const char *what, vuml::Sharding sharding, ::std::size_t n) {
+  if (!ok) {
+    ERROR("%s failed, sharding %d, %zu elements", what, static_cast<int>(sharding), n);
+    ++failures;
+  }
+}
+
+// scatter and gather back, with fewer elements than devices too
+void round_trip(vuml::DeviceGroup &group, vuml::Sharding sharding, ::std::size_t n) {
+  auto x = ::std::vector<float>(n);
+  ::std::iota(x.begin(), x.end(), 1.0f);
+  auto sharded = group.scatter<float>(x, sharding);
+  check(sharded.numShards() == group.numShards(n, sharding), "shard count", sharding, n);
+  auto total = ::std::size_t{0};
+  for (::std::size_t i = 0; i < sharded.numShards(); ++i) {
+    total += sharded.shard(i).size();
+  }
+  check(total == (sharding == vuml::Sharding::eReplicate ? n * sharded.numShards() : n), "shard sizes", sharding, n);
+
+  auto y = ::std::vector<float>(n, 0.0f);
+  group.gather(sharded, y.begin());
+  check(y == x, "scatter / gather", sharding, n);
+
+  auto allocated = group.alloc<float>(n, sharding);
+  check(allocated.numShards() == sharded.numShards(), "alloc", sharding, n);
+}
+
+// y += a * x on every device, each one on its block
+void saxpy(vuml::DeviceGroup &group, ::std::size_t n) {
+  const auto a = 0.5f;
+  auto x = ::std::vector<float>(n, 2.0f);
+  auto y = ::std::vector<float>(n);
+  ::std::iota(y.begin(), y.end(), 0.0f);
+  auto d_x = group.scatter<float>(x);
+  auto d_y = group.scatter<float>(y);
+
+  auto programs = group.programs<Saxpy>(vuml::shaders::get("shader.comp"));
+  group.launch(programs, [&](Saxpy &program, ::std::size_t, auto &shard_y, auto &shard_x) {
+    auto size = static_cast<uint32_t>(shard_y.size());
+    program.grid(vuml::div_up(size, 64u)).spec(64).bind({size, a}, shard_y, shard_x);
+  }, d_y, d_x);
+
+  auto result = ::std::vector<float>(n);
+  group.gather(d_y, result.begin());
+  for (::std::size_t i = 0; i < n; ++i) {
+    if (result[i] != y[i] + a * x[i]) {
+      ERROR("saxpy: y[%zu] = %f, expected %f", i, result[i], y[i] + a * x[i]);
+      ++failures;
+      break;
+    }
+  }
+}
+
+void all_reduce(vuml::DeviceGroup &group, ::std::size_t n) {
+  auto x = ::std::vector<float>(n, 1.0f);
+  auto sharded = group.scatter<float>(x, vuml::Sharding::eReplicate);
+  group.allReduce(sharded, [](float l, float r) { return l + r; });
+  auto sum = ::std::vector<float>(n);
+  group.gather(sharded, sum.begin());
+  check(sum == ::std::vector<float>(n, static_cast<float>(group.size())), "all-reduce", vuml::Sharding::eReplicate, n);
+}
+
+void run(vuml::DeviceGroup &group) {
+  INFO("device group of %zu devices", group.size());
+  for (auto sharding : {vuml::Sharding::eBlock, vuml::Sharding::eRoundRobin, vuml::Sharding::eReplicate}) {
+    for (auto n : {::std::size_t{1}, group.size() + 1, ::std::size_t{1000}}) {
+      round_trip(group, sharding, n);
+    }
+  }
+  saxpy(group, 1000);
+  all_reduce(group, 100);
+}
+
+} // namespace
+
+int main() {
+#ifndef NDEBUG
+  vuml::logger::set_log_level(vuml::logger::Level::DEBUG);
+#else
+  vuml::logger::set_log_level(vuml::logger::Level::INFO);
+#endif
+  vuml::logger::set_log_file(stdout);
+
+  auto instance = vuml::Instance();
+
+  auto one = ::std::vector<vuml::Device>{};
+  one.push_back(instance.select());
+  auto single = vuml::DeviceGroup(one);
+  run(single);
+
+  // every device of the host, the shards then go to several of them
+  if (instance.physicalDevices().size() > 1) {
+    auto all = instance.devices();
+    auto group = vuml::DeviceGroup(all);
+    run(group);
+  }
+
+  if (failures != 0) {
+    ERROR("%d checks failed", failures);
+    return 1;
+  }
+  INFO("device group checks passed");
+  return 0;
+}
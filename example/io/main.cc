@@ -0,0 +1,111 @@
+//
+// Created by Homin Su on 2023/7/25.
+//
+
+#include <cstddef>
+#include <cstdint>
+
+#include <filesystem>
+#include <iterator>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "vuml/array.h"
+#include "vuml/device.h"
+#include "vuml/half.h"
+#include "vuml/instance.h"
+#include "vuml/kernels.h"
+#include "vuml/logger.h"
+#include "vuml/stream.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char *what) {
+  if (!ok) {
+    ERROR("%s failed", what);
+    ++failures;
+  }
+}
+
+// device arrays to a file and back, in whole and in part
+void file_round_trip(vuml::Device &device, const ::std::string &path) {
+  const auto n = ::std::size_t{1} << 20;
+  auto x = ::std::vector<float>(n);
+  ::std::iota(x.begin(), x.end(), 0.0f);
+  auto d_x = vuml::Array<float>(device, x);
+  d_x.toFile(path.c_str());
+  check(::std::filesystem::file_size(path) == n * sizeof(float), "toFile size");
+
+  auto d_y = vuml::Array<float>(device, n);
+  d_y.fromFile(path.c_str());
+  check(d_y.toHost<::std::vector<float>>() == x, "fromFile");
+
+  // the second half of the file into a smaller array
+  auto half_bytes = n / 2 * sizeof(float);
+  auto d_half = vuml::Array<float>(device, n / 2);
+  d_half.fromFile(path.c_str(), half_bytes);
+  auto second = ::std::vector<float>(x.begin() + n / 2, x.end());
+  check(d_half.toHost<::std::vector<float>>() == second, "fromFile at offset");
+
+  // and over the first half of it
+  d_half.toFile(path.c_str(), 0, half_bytes);
+  d_y.fromFile(path.c_str());
+  auto expected = second;
+  expected.insert(expected.end(), second.begin(), second.end());
+  check(d_y.toHost<::std::vector<float>>() == expected, "toFile at offset");
+}
+
+// floats in, halves out, through chunks smaller than the input and a last partial one
+void stream(vuml::Device &device) {
+  const auto n = ::std::size_t{1000000};
+  auto x = ::std::vector<float>(n);
+  for (::std::size_t i = 0; i < n; ++i) {
+    x[i] = static_cast<float>(i % 2048);
+  }
+
+  auto converter = vuml::Converter(device);
+  auto y = ::std::vector<vuml::half>{};
+  auto stats = vuml::Stream<float, vuml::half>(device, 65536)
+      .source(x.begin(), x.end())
+      .compute([&](vuml::Array<float> &input, vuml::Array<vuml::half> &output, uint32_t) {
+        converter(input, output);
+      })
+      .sink(::std::back_inserter(y))
+      .run();
+
+  auto ok = y.size() == n;
+  for (::std::size_t i = 0; ok && i < n; ++i) {
+    ok = vuml::to_float(y[i]) == x[i];
+  }
+  check(ok, "stream");
+  check(stats.read.bytes == n * sizeof(float) && stats.write.bytes == n * sizeof(vuml::half), "stream stats");
+}
+
+} // namespace
+
+int main() {
+#ifndef NDEBUG
+  vuml::logger::set_log_level(vuml::logger::Level::DEBUG);
+#else
+  vuml::logger::set_log_level(vuml::logger::Level::INFO);
+#endif
+  vuml::logger::set_log_file(stdout);
+
+  auto instance = vuml::Instance();
+  auto device = instance.select();
+
+  auto path = (::std::filesystem::temp_directory_path() / "vuml_io_example.bin").string();
+  file_round_trip(device, path);
+  ::std::filesystem::remove(path);
+  stream(device);
+
+  if (failures != 0) {
+    ERROR("%d checks failed", failures);
+    return 1;
+  }
+  INFO("io checks passed");
+  return 0;
+}
@@ -0,0 +1,177 @@
+//
+// Created by Homin Su on 2023/7/25.
+//
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include "vuml/array.h"
+#include "vuml/device.h"
+#include "vuml/half.h"
+#include "vuml/instance.h"
+#include "vuml/kernels.h"
+#include "vuml/logger.h"
+#include "vuml/program.h"
+#include "vuml/shaders.h"
+
+namespace {
+
+struct Params {
+  uint32_t size;
+  float a;
+};
+
+int failures = 0;
+
+void check(bool ok, const char *what) {
+  if (!ok) {
+    ERROR("%s failed", what);
+    ++failures;
+  }
+}
+
+template<typename T>
+::std::vector<T> prefix(const vuml::Array<T> &array, uint32_t n) {
+  auto r = array.template toHost<::std::vector<T>>();
+  r.resize(n);
+  return r;
+}
+
+void compaction(vuml::Device &device) {
+  // more than one tile, and not a multiple of it
+  const auto n = 100000u;
+  auto x = ::std::vector<uint32_t>(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    x[i] = (i * 7919u) % 1000u;
+  }
+  auto input = vuml::Array<uint32_t>(device, x);
+  auto output = vuml::Array<uint32_t>(device, n);
+  auto compaction = vuml::Compaction(device);
+
+  auto expected = ::std::vector<uint32_t>{};
+  ::std::copy_if(x.begin(), x.end(), ::std::back_inserter(expected), [](uint32_t v) { return v > 500u; });
+  compaction.copy_if(input, output, vuml::pred::greater(500u));
+  auto count = compaction.hostCount();
+  check(count == expected.size() && prefix(output, count) == expected, "copy_if");
+
+  auto flags = ::std::vector<uint32_t>(n);
+  ::std::transform(x.begin(), x.end(), flags.begin(), [](uint32_t v) { return v % 2u; });
+  auto d_flags = vuml::Array<uint32_t>(device, flags);
+  expected.clear();
+  for (uint32_t i = 0; i < n; ++i) {
+    if (flags[i] != 0) { expected.push_back(x[i]); }
+  }
+  compaction.copy_if(input, d_flags, output);
+  count = compaction.hostCount();
+  check(count == expected.size() && prefix(output, count) == expected, "copy_if with flags");
+
+  // the selected ones in order at the front, the others in reverse order at the back
+  expected.clear();
+  ::std::copy_if(x.begin(), x.end(), ::std::back_inserter(expected), [](uint32_t v) { return v < 100u; });
+  auto selected = expected.size();
+  ::std::copy_if(x.rbegin(), x.rend(), ::std::back_inserter(expected), [](uint32_t v) { return v >= 100u; });
+  compaction.partition(input, output, vuml::pred::less(100u));
+  check(compaction.hostCount() == selected && output.toHost<::std::vector<uint32_t>>() == expected, "partition");
+
+  auto runs = ::std::vector<uint32_t>(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    runs[i] = i / 3u;
+  }
+  auto d_runs = vuml::Array<uint32_t>(device, runs);
+  expected = runs;
+  expected.erase(::std::unique(expected.begin(), expected.end()), expected.end());
+  compaction.unique(d_runs, output);
+  count = compaction.hostCount();
+  check(count == expected.size() && prefix(output, count) == expected, "unique");
+
+  // the one-off version
+  auto zeros = static_cast<uint32_t>(::std::count(x.begin(), x.end(), 0u));
+  check(vuml::copy_if(input, output, vuml::pred::equal(0u)) == zeros, "one-off copy_if");
+}
+
+// a kernel sized by the count of a compaction, without reading it back
+void dispatch_args(vuml::Device &device) {
+  const auto n = 10000u;
+  auto x = ::std::vector<float>(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    x[i] = static_cast<float>(i % 100u);
+  }
+  auto input = vuml::Array<float>(device, x);
+  auto selected = vuml::Array<float>(device, n);
+  auto ones = vuml::Array<float>(device, n, [](::std::size_t) { return 1.0f; });
+  auto args = vuml::Array<uint32_t>(device, 3, {}, vuml::DispatchArgs::buffer_usage);
+
+  auto compaction = vuml::Compaction(device);
+  compaction.copy_if(input, selected, vuml::pred::greater_equal(50.0f));
+  vuml::DispatchArgs(device)(compaction.count(), 0, 64, args);
+  auto program = vuml::Program<vuml::type_list<uint32_t>, Params>(device, vuml::shaders::get("shader.comp"));
+  program.grid_indirect(args).spec(64).run({n, 1.0f}, selected, ones);
+
+  auto count = compaction.hostCount();
+  auto result = prefix(selected, count);
+  auto ok = count == n / 2;
+  for (uint32_t i = 0; ok && i < count; ++i) {
+    ok = result[i] >= 51.0f;
+  }
+  check(ok, "indirect dispatch");
+}
+
+void conversion(vuml::Device &device) {
+  auto converter = vuml::Converter(device);
+
+  // small integers are exact in every format
+  auto x = ::std::vector<float>(1000);
+  for (::std::size_t i = 0; i < x.size(); ++i) {
+    x[i] = static_cast<float>(static_cast<int>(i % 256) - 128);
+  }
+  auto d_x = vuml::Array<float>(device, x);
+
+  auto halves = ::std::vector<vuml::half>(x.size());
+  converter.download(d_x, halves.begin());
+  auto back = ::std::vector<float>(x.size());
+  ::std::transform(halves.begin(), halves.end(), back.begin(), [](vuml::half h) { return vuml::to_float(h); });
+  check(back == x, "download as half");
+
+  auto d_y = vuml::Array<float>(device, x.size());
+  converter.upload(d_y, halves.begin(), halves.end());
+  check(d_y.toHost<::std::vector<float>>() == x, "upload from half");
+
+  // int8 element i stands for i * scale, halves round to even
+  auto bytes = ::std::vector<int8_t>(x.size());
+  converter.download(d_x, bytes.begin(), 2.0f);
+  auto ok = true;
+  for (::std::size_t i = 0; ok && i < x.size(); ++i) {
+    ok = bytes[i] == static_cast<int8_t>(::std::nearbyint(x[i] / 2.0f));
+  }
+  check(ok, "download as int8");
+}
+
+} // namespace
+
+int main() {
+#ifndef NDEBUG
+  vuml::logger::set_log_level(vuml::logger::Level::DEBUG);
+#else
+  vuml::logger::set_log_level(vuml::logger::Level::INFO);
+#endif
+  vuml::logger::set_log_file(stdout);
+
+  auto instance = vuml::Instance();
+  auto device = instance.select();
+
+  compaction(device);
+  dispatch_args(device);
+  conversion(device);
+
+  if (failures != 0) {
+    ERROR("%d checks failed", failures);
+    return 1;
+  }
+  INFO("kernel checks passed");
+  return 0;
+}
@@ -12,6 +12,7 @@
 #include "vuml/instance.h"
 #include "vuml/logger.h"
 #include "vuml/program.h"
+#include "vuml/shaders.h"
 
 void write_ppm(const char *file, const uint32_t *data, uint32_t width, uint32_t height) {
   auto out = ::std::ofstream(file, ::std::ios::binary);
@@ -39,21 +40,15 @@ int main(int argc, char *argv[]) {
   const auto height = 240;
 
   auto instance = vuml::Instance();
-  auto devices = instance.devices();
-  auto discrete_iter = ::std::find_if(
-      devices.begin(),
-      devices.end(),
-      [&](const auto &dev) {
-        return dev.properties().deviceType == vk::PhysicalDeviceType::eIntegratedGpu;
-      }
-  );
-  auto dev = discrete_iter != devices.end() ? *discrete_iter : devices.at(0);
+  auto requirements = vuml::DeviceRequirements{};
+  requirements.preferred_types = {vk::PhysicalDeviceType::eIntegratedGpu};
+  auto dev = instance.select(requirements);
 
   auto mandel = vuml::Array<uint32_t, vuml::memory::Host>(dev, 4 * width * height);
 
   using Specs = vuml::type_list<uint32_t, uint32_t>;
   struct Params { uint32_t width; uint32_t height; };
-  auto program = vuml::Program<Specs, Params>(dev, "shaders/mandelbrot.comp.spv");
+  auto program = vuml::Program<Specs, Params>(dev, vuml::shaders::get("mandelbrot.comp"));
 
   program
       .grid(vuml::div_up(width, 32), vuml::div_up(height, 32))
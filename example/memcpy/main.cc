@@ -0,0 +1,91 @@
+//
+// Created by Homin Su on 2023/7/19.
+//
+
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include "vuml/array.h"
+#include "vuml/device.h"
+#include "vuml/instance.h"
+#include "vuml/logger.h"
+#include "vuml/memcpy.h"
+#include "vuml/parallel.h"
+
+namespace {
+
+constexpr ::std::size_t size_bytes = 256 << 20;
+constexpr int rounds = 5;
+
+// best of a few rounds, in GB/s
+double bench(const ::std::function<void()> &copy) {
+  auto best = ::std::chrono::steady_clock::duration::max();
+  for (int i = 0; i < rounds; ++i) {
+    auto start = ::std::chrono::steady_clock::now();
+    copy();
+    best = ::std::min(best, ::std::chrono::steady_clock::now() - start);
+  }
+  return static_cast<double>(size_bytes) / static_cast<double>(::std::chrono::nanoseconds(best).count());
+}
+
+void report(const char *name, const char *what, const char *simd, const ::std::function<void()> &copy) {
+  auto gbps = bench(copy);
+  INFO("[%s] %s %s: %.2f GB/s", name, what, simd, gbps);
+}
+
+void run(const char *name, uint8_t *mapped, uint8_t *host) {
+  report(name, "store", "std::copy", [&] { ::std::copy(host, host + size_bytes, mapped); });
+  report(name, "load ", "std::copy", [&] { ::std::copy(mapped, mapped + size_bytes, host); });
+  for (auto simd : {vuml::Simd::eSse41, vuml::Simd::eAvx2, vuml::Simd::eAvx512}) {
+    if (static_cast<int>(simd) > static_cast<int>(vuml::simd_support())) {
+      break;
+    }
+    report(name, "store", vuml::to_string(simd), [&] { vuml::stream_store(mapped, host, size_bytes, simd); });
+    report(name, "load ", vuml::to_string(simd), [&] { vuml::stream_load(host, mapped, size_bytes, simd); });
+  }
+  // all threads, as DeviceArray / HostArray copies run
+  auto best = vuml::to_string(vuml::simd_support());
+  report(name, "store parallel", "copy", [&] { vuml::parallel::copy_n(host, size_bytes, mapped); });
+  report(name, "store parallel", best, [&] { vuml::parallel::stream_store(mapped, host, size_bytes); });
+  report(name, "load  parallel", "copy", [&] { vuml::parallel::copy_n(mapped, size_bytes, host); });
+  report(name, "load  parallel", best, [&] { vuml::parallel::stream_load(host, mapped, size_bytes); });
+}
+
+template<typename Alloc>
+void run_mapped(vuml::Device &device, const char *name, uint8_t *host) {
+  auto mapped = vuml::Array<uint8_t, Alloc>(device, size_bytes);
+  INFO("[%s] host cached: %s", name, mapped.isHostCached() ? "yes" : "no");
+  run(name, mapped.data(), host);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  (void) argc, (void) argv;
+
+#ifndef NDEBUG
+  vuml::logger::set_log_level(vuml::logger::Level::DEBUG);
+#else
+  vuml::logger::set_log_level(vuml::logger::Level::INFO);
+#endif
+  vuml::logger::set_log_file(stdout);
+
+  auto instance = vuml::Instance();
+  auto requirements = vuml::DeviceRequirements{};
+  requirements.preferred_types = {vk::PhysicalDeviceType::eIntegratedGpu};
+  auto device = instance.select(requirements);
+  INFO("device: [%s], simd: %s", device.properties().deviceName.data(), vuml::to_string(vuml::simd_support()));
+
+  auto host = ::std::vector<uint8_t>(size_bytes, 1);
+  auto other = ::std::vector<uint8_t>(size_bytes, 2);
+  run("malloc", other.data(), host.data());
+  run_mapped<vuml::memory::HostCoherent>(device, "host coherent", host.data());
+  run_mapped<vuml::memory::HostCached>(device, "host cached", host.data());
+
+  return 0;
+}
@@ -0,0 +1,130 @@
+//
+// Created by Homin Su on 2023/7/25.
+//
+
+#include <cstddef>
+#include <cstdint>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "vuml/array.h"
+#include "vuml/device.h"
+#include "vuml/glsl.h"
+#include "vuml/instance.h"
+#include "vuml/logger.h"
+#include "vuml/program.h"
+
+namespace {
+
+struct Params {
+  uint32_t size;
+};
+
+using Scale = vuml::Program<vuml::type_list<uint32_t>, Params>;
+
+int failures = 0;
+
+void check(bool ok, const char *what) {
+  if (!ok) {
+    ERROR("%s failed", what);
+    ++failures;
+  }
+}
+
+// y = x * factor, FACTOR comes from the defines when the factor is empty
+::std::string source(const ::std::string &factor) {
+  return "#version 450 core\n"
+         "layout (local_size_x_id = 0) in;\n"
+         "layout (push_constant) uniform Parameters { uint size; } params;\n"
+         "layout (std430, binding = 0) buffer lay0 { float arr_y[]; };\n"
+         "layout (std430, binding = 1) buffer lay1 { float arr_x[]; };\n"
+         "void main() {\n"
+         "    const uint id = gl_GlobalInvocationID.x;\n"
+         "    if (params.size <= id) { return; }\n"
+         "    arr_y[id] = arr_x[id] * " + (factor.empty() ? ::std::string("FACTOR") : factor) + ";\n"
+         "}\n";
+}
+
+// the time of the file moves forward, a coarse clock would not see two saves in the same tick
+void save(const ::std::string &path, const ::std::string &text) {
+  auto before = ::std::filesystem::exists(path) ? ::std::filesystem::last_write_time(path)
+                                                : ::std::filesystem::file_time_type::min();
+  ::std::ofstream(path, ::std::ios::trunc) << text;
+  if (::std::filesystem::last_write_time(path) <= before) {
+    ::std::filesystem::last_write_time(path, before + ::std::chrono::seconds(1));
+  }
+}
+
+bool scaled(Scale &program, vuml::Array<float> &y, vuml::Array<float> &x, float factor) {
+  auto n = y.size();
+  program.grid(vuml::div_up(n, 64u)).spec(64).run({n}, y, x);
+  auto result = y.toHost<::std::vector<float>>();
+  auto input = x.toHost<::std::vector<float>>();
+  for (uint32_t i = 0; i < n; ++i) {
+    if (result[i] != input[i] * factor) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void watch(vuml::Device &device, const ::std::string &path) {
+  const auto n = 1000u;
+  auto x = vuml::Array<float>(device, n, [](::std::size_t i) { return static_cast<float>(i); });
+  auto y = vuml::Array<float>(device, n);
+
+  // the defines of the options
+  auto options = vuml::glsl::CompileOptions{};
+  options.defines = {{"FACTOR", "3.0"}};
+  auto defined = Scale(device, *vuml::glsl::compile(source(""), options));
+  check(scaled(defined, y, x, 3.0f), "compile with defines");
+
+  save(path, source("2.0"));
+  auto shader = vuml::glsl::ShaderWatch(path);
+  auto program = Scale(device, shader.spirv());
+  check(!shader.reload(program) && scaled(program, y, x, 2.0f), "first compilation");
+
+  save(path, source("4.0"));
+  check(shader.reload(program) && scaled(program, y, x, 4.0f), "reload after an edit");
+
+  // a broken edit keeps the module before it
+  save(path, source("4.0 +"));
+  check(!shader.reload(program) && scaled(program, y, x, 4.0f), "broken edit");
+
+  save(path, source("5.0"));
+  check(shader.reload(program) && scaled(program, y, x, 5.0f), "reload after a fix");
+}
+
+} // namespace
+
+int main() {
+#ifndef NDEBUG
+  vuml::logger::set_log_level(vuml::logger::Level::DEBUG);
+#else
+  vuml::logger::set_log_level(vuml::logger::Level::INFO);
+#endif
+  vuml::logger::set_log_file(stdout);
+
+  if (!vuml::glsl::available()) {
+    INFO("vuml was built without VUML_ENABLE_SHADERC, nothing to check");
+    return 0;
+  }
+
+  auto instance = vuml::Instance();
+  auto device = instance.select();
+
+  auto path = (::std::filesystem::temp_directory_path() / "vuml_shader_watch_example.comp").string();
+  watch(device, path);
+  ::std::filesystem::remove(path);
+
+  if (failures != 0) {
+    ERROR("%d checks failed", failures);
+    return 1;
+  }
+  INFO("shader watch checks passed");
+  return 0;
+}
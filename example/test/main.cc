@@ -1,4 +1,3 @@
-#include <algorithm>
 #include <vector>
 
 #include "vuml/array.h"
@@ -15,43 +14,45 @@ int main() {
   vuml::logger::set_log_file(stdout);
 
   auto instance = vuml::Instance();
-  auto devices = instance.devices();
-  auto discrete_iter = ::std::find_if(
-      devices.begin(),
-      devices.end(),
-      [&](const auto &dev) {
-        return dev.properties().deviceType == vk::PhysicalDeviceType::eIntegratedGpu;
-      }
-  );
-  auto device = discrete_iter != devices.end() ? *discrete_iter : devices.at(0);
-
-  INFO("devices num: %zu, choose: [%s]", devices.size(), device.properties().deviceName.data());
-  for (const auto &dev : devices) {
-    INFO("[%s] type: %s",
-         dev.properties().deviceName.data(),
-         vk::to_string(dev.properties().deviceType).c_str());
-    INFO("[%s] shared memory size: %uMB",
-         dev.properties().deviceName.data(),
-         dev.properties().limits.maxComputeSharedMemorySize / 1024);
+  auto infos = instance.physicalDevices();
+  for (const auto &info : infos) {
+    const auto &props = info.properties;
+    INFO("[%s] type: %s, score: %lld",
+         props.deviceName.data(),
+         vk::to_string(props.deviceType).c_str(),
+         static_cast<long long>(vuml::Instance::score(info, {})));
+    INFO("[%s] device local memory: %lluMB, compute queues: %u, subgroup size: %u",
+         props.deviceName.data(),
+         static_cast<unsigned long long>(info.device_local_memory >> 20),
+         info.compute_queues,
+         info.subgroup_size);
+    INFO("[%s] shared memory size: %uKB",
+         props.deviceName.data(),
+         props.limits.maxComputeSharedMemorySize / 1024);
     INFO("[%s] work group invocations: %u",
-         dev.properties().deviceName.data(),
-         dev.properties().limits.maxComputeWorkGroupInvocations);
+         props.deviceName.data(),
+         props.limits.maxComputeWorkGroupInvocations);
 
-    auto wg_count = dev.properties().limits.maxComputeWorkGroupCount;
+    auto wg_count = props.limits.maxComputeWorkGroupCount;
     INFO("[%s] work group count: [%u,%u,%u]",
-         dev.properties().deviceName.data(),
+         props.deviceName.data(),
          wg_count[0],
          wg_count[1],
          wg_count[2]);
 
-    auto wg_size = dev.properties().limits.maxComputeWorkGroupSize;
+    auto wg_size = props.limits.maxComputeWorkGroupSize;
     INFO("[%s] work group size: [%u,%u,%u]",
-         dev.properties().deviceName.data(),
+         props.deviceName.data(),
          wg_size[0],
          wg_size[1],
          wg_size[2]);
   }
 
+  auto requirements = vuml::DeviceRequirements{};
+  requirements.preferred_types = {vk::PhysicalDeviceType::eIntegratedGpu};
+  auto device = instance.select(requirements);
+  INFO("devices num: %zu, choose: [%s]", infos.size(), device.properties().deviceName.data());
+
   auto x = ::std::vector<float>(64, 1.0f);
   auto d_x = vuml::Array<float, vuml::memory::Host>(device, x.begin(), x.end());
   auto d_y = vuml::Array<float, vuml::memory::HostCached>(device, 64, 2.0f);
@@ -0,0 +1,188 @@
+//
+// Created by Homin Su on 2023/7/3.
+//
+
+#ifndef VUML_INCLUDE_VUML_ARG_H_
+#define VUML_INCLUDE_VUML_ARG_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <tuple>
+#include <type_traits>
+
+#include <vulkan/vulkan.hpp>
+
+namespace vuml {
+
+enum class Access : uint32_t {
+  eRead = 1,
+  eWrite = 2,
+  eReadWrite = eRead | eWrite,
+};
+
+inline bool reads(Access access) {
+  return static_cast<uint32_t>(access) & static_cast<uint32_t>(Access::eRead);
+}
+
+inline bool writes(Access access) {
+  return static_cast<uint32_t>(access) & static_cast<uint32_t>(Access::eWrite);
+}
+
+namespace details {
+
+constexpr bool is_dynamic(vk::DescriptorType type) {
+  return type == vk::DescriptorType::eStorageBufferDynamic || type == vk::DescriptorType::eUniformBufferDynamic;
+}
+
+constexpr bool is_uniform(vk::DescriptorType type) {
+  return type == vk::DescriptorType::eUniformBuffer || type == vk::DescriptorType::eUniformBufferDynamic;
+}
+
+constexpr bool is_image(vk::DescriptorType type) {
+  return type == vk::DescriptorType::eStorageImage || type == vk::DescriptorType::eSampledImage
+      || type == vk::DescriptorType::eCombinedImageSampler;
+}
+
+/**
+ * @brief the type the shader declares for a descriptor type: dynamic offsets are a property of the layout only
+ */
+constexpr vk::DescriptorType static_type(vk::DescriptorType type) {
+  switch (type) {
+    case vk::DescriptorType::eStorageBufferDynamic: return vk::DescriptorType::eStorageBuffer;
+    case vk::DescriptorType::eUniformBufferDynamic: return vk::DescriptorType::eUniformBuffer;
+    default: return type;
+  }
+}
+
+constexpr vk::DescriptorType dynamic_type(vk::DescriptorType type) {
+  return is_uniform(type) ? vk::DescriptorType::eUniformBufferDynamic : vk::DescriptorType::eStorageBufferDynamic;
+}
+
+} // namespace details
+
+/**
+ * @brief an array argument of Program::bind with an explicit access, see in(), out() and inout(), and the descriptor
+ * type it binds as, see uniform() and dynamic()
+ * @tparam Array
+ */
+template<class Array, vk::DescriptorType Type = Array::descriptor_type>
+class Arg {
+ public:
+  using array_type = Array;
+  using value_type = typename Array::value_type;
+  static constexpr auto descriptor_type = Type;
+
+ private:
+  array_type &array_;
+  Access access_;
+  // the window of a dynamic descriptor, in elements
+  ::std::size_t offset_ = 0;
+  ::std::size_t count_ = 0;
+
+ public:
+  Arg(array_type &array, Access access) : array_(array), access_(access) {}
+
+  Arg(array_type &array, Access access, ::std::size_t offset, ::std::size_t count)
+      : array_(array), access_(access), offset_(offset), count_(count) {}
+
+  array_type &array() { return array_; }
+  [[nodiscard]] const array_type &array() const { return array_; }
+  [[nodiscard]] Access access() const { return access_; }
+  [[nodiscard]] ::std::size_t offset() const { return offset_; }
+  [[nodiscard]] ::std::size_t count() const { return count_; }
+};
+
+/**
+ * @brief the kernel only reads the array: no write barrier after the dispatch and no invalidation of host mappings
+ */
+template<class Array>
+Arg<Array> in(Array &array) { return {array, Access::eRead}; }
+
+/**
+ * @brief the kernel only writes the array: host mappings are not flushed before the dispatch
+ */
+template<class Array>
+Arg<Array> out(Array &array) { return {array, Access::eWrite}; }
+
+template<class Array>
+Arg<Array> inout(Array &array) { return {array, Access::eReadWrite}; }
+
+/**
+ * @brief bind a read-only table as a uniform buffer, read through the uniform cache: the array needs the uniform
+ * buffer usage (see memory::Uniform) and at most maxUniformBufferRange bytes
+ */
+template<class Array>
+Arg<Array, vk::DescriptorType::eUniformBuffer> uniform(Array &array) { return {array, Access::eRead}; }
+
+/**
+ * @brief bind count elements at offset through a dynamic offset, e.g. dynamic(in(table), i * n, n): moving the window
+ * between runs does not rewrite the descriptor set. The offset in bytes is a multiple of
+ * minStorageBufferOffsetAlignment, or minUniformBufferOffsetAlignment for uniform().
+ */
+template<class Array, vk::DescriptorType Type>
+Arg<Array, details::dynamic_type(Type)> dynamic(Arg<Array, Type> arg, ::std::size_t offset, ::std::size_t count) {
+  static_assert(!details::is_image(Type), "images have no dynamic offsets");
+  return {arg.array(), arg.access(), offset, count};
+}
+
+namespace details {
+
+template<typename T>
+struct is_arg : ::std::false_type {};
+
+template<class Array, vk::DescriptorType Type>
+struct is_arg<Arg<Array, Type>> : ::std::true_type {};
+
+template<typename T>
+constexpr bool is_arg_v = is_arg<::std::remove_cv_t<::std::remove_reference_t<T>>>::value;
+
+template<typename T>
+decltype(auto) unwrap(T &arg) {
+  if constexpr (is_arg_v<T>) {
+    return arg.array();
+  } else {
+    return (arg);
+  }
+}
+
+/**
+ * @brief arrays made of several buffers, such as SoAArray, list them in fields(): they bind as one argument each
+ */
+template<typename T, typename = void>
+struct has_fields : ::std::false_type {};
+
+template<typename T>
+struct has_fields<T, ::std::void_t<decltype(::std::declval<T &>().fields())>> : ::std::true_type {};
+
+template<typename T>
+struct is_fields_arg : ::std::false_type {};
+
+template<class Array, vk::DescriptorType Type>
+struct is_fields_arg<Arg<Array, Type>> : has_fields<Array> {};
+
+/**
+ * @brief the arguments an argument binds as: the fields of a multi-buffer array, with the access of the argument
+ */
+template<typename T>
+auto flatten(T &arg) {
+  if constexpr (is_fields_arg<::std::remove_cv_t<T>>::value) {
+    return ::std::apply([&arg](auto &...fields) {
+      return ::std::make_tuple(Arg<::std::remove_reference_t<decltype(fields)>, T::descriptor_type>(
+          fields, arg.access(), arg.offset(), arg.count()
+      )...);
+    }, arg.array().fields());
+  } else if constexpr (has_fields<T>::value) {
+    return ::std::apply([](auto &...fields) { return ::std::tie(fields...); }, arg.fields());
+  } else if constexpr (is_arg_v<T>) {
+    return ::std::make_tuple(arg);
+  } else {
+    return ::std::tie(arg);
+  }
+}
+
+} // namespace details
+
+} // namespace vuml
+
+#endif //VUML_INCLUDE_VUML_ARG_H_
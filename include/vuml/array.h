@@ -32,6 +32,7 @@ namespace memory {
 using Host = array::AllocDevice<array::properties::Host>;
 using HostCoherent = array::AllocDevice<array::properties::HostCoherent>;
 using HostCached = array::AllocDevice<array::properties::HostCached>;
+using Uniform = array::AllocDevice<array::properties::Uniform>;
 using Unified = array::AllocDevice<array::properties::Unified>;
 using Device = array::AllocDevice<array::properties::Device>;
 using DeviceOnly = array::AllocDevice<array::properties::DeviceOnly>;
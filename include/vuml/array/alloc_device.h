@@ -10,6 +10,7 @@
 
 #include <exception>
 #include <stdexcept>
+#include <type_traits>
 
 #include "vuml/device.h"
 #include "vuml/instance.h"
@@ -47,21 +48,59 @@ class AllocDevice {
     return AllocFallback::findMemory(device, buffer, flags);
   }
 
+  static vk::BufferUsageFlags bufferUsage(vk::BufferUsageFlags flags) {
+    return flags | vk::BufferUsageFlags(Props::buffer);
+  }
+
+  /**
+   * @brief the buffer is padded to whole 32-bit words: shaders address storage buffers by uint, the word holding the
+   * last bytes of an array of 8 or 16-bit elements must be in it
+   */
   static vk::Buffer makeBuffer(Device &device, ::std::size_t size, vk::BufferUsageFlags flags) {
-    return device.createBuffer({{}, size, flags | vk::BufferUsageFlags(Props::buffer)});
+    return device.createBuffer({{}, (size + 3) & ~::std::size_t{3}, bufferUsage(flags)});
   }
 
+  /**
+   * @brief allocate the memory of a buffer, Device::allocPolicy() decides what happens when the heap is full
+   */
   vk::DeviceMemory allocMemory(Device &device, vk::Buffer buffer, vk::MemoryPropertyFlags flags = {}) {
     mem_id_ = findMemory(device, buffer, flags);
+    auto size = device.getBufferMemoryRequirements(buffer).size;
+    auto heap = device.heapIndex(mem_id_);
+    auto policy = device.allocPolicy();
+    if (policy == AllocPolicy::eEvict) {
+      // make room before the driver starts paging behind our back
+      auto budget = device.heapBudget(heap);
+      if (budget.usage + size > budget.budget) {
+        device.evict(heap, budget.usage + size - budget.budget);
+      }
+    }
     vk::DeviceMemory mem{};
     try {
-      mem = device.allocateMemory({device.getBufferMemoryRequirements(buffer).size, mem_id_});
+      mem = device.allocateMemory({size, mem_id_});
     } catch (vk::Error &e) {
-      auto allocFallback = AllocFallback{};
-      WARN("AllocDevice failed to allocate memory, using fallback: %s", e.what());
-      mem = allocFallback.allocMemory(device, buffer, flags);
-      mem_id_ = allocFallback.mem_id();
+      if (policy == AllocPolicy::eEvict && device.evict(heap, size) != 0) {
+        try {
+          mem = device.allocateMemory({size, mem_id_});
+        } catch (vk::Error &) {}
+      }
+      if (!mem) {
+        if (policy == AllocPolicy::eFailFast) {
+          ERROR("AllocDevice failed to allocate %llu bytes on heap %u: %s",
+                static_cast<unsigned long long>(size), heap, e.what());
+          throw;
+        }
+        auto allocFallback = AllocFallback{};
+        WARN("AllocDevice failed to allocate memory, using fallback: %s", e.what());
+        if constexpr (!::std::is_void_v<typename Props::fallback_t>) {
+          device.countFallback();
+        }
+        mem = allocFallback.allocMemory(device, buffer, flags);
+        mem_id_ = allocFallback.mem_id();
+        return mem;
+      }
     }
+    device.trackAlloc(mem_id_, size);
     return mem;
   }
 };
@@ -88,8 +127,12 @@ class AllocDevice<void> {
     );
   }
 
+  static vk::BufferUsageFlags bufferUsage(vk::BufferUsageFlags flags) {
+    return flags;
+  }
+
   static vk::Buffer makeBuffer(Device &device, ::std::size_t size, vk::BufferUsageFlags flags) {
-    return device.createBuffer({{}, size, flags});
+    return device.createBuffer({{}, (size + 3) & ~::std::size_t{3}, bufferUsage(flags)});
   }
 
   vk::DeviceMemory allocMemory(Device &device, vk::Buffer buffer, vk::MemoryPropertyFlags flags = {}) {
@@ -6,29 +6,59 @@
 #define VUML_INCLUDE_VUML_ARRAY_BASIC_ARRAY_H_
 
 #include <cstddef>
+#include <cstdint>
 
+#include <atomic>
 #include <exception>
 #include <stdexcept>
 #include <utility>
 
 #include "alloc_device.h"
+#include "properties.h"
 #include "vuml/device.h"
 #include "vuml/non_copyable.h"
+#include "vuml/logger.h"
+#include "vuml/sync.h"
+#include "vuml/utils.h"
 #include "vuml/vuml.h"
 
 #include <vulkan/vulkan.hpp>
 
 namespace vuml::array {
 
+namespace details {
+
+// buffer handles are reused once destroyed, generations tell two buffers apart
+inline uint64_t next_generation() {
+  static ::std::atomic<uint64_t> generation{0};
+  return ++generation;
+}
+
+} // namespace details
+
 template<class Alloc>
-class BasicArray : public vk::Buffer, private NonCopyable {
+class BasicArray : public vk::Buffer, public Evictable, private NonCopyable {
  protected:
   vk::DeviceMemory mem_;
   vk::MemoryPropertyFlags flags_;
   Device &device_;
+  mutable bool mapped_ = false;
+  mutable Hazards hazards_;
 
  private:
   static constexpr auto descriptor_flag = vk::BufferUsageFlagBits::eStorageBuffer;
+  // where the array is paged out to
+  using AllocEvicted = AllocDevice<properties::HostCached>;
+
+  ::std::size_t size_bytes_;
+  vk::MemoryPropertyFlags properties_;
+  vk::BufferUsageFlags usage_;
+  uint32_t mem_id_ = -1U;
+  vk::DeviceSize mem_size_ = 0;
+  uint64_t last_use_ = 0;
+  bool evictable_ = false;
+  bool evicted_ = false;
+  uint64_t generation_ = details::next_generation();
 
  public:
   static constexpr auto descriptor_type = vk::DescriptorType::eStorageBuffer;
@@ -37,10 +67,13 @@ class BasicArray : public vk::Buffer, private NonCopyable {
              ::std::size_t size,
              vk::MemoryPropertyFlags properties = {},
              vk::BufferUsageFlags flags = {})
-      : vk::Buffer(Alloc::makeBuffer(device, size, descriptor_flag | flags)), device_(device) {
+      : vk::Buffer(Alloc::makeBuffer(device, size, descriptor_flag | flags)), device_(device), size_bytes_(size),
+        properties_(properties), usage_(Alloc::bufferUsage(descriptor_flag | flags)) {
     try {
       auto alloc = Alloc();
       mem_ = alloc.allocMemory(device_, *this, properties);
+      mem_id_ = alloc.mem_id();
+      mem_size_ = device_.getBufferMemoryRequirements(*this).size;
       flags_ = alloc.memoryProperties(device);
       device_.bindBufferMemory(*this, mem_, 0);
     } catch (::std::runtime_error &) {
@@ -52,8 +85,12 @@ class BasicArray : public vk::Buffer, private NonCopyable {
   ~BasicArray() noexcept { release(); }
 
   BasicArray(BasicArray &&other) noexcept
-      : vk::Buffer(other), mem_(other.mem_), flags_(other.flags_), device_(other.device_) {
+      : vk::Buffer(other), mem_(other.mem_), flags_(other.flags_), device_(other.device_), mapped_(other.mapped_),
+        hazards_(other.hazards_), size_bytes_(other.size_bytes_), properties_(other.properties_),
+        usage_(other.usage_), mem_id_(other.mem_id_), mem_size_(other.mem_size_), last_use_(other.last_use_),
+        evictable_(other.evictable_), evicted_(other.evicted_), generation_(other.generation_) {
     static_cast<vk::Buffer &>(other) = nullptr;
+    other.take_registration(*this);
   }
 
   vk::Buffer buffer() {
@@ -68,17 +105,159 @@ class BasicArray : public vk::Buffer, private NonCopyable {
     return device_;
   }
 
+  [[nodiscard]] vk::DeviceMemory memory() const {
+    return mem_;
+  }
+
+  /**
+   * @brief usage the buffer was created with, see Alloc::bufferUsage()
+   */
+  [[nodiscard]] vk::BufferUsageFlags usage() const {
+    return usage_;
+  }
+
+  /**
+   * @brief changes whenever the array gets a new buffer, when it is evicted or paged back: descriptors written for the
+   * previous one are stale even if the handle is the same. Bound programs keep the address to notice an eviction.
+   */
+  [[nodiscard]] const uint64_t &generation() const {
+    return generation_;
+  }
+
   [[nodiscard]] bool isHostVisible() const {
     return static_cast<bool>(flags_ & vk::MemoryPropertyFlagBits::eHostVisible);
   }
 
+  /**
+   * @brief let Device::evict() move the array to host memory under memory pressure (AllocPolicy::eEvict), it is
+   * paged back by touch() the next time a program binds it. The buffer must allow transfers both ways.
+   */
+  void setEvictable(bool evictable) {
+    constexpr auto transfer = vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+    if (evictable && (usage_ & transfer) != transfer) {
+      ERROR("an evictable array needs transfer source and destination usage");
+      throw ::std::invalid_argument("an evictable array needs transfer source and destination usage");
+    }
+    evictable_ = evictable;
+    update_registration();
+  }
+
+  [[nodiscard]] bool isEvictable() const { return evictable_; }
+  [[nodiscard]] bool isEvicted() const { return evicted_; }
+
+  /**
+   * @brief mark the array as used by the device, page it back first if it was evicted
+   */
+  void touch() {
+    last_use_ = device_.nextUse();
+    if (evicted_) {
+      page_in();
+    }
+  }
+
+  [[nodiscard]] uint32_t heap() const override { return device_.heapIndex(mem_id_); }
+  [[nodiscard]] uint64_t lastUse() const override { return last_use_; }
+
+  [[nodiscard]] bool resident() const override {
+    return evictable_ && !evicted_ && !mapped_ && static_cast<bool>(flags_ & vk::MemoryPropertyFlagBits::eDeviceLocal);
+  }
+
+  vk::DeviceSize evict() override {
+    if (!resident()) {
+      return 0;
+    }
+    auto alloc = AllocEvicted();
+    auto released = mem_size_;
+    if (!move_to(alloc, AllocEvicted::makeBuffer(device_, size_bytes_, usage_), {})) {
+      return 0;
+    }
+    evicted_ = true;
+    return released;
+  }
+
+  /**
+   * @brief host visible but not cached is write-combined memory: host writes should fill whole lines, host reads are
+   * uncached and slow, see stream_store() / stream_load()
+   */
+  [[nodiscard]] bool isHostCached() const {
+    return static_cast<bool>(flags_ & vk::MemoryPropertyFlagBits::eHostCached);
+  }
+
+  [[nodiscard]] bool isHostCoherent() const {
+    return static_cast<bool>(flags_ & vk::MemoryPropertyFlagBits::eHostCoherent);
+  }
+
+  /**
+   * @brief whether host writes must be flushed / device writes invalidated by hand to be seen on the other side
+   */
+  [[nodiscard]] bool needsFlush() const {
+    return mapped_ && isHostVisible() && !isHostCoherent();
+  }
+
+  /**
+   * @brief last device accesses of the array
+   */
+  Hazards &hazards() const {
+    return hazards_;
+  }
+
+  /**
+   * @brief wait for the device before the host reads (and writes) the array, then make device writes visible
+   */
+  void syncHost(bool host_writes) const {
+    // once synced, the element accesses stop here until the next submission touching the array
+    if (hazards_.hostReady(host_writes)) { return; }
+    device_.wait(hazards_.last_write);
+    hazards_.last_write = {};
+    if (host_writes) {
+      for (auto &read : hazards_.last_reads) {
+        device_.wait(read);
+        read = {};
+      }
+    }
+    if (hazards_.device_written) {
+      invalidate();
+      hazards_.device_written = false;
+    }
+  }
+
+  /**
+   * @brief make host writes to the mapped memory visible to the device, no-op on coherent memory
+   */
+  void flush() const {
+    if (needsFlush()) {
+      device_.flushMappedMemoryRanges(vk::MappedMemoryRange(mem_, 0, VK_WHOLE_SIZE));
+    }
+  }
+
+  /**
+   * @brief make device writes visible to the mapped memory, no-op on coherent memory
+   */
+  void invalidate() const {
+    if (needsFlush()) {
+      device_.invalidateMappedMemoryRanges(vk::MappedMemoryRange(mem_, 0, VK_WHOLE_SIZE));
+    }
+  }
+
   BasicArray &operator=(BasicArray &&other) noexcept {
     release();
     mem_ = other.mem_;
     flags_ = other.flags_;
     device_ = other.device_;
+    mapped_ = other.mapped_;
+    hazards_ = other.hazards_;
+    size_bytes_ = other.size_bytes_;
+    properties_ = other.properties_;
+    usage_ = other.usage_;
+    mem_id_ = other.mem_id_;
+    mem_size_ = other.mem_size_;
+    last_use_ = other.last_use_;
+    evictable_ = other.evictable_;
+    evicted_ = other.evicted_;
+    generation_ = other.generation_;
     reinterpret_cast<vk::Buffer &>(*this) = reinterpret_cast<vk::Buffer &>(other);
     reinterpret_cast<vk::Buffer &>(other) = nullptr;
+    other.take_registration(*this);
     return *this;
   }
 
@@ -87,15 +266,128 @@ class BasicArray : public vk::Buffer, private NonCopyable {
     ::std::swap(mem_, other.mem_);
     ::std::swap(flags_, other.flags_);
     swap(device_, other.device_);
+    ::std::swap(mapped_, other.mapped_);
+    ::std::swap(hazards_, other.hazards_);
+    ::std::swap(size_bytes_, other.size_bytes_);
+    ::std::swap(properties_, other.properties_);
+    ::std::swap(usage_, other.usage_);
+    ::std::swap(mem_id_, other.mem_id_);
+    ::std::swap(mem_size_, other.mem_size_);
+    ::std::swap(last_use_, other.last_use_);
+    ::std::swap(evictable_, other.evictable_);
+    ::std::swap(evicted_, other.evicted_);
+    ::std::swap(generation_, other.generation_);
+    // the device knows the arrays by address
+    update_registration();
+    other.update_registration();
+  }
+
+ protected:
+  void *map(::std::size_t size) const {
+    VUML_ASSERT(isHostVisible() && "must host visible");
+    auto data = device_.mapMemory(mem_, 0, size);
+    mapped_ = true;
+    return data;
+  }
+
+  void unmap() const {
+    device_.unmapMemory(mem_);
+    mapped_ = false;
   }
 
  private:
   void release() noexcept {
+    if (evictable_) {
+      device_.unregisterEvictable(this);
+      evictable_ = false;
+    }
     if (static_cast<vk::Buffer &>(*this)) {
+      // the memory may still be used by a pending submission
+      wait_device();
+      if (mem_) {
+        device_.trackFree(mem_id_, mem_size_);
+      }
       device_.freeMemory(mem_);
       device_.destroyBuffer(*this);
     }
   }
+
+  void wait_device() const {
+    device_.wait(hazards_.last_write);
+    for (const auto &read : hazards_.last_reads) {
+      device_.wait(read);
+    }
+  }
+
+  void update_registration() noexcept {
+    if (evictable_) {
+      device_.registerEvictable(this);
+    } else {
+      device_.unregisterEvictable(this);
+    }
+  }
+
+  // a moved-from array hands its registration to the array it moved to
+  void take_registration(BasicArray &to) noexcept {
+    if (evictable_) {
+      device_.unregisterEvictable(this);
+      device_.registerEvictable(&to);
+      evictable_ = false;
+    }
+  }
+
+  void page_in() {
+    auto alloc = Alloc();
+    if (move_to(alloc, Alloc::makeBuffer(device_, size_bytes_, usage_), properties_)) {
+      evicted_ = false;
+    }
+  }
+
+  /**
+   * @brief copy the array into a new buffer allocated by alloc, then free the old one
+   */
+  template<class A>
+  bool move_to(A &alloc, vk::Buffer buffer, vk::MemoryPropertyFlags properties) {
+    vk::DeviceMemory mem{};
+    auto release_new = [&] {
+      if (mem) {
+        device_.trackFree(alloc.mem_id(), device_.getBufferMemoryRequirements(buffer).size);
+        device_.freeMemory(mem);
+      }
+      device_.destroyBuffer(buffer);
+    };
+    try {
+      mem = alloc.allocMemory(device_, buffer, properties);
+      device_.bindBufferMemory(buffer, mem, 0);
+    } catch (vk::Error &e) {
+      WARN("failed to move an array: %s", e.what());
+      release_new();
+      return false;
+    }
+    try {
+      auto moved = Hazards{};
+      device_.wait(copy_buf(device_, *this, hazards_, buffer, moved, size_bytes_));
+      wait_device();
+    } catch (::std::exception &) {
+      // the array stays in its old buffer
+      release_new();
+      throw;
+    }
+    device_.trackFree(mem_id_, mem_size_);
+    device_.freeMemory(mem_);
+    device_.destroyBuffer(*this);
+
+    static_cast<vk::Buffer &>(*this) = buffer;
+    generation_ = details::next_generation();
+    mem_ = mem;
+    mem_id_ = alloc.mem_id();
+    mem_size_ = device_.getBufferMemoryRequirements(buffer).size;
+    flags_ = alloc.memoryProperties(device_);
+    hazards_ = Hazards{};
+    // a non-coherent destination is invalidated before the host reads it
+    hazards_.device_written = true;
+    return true;
+  }
 };
 
 } // namespace vuml::array
@@ -10,7 +10,9 @@
 
 #include <algorithm>
 #include <iterator>
+#include <stdexcept>
 #include <type_traits>
+#include <utility>
 
 #include "alloc_device.h"
 #include "basic_array.h"
@@ -18,6 +20,8 @@
 #include "iter.h"
 #include "properties.h"
 #include "vuml/device.h"
+#include "vuml/logger.h"
+#include "vuml/parallel.h"
 #include "vuml/traits.h"
 #include "vuml/utils.h"
 
@@ -80,6 +84,9 @@ class DeviceArray : public BasicArray<Alloc> {
     fromHost(begin, end);
   }
 
+  /**
+   * @brief element i is func(i), called in order of i
+   */
   template<typename F, class = typename ::std::enable_if_t<::std::is_invocable_v<F, ::std::size_t>>>
   DeviceArray(Device &device,
               ::std::size_t element_nums,
@@ -87,76 +94,116 @@ class DeviceArray : public BasicArray<Alloc> {
               vk::MemoryPropertyFlags memory_flags = {},
               vk::BufferUsageFlags buffer_flags = {})
       : DeviceArray(device, element_nums, memory_flags, buffer_flags) {
-    auto stage_buf = HostArray<value_type, AllocDevice<properties::HostCoherent>>(Base::_dev, element_nums);
-    auto stage_iter = stage_buf.begin();
-    for (::std::size_t i = 0; i < element_nums; ++i, ++stage_iter) {
-      *stage_iter = func(i);
+    auto stage_buf = HostArray<value_type, AllocDevice<properties::HostCoherent>>(Base::device_, element_nums);
+    auto stage = stage_buf.data();
+    for (::std::size_t i = 0; i < element_nums; ++i) {
+      stage[i] = func(i);
     }
-    copy_buf(Base::device_, stage_buf, *this, size_bytes());
+    stage_buf.flush();
+    copy_buf(Base::device_, stage_buf, stage_buf.hazards(), *this, Base::hazards(), size_bytes());
+  }
+
+  /**
+   * @brief element i is func(i), func is called concurrently from the thread pool
+   */
+  template<typename F, class = typename ::std::enable_if_t<::std::is_invocable_v<F, ::std::size_t>>>
+  DeviceArray(Device &device,
+              ::std::size_t element_nums,
+              parallel::Par,
+              F &&func,
+              vk::MemoryPropertyFlags memory_flags = {},
+              vk::BufferUsageFlags buffer_flags = {})
+      : DeviceArray(device, element_nums, memory_flags, buffer_flags) {
+    auto stage_buf = HostArray<value_type, AllocDevice<properties::HostCoherent>>(Base::device_, element_nums);
+    parallel::generate_n(stage_buf.data(), element_nums, func);
+    stage_buf.flush();
+    copy_buf(Base::device_, stage_buf, stage_buf.hazards(), *this, Base::hazards(), size_bytes());
   }
 
   template<typename It, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
   void fromHost(It begin, It end) {
     if (Base::isHostVisible()) {
-      ::std::copy(begin, end, host_data());
-      Base::device_.unmapMemory(Base::mem_);
+      auto n = static_cast<::std::size_t>(::std::distance(begin, end));
+      parallel::copy_to_mapped(begin, n, host_data(), !Base::isHostCached());
+      Base::flush();
+      Base::unmap();
     } else {
       auto stage_buf = HostArray<value_type, AllocDevice<properties::HostCoherent>>(Base::device_, begin, end);
-      copy_buf(Base::device_, stage_buf, *this, size_bytes());
+      stage_buf.flush();
+      copy_buf(Base::device_, stage_buf, stage_buf.hazards(), *this, Base::hazards(), size_bytes());
     }
   }
 
   template<typename It, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
   void fromHost(It begin, It end, ::std::size_t offset) {
     if (Base::isHostVisible()) {
-      ::std::copy(begin, end, host_data());
-      Base::device_.unmapMemory(Base::mem_);
+      auto n = static_cast<::std::size_t>(::std::distance(begin, end));
+      parallel::copy_to_mapped(begin, n, host_data() + offset, !Base::isHostCached());
+      Base::flush();
+      Base::unmap();
     } else {
       auto stage_buf = HostArray<value_type, AllocDevice<properties::HostCoherent>>(Base::device_, begin, end);
-      copy_buf(Base::device_, stage_buf, *this, size_bytes(), 0u, offset * sizeof(value_type));
+      stage_buf.flush();
+      copy_buf(Base::device_,
+               stage_buf,
+               stage_buf.hazards(),
+               *this,
+               Base::hazards(),
+               stage_buf.size_bytes(),
+               0u,
+               offset * sizeof(value_type));
     }
   }
 
   template<typename It, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
   void toHost(It dst) const {
     if (Base::isHostVisible()) {
-      ::std::copy_n(host_data(), size(), dst);
-      Base::device_.unmapMemory(Base::mem_);
+      auto src = host_data();
+      parallel::copy_from_mapped(src, size(), dst, !Base::isHostCached());
+      Base::unmap();
     } else {
       auto stage_buf = HostArray<value_type, AllocDevice<properties::HostCached>>(Base::device_, size());
-      copy_buf(Base::device_, *this, stage_buf, size_bytes());
-      ::std::copy(stage_buf.begin(), stage_buf.end(), dst);
+      copy_buf(Base::device_, *this, Base::hazards(), stage_buf, stage_buf.hazards(), stage_buf.size_bytes());
+      parallel::copy_from_mapped(stage_buf.data(), stage_buf.size(), dst, !stage_buf.isHostCached());
     }
   }
 
+  /**
+   * @brief dst[i] = func(element i), called in order of i
+   */
   template<typename It, typename F, class = typename ::std::enable_if_t<
       traits::is_iterator_v<It> && ::std::is_invocable_v<F, value_type>
   >>
   void toHost(It dst, F &&func) const {
-    if (Base::isHostVisible()) {
-      auto src = host_data();
-      ::std::transform(src, src + size(), dst, ::std::forward<F>(func));
-      Base::device_.unmapMemory(Base::mem_);
-    } else {
-      auto stage_buf = HostArray<value_type, AllocDevice<properties::HostCached>>(Base::device_, size());
-      copy_buf(Base::device_, *this, stage_buf, size_bytes());
-      ::std::transform(stage_buf.begin(), stage_buf.end(), dst, ::std::forward<F>(func));
-    }
+    toHost(dst, size(), func);
   }
 
   template<typename It, typename F, class = typename ::std::enable_if_t<
       traits::is_iterator_v<It> && ::std::is_invocable_v<F, value_type>
   >>
   void toHost(It dst, ::std::size_t size, F &&func) const {
-    if (Base::isHostVisible()) {
-      auto src = host_data();
-      ::std::transform(src, src + size, dst, ::std::forward<F>(func));
-      Base::device_.unmapMemory(Base::mem_);
-    } else {
-      auto stage_buf = HostArray<value_type, AllocDevice<properties::HostCached>>(Base::device_, size);
-      copy_buf(Base::device_, *this, stage_buf, size_bytes());
-      ::std::transform(stage_buf.begin(), stage_buf.end(), dst, ::std::forward<F>(func));
-    }
+    transform_to_host(size, [&](const value_type *src, ::std::size_t n) {
+      ::std::transform(src, src + n, dst, func);
+    });
+  }
+
+  /**
+   * @brief dst[i] = func(element i), func is called concurrently from the thread pool
+   */
+  template<typename It, typename F, class = typename ::std::enable_if_t<
+      traits::is_iterator_v<It> && ::std::is_invocable_v<F, value_type>
+  >>
+  void toHost(parallel::Par, It dst, F &&func) const {
+    toHost(parallel::par, dst, size(), func);
+  }
+
+  template<typename It, typename F, class = typename ::std::enable_if_t<
+      traits::is_iterator_v<It> && ::std::is_invocable_v<F, value_type>
+  >>
+  void toHost(parallel::Par, It dst, ::std::size_t size, F &&func) const {
+    transform_to_host(size, [&](const value_type *src, ::std::size_t n) {
+      parallel::transform_n(src, n, dst, func);
+    });
   }
 
   template<typename C, class = typename ::std::enable_if_t<traits::is_iterable_v<C>>>
@@ -171,14 +218,51 @@ class DeviceArray : public BasicArray<Alloc> {
     VUML_ASSERT(offset_begin >= 0 && offset_begin < offset_end);
     if (Base::isHostVisible()) {
       auto src = host_data();
-      ::std::copy(src + offset_begin, src + offset_end, dst);
-      Base::device_.unmapMemory(Base::mem_);
+      parallel::copy_from_mapped(src + offset_begin, offset_end - offset_begin, dst, !Base::isHostCached());
+      Base::unmap();
     } else {
       auto stage_buf = HostArray<value_type, AllocDevice<properties::HostCached>>(
           Base::device_, offset_end - offset_begin
       );
-      copy_buf(Base::device_, *this, stage_buf, size_bytes(), offset_begin, 0U);
-      ::std::copy(stage_buf.begin(), stage_buf.end(), dst);
+      copy_buf(Base::device_,
+               *this,
+               Base::hazards(),
+               stage_buf,
+               stage_buf.hazards(),
+               stage_buf.size_bytes(),
+               offset_begin * sizeof(value_type),
+               0U);
+      parallel::copy_from_mapped(stage_buf.data(), stage_buf.size(), dst, !stage_buf.isHostCached());
+    }
+  }
+
+  /**
+   * @brief fill the array from length bytes of a file at offset, the whole array when it is 0, without going through
+   * a host vector: see read_file()
+   */
+  void fromFile(const char *path, uint64_t offset = 0, ::std::size_t length = 0) {
+    auto size = length == 0 ? static_cast<::std::size_t>(size_bytes()) : length;
+    check_file_range(size);
+    if (Base::isHostVisible()) {
+      read_file(path, offset, size, host_data());
+      Base::flush();
+      Base::unmap();
+    } else {
+      read_file(Base::device_, path, offset, size, *this, Base::hazards());
+    }
+  }
+
+  /**
+   * @brief write length bytes of the array into a file at offset, the whole array when it is 0, see write_file()
+   */
+  void toFile(const char *path, uint64_t offset = 0, ::std::size_t length = 0) const {
+    auto size = length == 0 ? static_cast<::std::size_t>(size_bytes()) : length;
+    check_file_range(size);
+    if (Base::isHostVisible()) {
+      write_file(path, offset, size, host_data());
+      Base::unmap();
+    } else {
+      write_file(Base::device_, path, offset, size, *this, Base::hazards());
     }
   }
 
@@ -192,14 +276,36 @@ class DeviceArray : public BasicArray<Alloc> {
   friend ArrayIter<DeviceArray> device_end(DeviceArray &array) { return array.device_end(); }
 
  private:
+  void check_file_range(::std::size_t length) const {
+    if (length > size_bytes()) {
+      ERROR("%zu bytes do not fit in an array of %u bytes", length, size_bytes());
+      throw ::std::out_of_range("the file range does not fit in the array");
+    }
+  }
+
+  // f(src, n) reads the first n elements on the host, from the mapped array or from a copy of it
+  template<typename F>
+  void transform_to_host(::std::size_t n, F &&f) const {
+    if (Base::isHostVisible()) {
+      f(host_data(), n);
+      Base::unmap();
+    } else {
+      auto stage_buf = HostArray<value_type, AllocDevice<properties::HostCached>>(Base::device_, n);
+      copy_buf(Base::device_, *this, Base::hazards(), stage_buf, stage_buf.hazards(), stage_buf.size_bytes());
+      f(::std::as_const(stage_buf).data(), n);
+    }
+  }
+
   value_type *host_data() {
-    VUML_ASSERT(Base::isHostVisible() && "must host visible");
-    return static_cast<value_type *>(Base::device_.mapMemory(Base::mem_, 0, size_bytes()));
+    auto data = static_cast<value_type *>(Base::map(size_bytes()));
+    Base::syncHost(true);
+    return data;
   }
 
   const value_type *host_data() const {
-    VUML_ASSERT(Base::isHostVisible() && "must host visible");
-    return static_cast<const value_type *>(Base::device_.mapMemory(Base::mem_, 0, size_bytes()));
+    auto data = static_cast<const value_type *>(Base::map(size_bytes()));
+    Base::syncHost(false);
+    return data;
   }
 };
 
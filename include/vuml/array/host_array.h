@@ -15,6 +15,7 @@
 #include "basic_array.h"
 #include "iter.h"
 #include "vuml/device.h"
+#include "vuml/parallel.h"
 #include "vuml/traits.h"
 
 namespace vuml::array {
@@ -32,7 +33,7 @@ class HostArray : public BasicArray<Alloc> {
 
  public:
   ~HostArray() noexcept {
-    if (data_) { Base::device_.unmapMemory(Base::mem_); }
+    if (data_) { Base::unmap(); }
   }
 
   HostArray(Device &device,
@@ -40,7 +41,7 @@ class HostArray : public BasicArray<Alloc> {
             vk::MemoryPropertyFlags memory_flags = {},
             vk::BufferUsageFlags buffer_flags = {})
       : BasicArray<Alloc>(device, element_nums * sizeof(T), memory_flags, buffer_flags),
-        data_(static_cast<value_type *>(Base::device_.mapMemory(Base::mem_, 0, element_nums * sizeof(T)))),
+        data_(static_cast<value_type *>(Base::map(element_nums * sizeof(T)))),
         size_(element_nums) {
   };
 
@@ -50,7 +51,7 @@ class HostArray : public BasicArray<Alloc> {
             vk::MemoryPropertyFlags memory_flags = {},
             vk::BufferUsageFlags buffer_flags = {})
       : HostArray(device, element_nums, memory_flags, buffer_flags) {
-    ::std::fill_n(begin(), element_nums, value);
+    parallel::fill_n(begin(), element_nums, value);
   };
 
   template<typename It, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
@@ -60,7 +61,7 @@ class HostArray : public BasicArray<Alloc> {
             vk::MemoryPropertyFlags memory_flags = {},
             vk::BufferUsageFlags buffer_flags = {})
       : HostArray(device, ::std::distance(begin, end), memory_flags, buffer_flags) {
-    ::std::copy(begin, end, this->begin());
+    parallel::copy_to_mapped(begin, size(), data(), !Base::isHostCached());
   }
 
   HostArray(HostArray &&other)
@@ -82,14 +83,24 @@ class HostArray : public BasicArray<Alloc> {
   [[nodiscard]] uint32_t size() const { return size_; }
   [[nodiscard]] uint32_t size_bytes() const { return size_ * sizeof(T); }
 
-  value_type *data() { return data_; }
-  const value_type *data() const { return data_; }
+  /**
+   * @brief host access waits for the pending device accesses it conflicts with
+   */
+  value_type *data() {
+    Base::syncHost(true);
+    return data_;
+  }
+
+  const value_type *data() const {
+    Base::syncHost(false);
+    return data_;
+  }
 
-  value_type *begin() { return data_; }
-  const value_type *begin() const { return data_; }
+  value_type *begin() { return data(); }
+  const value_type *begin() const { return data(); }
 
-  value_type *end() { return begin() + size(); }
-  const value_type *end() const { return begin() + size(); }
+  value_type *end() { return data() + size_; }
+  const value_type *end() const { return data() + size_; }
 
   ArrayIter<HostArray> device_begin() { return ArrayIter<HostArray>(*this, 0); }
   ArrayIter<HostArray> device_begin() const { return ArrayIter<HostArray>(*this, 0); }
@@ -98,8 +109,8 @@ class HostArray : public BasicArray<Alloc> {
   ArrayIter<HostArray> device_end() const { return ArrayIter<HostArray>(*this, size_); }
   friend ArrayIter<HostArray> device_end(HostArray &array) { return array.device_end(); }
 
-  value_type &operator[](::std::size_t index) { return *(begin() + index); }
-  value_type operator[](::std::size_t index) const { return *(begin() + index); }
+  value_type &operator[](::std::size_t index) { return data()[index]; }
+  value_type operator[](::std::size_t index) const { return data()[index]; }
 };
 
 } // namespace vuml::array
@@ -36,6 +36,17 @@ struct HostCached {
   static constexpr bufflags_t buffer = static_cast<bufflags_t>(vk::BufferUsageFlagBits::eTransferDst);
 };
 
+/**
+ * @brief small read-only tables written by the host and bound with uniform(): read through the uniform cache
+ */
+struct Uniform {
+  using fallback_t = Host;
+  static constexpr memflags_t memory = static_cast<memflags_t>(
+      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+  );
+  static constexpr bufflags_t buffer = static_cast<bufflags_t>(vk::BufferUsageFlagBits::eUniformBuffer);
+};
+
 struct Unified {
   using fallback_t = void;
   static constexpr memflags_t memory = static_cast<memflags_t>(
@@ -7,8 +7,12 @@
 
 #include <cstdint>
 
+#include <array>
+#include <string>
 #include <vector>
 
+#include "sync.h"
+
 #include <vulkan/vulkan.hpp>
 
 namespace vuml {
@@ -17,20 +21,132 @@ inline namespace v1 {
 
 class Instance;
 
+/**
+ * @brief what to do when device memory cannot be allocated
+ */
+enum class AllocPolicy {
+  eFailFast,  // throw
+  eFallback,  // use the fallback memory properties of the allocator, counted by Device::fallbackCount()
+  eEvict,     // move least recently used evictable arrays to host memory, then retry
+};
+
+struct HeapBudget {
+  vk::DeviceSize size = 0;     // heap size
+  vk::DeviceSize budget = 0;   // what the process can use, heap size without VK_EXT_memory_budget
+  vk::DeviceSize usage = 0;    // what the process uses, tracked usage without VK_EXT_memory_budget
+  vk::DeviceSize tracked = 0;  // live bytes allocated by vuml
+};
+
+/**
+ * @brief the subgroups of the compute stage, read from the properties2 chain
+ */
+struct SubgroupProperties {
+  uint32_t size = 0;                    // what the driver picks by default, 0 when it cannot be queried
+  uint32_t min_size = 0;                // the sizes a pipeline can require, equal to size without size control
+  uint32_t max_size = 0;
+  vk::SubgroupFeatureFlags operations;  // the subgroup operations of the compute stage, empty if it has none
+  bool size_control = false;            // VK_EXT_subgroup_size_control is enabled for compute pipelines
+  bool full_subgroups = false;          // pipelines can require full subgroups
+
+  [[nodiscard]] bool supports(vk::SubgroupFeatureFlags ops) const { return (operations & ops) == ops; }
+};
+
+/**
+ * @brief optional shader features: the ones to enable when creating a device, the ones enabled in
+ * Device::features(). Besides 16-bit integers and 64-bit types, they need Vulkan 1.2.
+ */
+struct DeviceFeatures {
+  bool shader_float16 = false;
+  bool shader_float64 = false;
+  bool shader_int8 = false;
+  bool shader_int16 = false;
+  bool shader_int64 = false;
+  bool storage_buffer_8bit = false;   // 8-bit types in storage buffers
+  bool uniform_buffer_8bit = false;   // and in uniform buffers
+  bool push_constant_8bit = false;
+  bool storage_buffer_16bit = false;  // 16-bit types in storage buffers
+  bool uniform_buffer_16bit = false;  // and in uniform buffers
+  bool push_constant_16bit = false;
+  bool buffer_int64_atomics = false;
+  bool shared_int64_atomics = false;
+  bool storage_image_read_without_format = false;
+  bool storage_image_write_without_format = false;
+
+  /**
+   * @brief every feature, the device enables the ones it has
+   */
+  static DeviceFeatures all() {
+    auto r = DeviceFeatures{};
+    r.shader_float16 = r.shader_float64 = r.shader_int8 = r.shader_int16 = r.shader_int64 = true;
+    r.storage_buffer_8bit = r.uniform_buffer_8bit = r.push_constant_8bit = true;
+    r.storage_buffer_16bit = r.uniform_buffer_16bit = r.push_constant_16bit = true;
+    r.buffer_int64_atomics = r.shared_int64_atomics = true;
+    r.storage_image_read_without_format = r.storage_image_write_without_format = true;
+    return r;
+  }
+};
+
+/**
+ * @brief a resource which can move its device memory to the host under memory pressure
+ */
+class Evictable {
+ public:
+  [[nodiscard]] virtual uint32_t heap() const = 0;
+  [[nodiscard]] virtual uint64_t lastUse() const = 0;
+  [[nodiscard]] virtual bool resident() const = 0;
+  /**
+   * @return bytes released on the heap
+   */
+  virtual vk::DeviceSize evict() = 0;
+
+ protected:
+  ~Evictable() = default;
+};
+
 class Device : public vk::Device {
  private:
+  struct Timeline {
+    vk::Semaphore semaphore;
+    uint64_t value = 0;      // last value signaled by a submission
+    uint64_t completed = 0;  // last value known to be reached
+  };
+
+  struct TransferSlot {
+    vk::CommandBuffer cmd_buffer;
+    SyncPoint done;  // the last submission of the command buffer
+  };
+
   Instance &instance_;
   vk::PhysicalDevice phy_device_;
   vk::CommandPool compute_cmd_pool_;
   vk::CommandBuffer compute_cmd_buffer_;
   vk::CommandPool transfer_cmd_pool_;
   vk::CommandBuffer transfer_cmd_buffer_;
+  ::std::vector<TransferSlot> transfer_ring_;
+  ::std::size_t transfer_next_ = 0;
   uint32_t cmp_family_id_ = -1U;
   uint32_t tfr_family_id_ = -1U;
   ::std::vector<const char *> extensions_;
+  Timeline compute_timeline_;
+  Timeline transfer_timeline_;
+  ::std::array<vk::DeviceSize, VK_MAX_MEMORY_HEAPS> heap_tracked_ = {};
+  AllocPolicy alloc_policy_ = AllocPolicy::eFallback;
+  uint64_t fallback_count_ = 0;
+  uint64_t use_tick_ = 0;
+  ::std::vector<Evictable *> evictables_;
+  bool evicting_ = false;
+  bool memory_budget_ = false;
+  SubgroupProperties subgroup_;
+  DeviceFeatures features_;
 
  public:
-  explicit Device(Instance &instance, vk::PhysicalDevice &phy_device, const ::std::vector<const char *> &extensions);
+  /**
+   * @brief features are enabled where the device has them, see features()
+   */
+  explicit Device(Instance &instance,
+                  vk::PhysicalDevice &phy_device,
+                  const ::std::vector<const char *> &extensions,
+                  const DeviceFeatures &features = {});
   ~Device() noexcept;
   Device(const Device &);
   Device &operator=(Device);
@@ -39,13 +155,32 @@ class Device : public vk::Device {
   friend void swap(Device &, Device &);
 
   [[nodiscard]] vk::PhysicalDeviceProperties properties() const;
+  /**
+   * @brief subgroup size, the range a pipeline can require and the supported operations, see
+   * Program::setSubgroupSize()
+   */
+  [[nodiscard]] const SubgroupProperties &subgroup() const { return subgroup_; }
+  /**
+   * @brief the optional features enabled on the device
+   */
+  [[nodiscard]] const DeviceFeatures &features() const { return features_; }
+  /**
+   * @brief the SPIR-V capabilities the device cannot run, by name: features not enabled, subgroup operations not
+   * supported by the compute stage. Capabilities it does not know are assumed to be there.
+   */
+  [[nodiscard]] ::std::vector<::std::string> missingCapabilities(const ::std::vector<uint32_t> &capabilities) const;
   [[nodiscard]] vk::MemoryPropertyFlags memoryProperties(uint32_t id) const;
+  [[nodiscard]] vk::FormatProperties formatProperties(vk::Format format) const;
   [[nodiscard]] static uint32_t numComputeQueues() { return 1u; }
   [[nodiscard]] static uint32_t numTransferQueues() { return 1u; }
   [[nodiscard]] uint32_t selectMemory(vk::Buffer buffer, vk::MemoryPropertyFlags properties) const;
+  [[nodiscard]] uint32_t selectMemory(const vk::MemoryRequirements &requirements,
+                                      vk::MemoryPropertyFlags properties) const;
   Instance &instance() { return instance_; }
   [[nodiscard]] const Instance &instance() const { return instance_; }
   [[nodiscard]] bool hasSeparateQueues() const { return cmp_family_id_ == tfr_family_id_; }
+  [[nodiscard]] uint32_t computeFamily() const { return cmp_family_id_; }
+  [[nodiscard]] uint32_t transferFamily() const { return tfr_family_id_; }
 
   vk::Queue computeQueue(uint32_t i = 0);
   vk::Queue transferQueue(uint32_t i = 0);
@@ -54,23 +189,76 @@ class Device : public vk::Device {
   vk::CommandBuffer &computeCmdBuffer() { return compute_cmd_buffer_; }
   vk::CommandPool transferCmdPool() { return transfer_cmd_pool_; }
   vk::CommandBuffer &transferCmdBuffer() { return transfer_cmd_buffer_; }
+  /**
+   * @brief the next command buffer of a small ring for short transfers, so that a copy does not wait for the previous
+   * one. It waits only for the last submission of that command buffer, submit it with submitTransfer().
+   */
+  vk::CommandBuffer nextTransferCmdBuffer();
+  SyncPoint submitTransfer(vk::CommandBuffer cmd_buffer, const ::std::vector<SyncPoint> &waits = {});
   vk::Pipeline createPipeline(vk::PipelineLayout pipeline_layout,
                               vk::PipelineCache pipeline_cache,
                               const vk::PipelineShaderStageCreateInfo &shader_stage_info,
                               vk::PipelineCreateFlags flags = {});
+  /**
+   * @brief create several pipelines with one call, which lets the driver compile them in parallel
+   */
+  ::std::vector<vk::Pipeline> createPipelines(vk::PipelineCache pipeline_cache,
+                                              const ::std::vector<vk::ComputePipelineCreateInfo> &infos);
   vk::CommandBuffer releaseComputeCmdBuffer();
 
+  /**
+   * @brief whether submissions are tracked with timeline semaphores, otherwise every submission waits for idle
+   */
+  [[nodiscard]] bool hasTimelineSemaphore() const { return static_cast<bool>(compute_timeline_.semaphore); }
+
+  /**
+   * @brief submit a command buffer which starts once every point of waits is reached
+   * @return the point reached when the command buffer completes
+   */
+  SyncPoint submit(QueueKind queue, vk::CommandBuffer cmd_buffer, const ::std::vector<SyncPoint> &waits = {});
+  [[nodiscard]] SyncPoint lastSubmit(QueueKind queue) const;
+  bool reached(const SyncPoint &point);
+  void wait(const SyncPoint &point);
+
+  [[nodiscard]] uint32_t heapIndex(uint32_t memory_id) const;
+  [[nodiscard]] HeapBudget heapBudget(uint32_t heap) const;
+  [[nodiscard]] ::std::vector<HeapBudget> memoryBudget() const;
+  [[nodiscard]] bool hasMemoryBudget() const { return memory_budget_; }
+  void trackAlloc(uint32_t memory_id, vk::DeviceSize size);
+  void trackFree(uint32_t memory_id, vk::DeviceSize size);
+
+  [[nodiscard]] AllocPolicy allocPolicy() const { return alloc_policy_; }
+  void setAllocPolicy(AllocPolicy policy) { alloc_policy_ = policy; }
+  /**
+   * @brief allocations which silently landed in fallback memory, worth alerting on
+   */
+  [[nodiscard]] uint64_t fallbackCount() const { return fallback_count_; }
+  void countFallback() { ++fallback_count_; }
+
+  uint64_t nextUse() { return ++use_tick_; }
+  void registerEvictable(Evictable *evictable);
+  void unregisterEvictable(Evictable *evictable);
+  /**
+   * @brief evict the least recently used resident resources of a heap until bytes are released
+   * @return bytes released
+   */
+  vk::DeviceSize evict(uint32_t heap, vk::DeviceSize bytes);
+
  private:
   Device(Instance &instance,
          vk::PhysicalDevice phy_device,
          const std::vector<vk::QueueFamilyProperties> &families,
-         const ::std::vector<const char *> &extensions);
+         const ::std::vector<const char *> &extensions,
+         const DeviceFeatures &features);
   Device(Instance &instance,
          vk::PhysicalDevice phy_device,
          uint32_t cmp_family_id,
          uint32_t tfr_family_id,
-         const ::std::vector<const char *> &extensions);
+         const ::std::vector<const char *> &extensions,
+         const DeviceFeatures &features);
   void release();
+  Timeline &timeline(QueueKind queue);
+  Timeline &timeline(vk::Semaphore semaphore);
 };
 
 } // namespace v1
@@ -0,0 +1,254 @@
+//
+// Created by Homin Su on 2023/7/8.
+//
+
+#ifndef VUML_INCLUDE_VUML_DEVICE_GROUP_H_
+#define VUML_INCLUDE_VUML_DEVICE_GROUP_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "array.h"
+#include "device.h"
+#include "logger.h"
+#include "shaders.h"
+#include "utils.h"
+#include "vuml.h"
+
+namespace vuml {
+
+enum class Sharding {
+  eBlock,       // shard i holds a contiguous range of the elements
+  eRoundRobin,  // element j lives on shard j % n
+  eReplicate,   // every shard holds all the elements
+};
+
+/**
+ * @brief an array split across the devices of a DeviceGroup, one DeviceArray per device
+ */
+template<typename T, class Alloc = memory::Device>
+class ShardedArray {
+ public:
+  using value_type = T;
+  using shard_type = Array<T, Alloc>;
+
+ private:
+  ::std::vector<shard_type> shards_;
+  Sharding sharding_;
+  ::std::size_t size_;
+
+ public:
+  ShardedArray(::std::vector<shard_type> shards, Sharding sharding, ::std::size_t size)
+      : shards_(::std::move(shards)), sharding_(sharding), size_(size) {
+  }
+
+  [[nodiscard]] ::std::size_t size() const { return size_; }
+  [[nodiscard]] Sharding sharding() const { return sharding_; }
+  [[nodiscard]] ::std::size_t numShards() const { return shards_.size(); }
+  shard_type &shard(::std::size_t i) { return shards_.at(i); }
+  const shard_type &shard(::std::size_t i) const { return shards_.at(i); }
+};
+
+/**
+ * @brief runs the same job data-parallel on several devices, each device works on its own shard. Data moves between
+ * devices through host staging.
+ */
+class DeviceGroup {
+ private:
+  ::std::vector<Device *> devices_;
+
+ public:
+  explicit DeviceGroup(::std::vector<Device> &devices) {
+    for (auto &device : devices) {
+      devices_.push_back(&device);
+    }
+    if (devices_.empty()) {
+      ERROR("device group is empty");
+      throw ::std::invalid_argument("device group is empty");
+    }
+  }
+
+  [[nodiscard]] ::std::size_t size() const { return devices_.size(); }
+  Device &device(::std::size_t i) { return *devices_.at(i); }
+
+  /**
+   * @brief number of elements of shard i when n elements are split in blocks
+   */
+  [[nodiscard]] ::std::size_t blockSize(::std::size_t n, ::std::size_t i) const {
+    auto base = n / size();
+    return base + (i < n % size() ? 1 : 0);
+  }
+
+  [[nodiscard]] ::std::size_t blockOffset(::std::size_t n, ::std::size_t i) const {
+    auto base = n / size();
+    return base * i + ::std::min(i, n % size());
+  }
+
+  /**
+   * @brief number of shards of an array of n elements, a device that would hold no element gets no shard (a buffer
+   * cannot be empty), the shards are on the first devices of the group
+   */
+  [[nodiscard]] ::std::size_t numShards(::std::size_t n, Sharding sharding) const {
+    return sharding == Sharding::eReplicate ? (n != 0 ? size() : 0) : ::std::min(n, size());
+  }
+
+  /**
+   * @brief the same program on every device of the group
+   */
+  template<typename Prog>
+  ::std::vector<Prog> programs(const ::std::vector<uint32_t> &spirv) {
+    auto r = ::std::vector<Prog>{};
+    r.reserve(size());
+    for (auto *device : devices_) {
+      r.emplace_back(*device, spirv);
+    }
+    return r;
+  }
+
+  template<typename Prog>
+  ::std::vector<Prog> programs(const char *file) {
+    auto spirv = SpirvFile(file);
+    auto r = ::std::vector<Prog>{};
+    r.reserve(size());
+    for (auto *device : devices_) {
+      r.emplace_back(*device, spirv);
+    }
+    return r;
+  }
+
+  template<typename Prog>
+  ::std::vector<Prog> programs(const shaders::Shader &shader) {
+    auto r = ::std::vector<Prog>{};
+    r.reserve(size());
+    for (auto *device : devices_) {
+      r.emplace_back(*device, shader);
+    }
+    return r;
+  }
+
+  /**
+   * @brief upload host data to the devices of the group
+   */
+  template<typename T, class Alloc = memory::Device, typename C>
+  ShardedArray<T, Alloc> scatter(const C &c, Sharding sharding = Sharding::eBlock) {
+    auto n = static_cast<::std::size_t>(::std::distance(::std::begin(c), ::std::end(c)));
+    auto shards = ::std::vector<typename ShardedArray<T, Alloc>::shard_type>{};
+    shards.reserve(numShards(n, sharding));
+    for (::std::size_t i = 0; i < numShards(n, sharding); ++i) {
+      auto &device = *devices_[i];
+      switch (sharding) {
+        case Sharding::eBlock: {
+          auto first = ::std::next(::std::begin(c), static_cast<::std::ptrdiff_t>(blockOffset(n, i)));
+          shards.emplace_back(device, first, ::std::next(first, static_cast<::std::ptrdiff_t>(blockSize(n, i))));
+          break;
+        }
+        case Sharding::eRoundRobin: {
+          auto part = ::std::vector<T>{};
+          part.reserve(n / size() + 1);
+          auto it = ::std::next(::std::begin(c), static_cast<::std::ptrdiff_t>(i));
+          for (auto j = i; j < n; j += size()) {
+            part.push_back(*it);
+            if (j + size() < n) { ::std::advance(it, static_cast<::std::ptrdiff_t>(size())); }
+          }
+          shards.emplace_back(device, part.begin(), part.end());
+          break;
+        }
+        case Sharding::eReplicate:shards.emplace_back(device, ::std::begin(c), ::std::end(c));
+          break;
+      }
+    }
+    return {::std::move(shards), sharding, n};
+  }
+
+  /**
+   * @brief uninitialized sharded array of n elements
+   */
+  template<typename T, class Alloc = memory::Device>
+  ShardedArray<T, Alloc> alloc(::std::size_t n, Sharding sharding = Sharding::eBlock) {
+    auto shards = ::std::vector<typename ShardedArray<T, Alloc>::shard_type>{};
+    shards.reserve(numShards(n, sharding));
+    for (::std::size_t i = 0; i < numShards(n, sharding); ++i) {
+      auto shard_size = sharding == Sharding::eReplicate ? n
+                      : sharding == Sharding::eBlock ? blockSize(n, i)
+                                                     : (n - i + size() - 1) / size();
+      shards.emplace_back(*devices_[i], shard_size);
+    }
+    return {::std::move(shards), sharding, n};
+  }
+
+  /**
+   * @brief download the shards back into host order, a replicated array is read from its first shard
+   */
+  template<typename T, class Alloc, typename It>
+  void gather(const ShardedArray<T, Alloc> &array, It dst) {
+    switch (array.sharding()) {
+      case Sharding::eBlock:
+        for (::std::size_t i = 0; i < array.numShards(); ++i) {
+          array.shard(i).toHost(::std::next(dst, static_cast<::std::ptrdiff_t>(blockOffset(array.size(), i))));
+        }
+        break;
+      case Sharding::eRoundRobin:
+        for (::std::size_t i = 0; i < array.numShards(); ++i) {
+          auto part = array.shard(i).template toHost<::std::vector<T>>();
+          for (::std::size_t k = 0; k < part.size(); ++k) {
+            *::std::next(dst, static_cast<::std::ptrdiff_t>(i + k * size())) = part[k];
+          }
+        }
+        break;
+      case Sharding::eReplicate:
+        if (array.numShards() != 0) { array.shard(0).toHost(dst); }
+        break;
+    }
+  }
+
+  /**
+   * @brief combine a replicated array element-wise across the devices and write the result to every shard
+   */
+  template<typename T, class Alloc, typename F>
+  void allReduce(ShardedArray<T, Alloc> &array, F &&op) {
+    if (array.sharding() != Sharding::eReplicate) {
+      ERROR("all-reduce needs a replicated array");
+      throw ::std::invalid_argument("all-reduce needs a replicated array");
+    }
+    if (array.numShards() == 0) {
+      return;
+    }
+    auto result = array.shard(0).template toHost<::std::vector<T>>();
+    auto part = ::std::vector<T>(result.size());
+    for (::std::size_t i = 1; i < array.numShards(); ++i) {
+      array.shard(i).toHost(part.begin());
+      ::std::transform(result.begin(), result.end(), part.begin(), result.begin(), op);
+    }
+    for (::std::size_t i = 0; i < array.numShards(); ++i) {
+      array.shard(i).fromHost(result.begin(), result.end());
+    }
+  }
+
+  /**
+   * @brief bind programs[i] to shard i of every array with `bind(program, i, shards...)` and run them so that all
+   * the devices work at the same time, then wait for all of them. A device without a shard of every array is left
+   * idle, see numShards().
+   */
+  template<typename Prog, typename F, typename ...Sharded>
+  void launch(::std::vector<Prog> &programs, F &&bind, Sharded &...arrays) {
+    VUML_ASSERT(programs.size() == size() && "one program per device");
+    auto active = ::std::min<::std::size_t>({size(), arrays.numShards()...});
+    for (::std::size_t i = 0; i < active; ++i) {
+      bind(programs[i], i, arrays.shard(i)...);
+      programs[i].run();
+    }
+    for (::std::size_t i = 0; i < active; ++i) {
+      programs[i].wait();
+    }
+  }
+};
+
+} // namespace vuml
+
+#endif //VUML_INCLUDE_VUML_DEVICE_GROUP_H_
@@ -0,0 +1,115 @@
+//
+// Created by Homin Su on 2023/7/24.
+//
+
+#ifndef VUML_INCLUDE_VUML_GLSL_H_
+#define VUML_INCLUDE_VUML_GLSL_H_
+
+#include <cstdint>
+
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "logger.h"
+
+#include <vulkan/vulkan.hpp>
+
+namespace vuml::glsl {
+
+/**
+ * @brief preprocessor definitions, name and value, e.g. {"TILE", "16"}. Unlike spec constants they can size any
+ * array, pick types and remove code.
+ */
+using Defines = ::std::vector<::std::pair<::std::string, ::std::string>>;
+
+struct CompileOptions {
+  Defines defines;
+  // picks the SPIR-V version, subgroup operations need 1.1 or later
+  uint32_t vulkan_version = VK_API_VERSION_1_0;
+  bool optimize = true;
+};
+
+/**
+ * @brief whether vuml was built with VUML_ENABLE_SHADERC, without it compile() throws and shaders are compiled
+ * offline by vuml_add_shaders()
+ */
+bool available();
+
+/**
+ * @brief compile a GLSL compute shader to SPIR-V with shaderc, e.g. for Program(device, *spirv). The modules are
+ * kept for the process, keyed by the source, the options and the name, so the same program is compiled once. #include
+ * is not supported. Throws on errors, the log has the messages.
+ * @param name the file name used in the messages
+ */
+::std::shared_ptr<const ::std::vector<uint32_t>> compile(const ::std::string &source,
+                                                         const CompileOptions &options = {},
+                                                         const ::std::string &name = "shader.comp");
+
+::std::shared_ptr<const ::std::vector<uint32_t>> compile_file(const ::std::string &path,
+                                                              const CompileOptions &options = {});
+
+/**
+ * @brief forget the compiled modules, the ones still held stay valid
+ */
+void clear_cache();
+
+/**
+ * @brief a GLSL file compiled again whenever it changes on disk, to tune a kernel without restarting:
+ *
+ *   auto watch = glsl::ShaderWatch("gemm.comp", options);
+ *   auto program = Program<...>(device, watch.spirv());
+ *   for (;;) {
+ *     watch.reload(program);
+ *     program(params, a, b, c);
+ *   }
+ */
+class ShaderWatch {
+ private:
+  ::std::string path_;
+  CompileOptions options_;
+  ::std::filesystem::file_time_type modified_;
+  ::std::shared_ptr<const ::std::vector<uint32_t>> spirv_;
+
+ public:
+  /**
+   * @brief compiles the file now, throws if it does not compile
+   */
+  explicit ShaderWatch(::std::string path, CompileOptions options = {});
+
+  [[nodiscard]] const ::std::vector<uint32_t> &spirv() const { return *spirv_; }
+
+  /**
+   * @brief compile the file again if it was modified since the last time. A failed compilation is logged and the
+   * previous module kept, the edit can be fixed and saved again. The edits are not kept in the cache of compile().
+   * @return whether the module changed
+   */
+  bool poll();
+
+  /**
+   * @brief poll() and give the new module to the program, call it between dispatches. The program keeps its shader
+   * if the new one does not fit it, see ProgramBase::reload().
+   * @return whether the program was reloaded
+   */
+  template<class Prog>
+  bool reload(Prog &program) {
+    if (!poll()) {
+      return false;
+    }
+    try {
+      program.reload(*spirv_);
+    } catch (::std::exception &e) {
+      WARN("%s not reloaded: %s", path_.c_str(), e.what());
+      return false;
+    }
+    INFO("%s reloaded", path_.c_str());
+    return true;
+  }
+};
+
+} // namespace vuml::glsl
+
+#endif //VUML_INCLUDE_VUML_GLSL_H_
@@ -0,0 +1,92 @@
+//
+// Created by Homin Su on 2023/7/20.
+//
+
+#ifndef VUML_INCLUDE_VUML_HALF_H_
+#define VUML_INCLUDE_VUML_HALF_H_
+
+#include <cstdint>
+#include <cstring>
+
+namespace vuml {
+
+/**
+ * @brief IEEE 754 binary16 element, storage only: the arithmetic happens in float, on the device or through to_float()
+ */
+struct half {
+  uint16_t bits;
+};
+
+/**
+ * @brief bfloat16 element, the upper half of a float
+ */
+struct bfloat16 {
+  uint16_t bits;
+};
+
+/**
+ * @brief round to nearest even, overflows to infinity
+ */
+inline half to_half(float value) {
+  constexpr uint32_t f32_infinity = 255u << 23;
+  constexpr uint32_t f16_max = (127u + 16u) << 23;
+  constexpr uint32_t denorm_magic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+  uint32_t x;
+  ::std::memcpy(&x, &value, sizeof(x));
+  auto sign = x & 0x80000000u;
+  x ^= sign;
+  uint32_t bits;
+  if (x >= f16_max) {
+    bits = x > f32_infinity ? 0x7e00u : 0x7c00u;
+  } else if (x < (113u << 23)) {
+    // subnormal: the float addition does the rounding
+    float f, magic;
+    ::std::memcpy(&f, &x, sizeof(f));
+    ::std::memcpy(&magic, &denorm_magic, sizeof(magic));
+    f += magic;
+    ::std::memcpy(&bits, &f, sizeof(bits));
+    bits -= denorm_magic;
+  } else {
+    auto odd = (x >> 13) & 1u;
+    x += ((15u - 127u) << 23) + 0xfffu + odd;
+    bits = x >> 13;
+  }
+  return {static_cast<uint16_t>(bits | (sign >> 16))};
+}
+
+inline float to_float(half value) {
+  auto sign = static_cast<uint32_t>(value.bits & 0x8000u) << 16;
+  auto exponent = (value.bits >> 10) & 0x1fu;
+  auto mantissa = static_cast<uint32_t>(value.bits & 0x3ffu);
+  if (exponent == 0) {
+    auto f = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+    return sign != 0 ? -f : f;
+  }
+  auto x = sign | (exponent == 0x1fu ? 0x7f800000u : (exponent + 112u) << 23) | mantissa << 13;
+  float f;
+  ::std::memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+/**
+ * @brief round to nearest even, NaNs stay quiet NaNs
+ */
+inline bfloat16 to_bfloat16(float value) {
+  uint32_t x;
+  ::std::memcpy(&x, &value, sizeof(x));
+  if ((x & 0x7fffffffu) > 0x7f800000u) {
+    return {static_cast<uint16_t>((x >> 16) | 0x40u)};
+  }
+  return {static_cast<uint16_t>((x + 0x7fffu + ((x >> 16) & 1u)) >> 16)};
+}
+
+inline float to_float(bfloat16 value) {
+  auto x = static_cast<uint32_t>(value.bits) << 16;
+  float f;
+  ::std::memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+} // namespace vuml
+
+#endif //VUML_INCLUDE_VUML_HALF_H_
@@ -0,0 +1,299 @@
+//
+// Created by Homin Su on 2023/7/21.
+//
+
+#ifndef VUML_INCLUDE_VUML_IMAGE_H_
+#define VUML_INCLUDE_VUML_IMAGE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+
+#include "arg.h"
+#include "array.h"
+#include "device.h"
+#include "half.h"
+#include "logger.h"
+#include "non_copyable.h"
+#include "parallel.h"
+#include "sync.h"
+#include "traits.h"
+#include "utils.h"
+
+#include <vulkan/vulkan.hpp>
+
+namespace vuml {
+
+/**
+ * @brief how a sampled image is read, see sampled()
+ */
+struct SamplerDesc {
+  vk::Filter filter = vk::Filter::eLinear;
+  vk::SamplerAddressMode address_mode = vk::SamplerAddressMode::eClampToEdge;
+  // coordinates in [0, 1], otherwise in texels
+  bool normalized = true;
+};
+
+namespace details {
+
+template<typename T>
+struct dependent_false : ::std::false_type {};
+
+/**
+ * @brief the format of an image of T: integers stay integers, pass an explicit format for normalized ones, e.g.
+ * Image2D<uint8_t, vk::Format::eR8Unorm>
+ */
+template<typename T>
+constexpr vk::Format image_format() {
+  if constexpr (::std::is_same_v<T, float>) {
+    return vk::Format::eR32Sfloat;
+  } else if constexpr (::std::is_same_v<T, half>) {
+    return vk::Format::eR16Sfloat;
+  } else if constexpr (::std::is_same_v<T, int32_t>) {
+    return vk::Format::eR32Sint;
+  } else if constexpr (::std::is_same_v<T, uint32_t>) {
+    return vk::Format::eR32Uint;
+  } else if constexpr (::std::is_same_v<T, int16_t>) {
+    return vk::Format::eR16Sint;
+  } else if constexpr (::std::is_same_v<T, uint16_t>) {
+    return vk::Format::eR16Uint;
+  } else if constexpr (::std::is_same_v<T, int8_t>) {
+    return vk::Format::eR8Sint;
+  } else if constexpr (::std::is_same_v<T, uint8_t>) {
+    return vk::Format::eR8Uint;
+  } else if constexpr (::std::is_same_v<T, ::std::array<float, 2>>) {
+    return vk::Format::eR32G32Sfloat;
+  } else if constexpr (::std::is_same_v<T, ::std::array<float, 4>>) {
+    return vk::Format::eR32G32B32A32Sfloat;
+  } else if constexpr (::std::is_same_v<T, ::std::array<half, 2>>) {
+    return vk::Format::eR16G16Sfloat;
+  } else if constexpr (::std::is_same_v<T, ::std::array<half, 4>>) {
+    return vk::Format::eR16G16B16A16Sfloat;
+  } else if constexpr (::std::is_same_v<T, ::std::array<uint8_t, 4>>) {
+    return vk::Format::eR8G8B8A8Uint;
+  } else {
+    static_assert(dependent_false<T>::value, "no image format for this texel type, pass one explicitly");
+    return vk::Format::eUndefined;
+  }
+}
+
+/**
+ * @brief bytes of a texel of the formats above and their normalized variants, 0 for the ones vuml does not know
+ */
+constexpr ::std::size_t texel_size(vk::Format format) {
+  switch (format) {
+    case vk::Format::eR8Unorm:
+    case vk::Format::eR8Snorm:
+    case vk::Format::eR8Uint:
+    case vk::Format::eR8Sint:return 1;
+    case vk::Format::eR8G8Unorm:
+    case vk::Format::eR8G8Snorm:
+    case vk::Format::eR8G8Uint:
+    case vk::Format::eR8G8Sint:
+    case vk::Format::eR16Unorm:
+    case vk::Format::eR16Snorm:
+    case vk::Format::eR16Uint:
+    case vk::Format::eR16Sint:
+    case vk::Format::eR16Sfloat:return 2;
+    case vk::Format::eR8G8B8A8Unorm:
+    case vk::Format::eR8G8B8A8Snorm:
+    case vk::Format::eR8G8B8A8Uint:
+    case vk::Format::eR8G8B8A8Sint:
+    case vk::Format::eR8G8B8A8Srgb:
+    case vk::Format::eB8G8R8A8Unorm:
+    case vk::Format::eB8G8R8A8Srgb:
+    case vk::Format::eR16G16Unorm:
+    case vk::Format::eR16G16Snorm:
+    case vk::Format::eR16G16Uint:
+    case vk::Format::eR16G16Sint:
+    case vk::Format::eR16G16Sfloat:
+    case vk::Format::eR32Uint:
+    case vk::Format::eR32Sint:
+    case vk::Format::eR32Sfloat:return 4;
+    case vk::Format::eR16G16B16A16Unorm:
+    case vk::Format::eR16G16B16A16Snorm:
+    case vk::Format::eR16G16B16A16Uint:
+    case vk::Format::eR16G16B16A16Sint:
+    case vk::Format::eR16G16B16A16Sfloat:
+    case vk::Format::eR32G32Uint:
+    case vk::Format::eR32G32Sint:
+    case vk::Format::eR32G32Sfloat:return 8;
+    case vk::Format::eR32G32B32A32Uint:
+    case vk::Format::eR32G32B32A32Sint:
+    case vk::Format::eR32G32B32A32Sfloat:return 16;
+    default:return 0;
+  }
+}
+
+} // namespace details
+
+/**
+ * @brief an image in device memory, kept in the general layout. It gets the storage and sampled usages its format
+ * supports, and a sampler when it can be sampled. Bound as is, or with in() / out() / inout(), it is a storage image,
+ * with sampled() a combined image sampler read through the texture cache and filtered by the hardware.
+ */
+class BasicImage : private NonCopyable {
+ protected:
+  Device *device_;
+  vk::Image image_;
+  vk::DeviceMemory mem_;
+  vk::ImageView view_;
+  vk::Sampler sampler_;
+  vk::Format format_;
+  vk::Extent3D extent_;
+  vk::ImageUsageFlags usage_;
+  uint32_t mem_id_ = -1U;
+  vk::DeviceSize mem_size_ = 0;
+  mutable Hazards hazards_;
+  uint64_t generation_ = array::details::next_generation();
+
+ public:
+  BasicImage(Device &device,
+             vk::ImageType type,
+             vk::Format format,
+             vk::Extent3D extent,
+             vk::ImageUsageFlags flags = {});
+  ~BasicImage() noexcept;
+
+  BasicImage(BasicImage &&other) noexcept;
+  BasicImage &operator=(BasicImage &&other) noexcept;
+
+  Device &device() { return *device_; }
+  [[nodiscard]] vk::Image image() const { return image_; }
+  [[nodiscard]] vk::ImageView view() const { return view_; }
+  [[nodiscard]] vk::Sampler sampler() const { return sampler_; }
+  [[nodiscard]] vk::DeviceMemory memory() const { return mem_; }
+  [[nodiscard]] vk::Format format() const { return format_; }
+  [[nodiscard]] vk::Extent3D extent() const { return extent_; }
+  [[nodiscard]] vk::ImageUsageFlags usage() const { return usage_; }
+
+  [[nodiscard]] ::std::size_t texels() const {
+    return static_cast<::std::size_t>(extent_.width) * extent_.height * extent_.depth;
+  }
+
+  /**
+   * @brief changes when the image gets a new sampler, descriptors written for the previous one are stale
+   */
+  [[nodiscard]] uint64_t generation() const { return generation_; }
+
+  /**
+   * @brief last device accesses of the image
+   */
+  Hazards &hazards() const { return hazards_; }
+
+  [[nodiscard]] bool isStorage() const { return static_cast<bool>(usage_ & vk::ImageUsageFlagBits::eStorage); }
+  [[nodiscard]] bool isSampled() const { return static_cast<bool>(usage_ & vk::ImageUsageFlagBits::eSampled); }
+
+  /**
+   * @brief replace the sampler, linear filtering needs a format which supports it. Programs bound with the image
+   * must be bound again.
+   */
+  void setSampler(const SamplerDesc &desc);
+
+  [[nodiscard]] vk::DescriptorImageInfo descriptorInfo(vk::DescriptorType type) const;
+
+ private:
+  void release() noexcept;
+  void detach() noexcept;
+  [[nodiscard]] vk::Sampler create_sampler(const SamplerDesc &desc) const;
+};
+
+template<typename T, uint32_t Dims, vk::Format Format = details::image_format<T>()>
+class Image : public BasicImage {
+  static_assert(Dims == 2 || Dims == 3, "images have 2 or 3 dimensions");
+  // the texels are copied as is between the staging buffer and the image
+  static_assert(details::texel_size(Format) == 0 || details::texel_size(Format) == sizeof(T),
+                "the texel type does not have the size of a texel of the format");
+
+ public:
+  using value_type = T;
+  static constexpr auto descriptor_type = vk::DescriptorType::eStorageImage;
+
+  Image(Device &device, vk::Extent3D extent, vk::ImageUsageFlags flags = {})
+      : BasicImage(device, image_type(extent), Format, extent, flags) {
+  }
+
+  template<uint32_t D = Dims, class = typename ::std::enable_if_t<D == 2>>
+  Image(Device &device, uint32_t width, uint32_t height, vk::ImageUsageFlags flags = {})
+      : Image(device, vk::Extent3D(width, height, 1), flags) {
+  }
+
+  template<uint32_t D = Dims, class = typename ::std::enable_if_t<D == 3>>
+  Image(Device &device, uint32_t width, uint32_t height, uint32_t depth, vk::ImageUsageFlags flags = {})
+      : Image(device, vk::Extent3D(width, height, depth), flags) {
+  }
+
+  /**
+   * @brief texels in row-major order, x fastest, then y, then z
+   */
+  template<typename It, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
+  Image(Device &device, vk::Extent3D extent, It begin, It end, vk::ImageUsageFlags flags = {})
+      : Image(device, extent, flags) {
+    fromHost(begin, end);
+  }
+
+  /**
+   * @brief upload every texel, in row-major order, through a staging buffer
+   */
+  template<typename It, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
+  void fromHost(It begin, It end) {
+    check_texels(static_cast<::std::size_t>(::std::distance(begin, end)));
+    auto stage_buf = array::HostArray<value_type, memory::HostCoherent>(*device_, begin, end);
+    stage_buf.flush();
+    array::copy_buf_to_image(*device_, stage_buf, stage_buf.hazards(), image_, hazards_, extent_);
+  }
+
+  template<typename It, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
+  void toHost(It dst) const {
+    auto stage_buf = array::HostArray<value_type, memory::HostCached>(*device_, texels());
+    array::copy_image_to_buf(*device_, image_, hazards_, stage_buf, stage_buf.hazards(), extent_);
+    parallel::copy_from_mapped(stage_buf.data(), stage_buf.size(), dst, !stage_buf.isHostCached());
+  }
+
+  template<typename C, class = typename ::std::enable_if_t<traits::is_iterable_v<C>>>
+  C toHost() const {
+    auto ret = C(texels());
+    toHost(ret.begin());
+    return ret;
+  }
+
+ private:
+  static vk::ImageType image_type(vk::Extent3D extent) {
+    if constexpr (Dims == 2) {
+      if (extent.depth != 1) {
+        ERROR("a 2D image of depth %u", extent.depth);
+        throw ::std::invalid_argument("a 2D image has a depth of 1");
+      }
+      return vk::ImageType::e2D;
+    } else {
+      return vk::ImageType::e3D;
+    }
+  }
+
+  void check_texels(::std::size_t n) const {
+    if (n != texels()) {
+      ERROR("%zu texels for an image of %ux%ux%u", n, extent_.width, extent_.height, extent_.depth);
+      throw ::std::out_of_range("an image is uploaded whole");
+    }
+  }
+};
+
+template<typename T, vk::Format Format = details::image_format<T>()>
+using Image2D = Image<T, 2, Format>;
+
+template<typename T, vk::Format Format = details::image_format<T>()>
+using Image3D = Image<T, 3, Format>;
+
+/**
+ * @brief bind an image as a combined image sampler, e.g. for a sampler2D read with texture() or textureGather()
+ */
+template<class I, class = typename ::std::enable_if_t<::std::is_base_of_v<BasicImage, I>>>
+Arg<I, vk::DescriptorType::eCombinedImageSampler> sampled(I &image) { return {image, Access::eRead}; }
+
+} // namespace vuml
+
+#endif //VUML_INCLUDE_VUML_IMAGE_H_
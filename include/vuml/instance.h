@@ -5,8 +5,11 @@
 #ifndef VUML_INCLUDE_VUML_INSTANCE_H_
 #define VUML_INCLUDE_VUML_INSTANCE_H_
 
+#include <cstdint>
+
 #include <vector>
 
+#include "device.h"
 #include "non_copyable.h"
 
 #include <vulkan/vulkan.hpp>
@@ -17,20 +20,80 @@ inline namespace v1 {
 
 class Device;
 
+/**
+ * @brief what a physical device offers, read without creating a logical device
+ */
+struct PhysicalDeviceInfo {
+  vk::PhysicalDevice device;
+  uint32_t index = 0;
+  vk::PhysicalDeviceProperties properties;
+  vk::DeviceSize device_local_memory = 0;  // largest device local heap
+  uint32_t compute_queues = 0;             // queues of the largest compute family
+  uint32_t subgroup_size = 0;              // 0 when it cannot be queried
+  ::std::vector<vk::ExtensionProperties> extensions;
+
+  [[nodiscard]] bool hasExtension(const char *name) const;
+};
+
+/**
+ * @brief what Instance::select() looks for. Devices missing a hard requirement are never chosen, the eligible ones
+ * are ranked by type preference, then device local memory, compute queues and subgroup size.
+ */
+struct DeviceRequirements {
+  ::std::vector<const char *> extensions;
+  vk::DeviceSize min_device_local_memory = 0;
+  uint32_t min_compute_queues = 1;
+  uint32_t min_subgroup_size = 0;
+  // enabled where the selected device has them, they do not take part in the selection
+  DeviceFeatures features;
+  // most preferred first, the types not listed rank last but stay eligible
+  ::std::vector<vk::PhysicalDeviceType> preferred_types = {
+      vk::PhysicalDeviceType::eDiscreteGpu,
+      vk::PhysicalDeviceType::eIntegratedGpu,
+      vk::PhysicalDeviceType::eVirtualGpu,
+      vk::PhysicalDeviceType::eCpu,
+  };
+};
+
 class Instance : NonCopyable {
  private:
   vk::Instance instance_;
+  uint32_t api_version_;
 
  public:
   explicit Instance(const ::std::vector<const char *> &layers = {},
                     const ::std::vector<const char *> &extensions = {},
-                    const vk::ApplicationInfo &info = {nullptr, 0, nullptr, 0, VK_API_VERSION_1_0});
+                    const vk::ApplicationInfo &info = {nullptr, 0, nullptr, 0, VK_API_VERSION_1_2});
   ~Instance() noexcept;
   Instance(Instance &&) noexcept;
   Instance &operator=(Instance &&) noexcept;
 
+  [[nodiscard]] uint32_t apiVersion() const { return api_version_; }
+
+  /**
+   * @brief a logical device for every physical device, prefer physicalDevices() and select() on hosts with many
+   */
   ::std::vector<Device> devices(::std::vector<::std::vector<const char *>> devices_extensions = {});
 
+  /**
+   * @brief describe the physical devices without creating any logical device
+   */
+  [[nodiscard]] ::std::vector<PhysicalDeviceInfo> physicalDevices() const;
+
+  /**
+   * @return the score of a device against the requirements, higher is better, -1 when it does not meet them
+   */
+  static int64_t score(const PhysicalDeviceInfo &info, const DeviceRequirements &requirements);
+
+  /**
+   * @brief create the logical device of the best scored physical device only, with the required extensions
+   */
+  Device select(const DeviceRequirements &requirements = {});
+
+  Device device(const PhysicalDeviceInfo &info,
+                const ::std::vector<const char *> &extensions = {},
+                const DeviceFeatures &features = {});
+
  private:
   void clear() noexcept;
 };
@@ -0,0 +1,419 @@
+//
+// Created by Homin Su on 2023/7/14.
+//
+
+#ifndef VUML_INCLUDE_VUML_KERNELS_H_
+#define VUML_INCLUDE_VUML_KERNELS_H_
+
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+#include "arg.h"
+#include "array.h"
+#include "device.h"
+#include "half.h"
+#include "logger.h"
+#include "program.h"
+#include "shaders.h"
+#include "utils.h"
+#include "vuml.h"
+
+#include <vulkan/vulkan.hpp>
+
+namespace vuml {
+
+namespace kernels {
+
+/**
+ * @brief SPIR-V of the kernels shipped with the library, embedded in it. Throw if the library was built without
+ * VUML_EMBED_KERNELS.
+ */
+const shaders::Shader &dispatch_args();
+
+const shaders::Shader &compact();
+
+const shaders::Shader &convert();
+
+} // namespace kernels
+
+/**
+ * @brief turns an element count computed on the device into the workgroup counts of a Program::grid_indirect()
+ * dispatch, so a kernel sized by the output of another one does not wait for a readback
+ */
+class DispatchArgs {
+ private:
+  struct Params {
+    uint32_t count_index;
+    uint32_t group_size;
+    uint32_t args_index;
+    uint32_t max_groups;
+  };
+
+  Program<type_list<>, Params> program_;
+  uint32_t max_groups_;
+
+ public:
+  /**
+   * @brief usage the arguments array must be created with
+   */
+  static constexpr auto buffer_usage = vk::BufferUsageFlagBits::eIndirectBuffer;
+
+  explicit DispatchArgs(Device &device)
+      : program_(device, kernels::dispatch_args()),
+        max_groups_(device.properties().limits.maxComputeWorkGroupCount[0]) {
+    program_.grid(1);
+  }
+
+  /**
+   * @brief submit without waiting: args[args_index..args_index + 3) = {div_up(counts[count_index], group_size), 1, 1}
+   */
+  template<class Counts, class Args>
+  void operator()(Counts &counts, uint32_t count_index, uint32_t group_size, Args &args, uint32_t args_index = 0) {
+    VUML_ASSERT(group_size != 0 && "group size must not be zero");
+    program_.run({count_index, group_size, args_index, max_groups_}, in(counts), out(args));
+  }
+};
+
+/**
+ * @brief how an element is compared with the value of a Predicate, eAnyBits tests value & element != 0
+ */
+enum class Compare : uint32_t {
+  eNonZero,
+  eEqual,
+  eNotEqual,
+  eLess,
+  eLessEqual,
+  eGreater,
+  eGreaterEqual,
+  eAnyBits,
+};
+
+/**
+ * @brief a predicate evaluated by the compaction kernel, it is a spec constant so each one gets its own pipeline
+ */
+template<typename T>
+struct Predicate {
+  Compare op;
+  T value;
+};
+
+namespace pred {
+
+template<typename T>
+Predicate<T> nonzero() { return {Compare::eNonZero, T{}}; }
+
+template<typename T>
+Predicate<T> equal(T value) { return {Compare::eEqual, value}; }
+
+template<typename T>
+Predicate<T> not_equal(T value) { return {Compare::eNotEqual, value}; }
+
+template<typename T>
+Predicate<T> less(T value) { return {Compare::eLess, value}; }
+
+template<typename T>
+Predicate<T> less_equal(T value) { return {Compare::eLessEqual, value}; }
+
+template<typename T>
+Predicate<T> greater(T value) { return {Compare::eGreater, value}; }
+
+template<typename T>
+Predicate<T> greater_equal(T value) { return {Compare::eGreaterEqual, value}; }
+
+template<typename T>
+Predicate<T> any_bits(T value) { return {Compare::eAnyBits, value}; }
+
+} // namespace pred
+
+namespace details {
+
+template<typename T>
+constexpr uint32_t compact_type() {
+  if constexpr (::std::is_same_v<T, uint32_t>) {
+    return 0;
+  } else if constexpr (::std::is_same_v<T, int32_t>) {
+    return 1;
+  } else {
+    static_assert(::std::is_same_v<T, float>, "compaction supports uint32_t, int32_t and float elements");
+    return 2;
+  }
+}
+
+} // namespace details
+
+/**
+ * @brief select elements of a device array in a single pass over it, keeping their order. The number of selected
+ * elements stays on the device in count()[0], so it can size the next dispatch through DispatchArgs without a
+ * readback. Inputs have less than 2^30 elements.
+ */
+class Compaction {
+ private:
+  struct Params {
+    uint32_t size;
+    uint32_t out_size;
+    uint32_t value;
+  };
+
+  enum Mode : uint32_t {
+    eCopyIf,
+    ePartition,
+    eUnique,
+    eStencil,
+  };
+
+  static constexpr uint32_t items_per_invocation = 4;
+  static constexpr uint32_t max_size = 1u << 30;
+
+  Device &device_;
+  Program<type_list<uint32_t, uint32_t, uint32_t, uint32_t>, Params> program_;
+  uint32_t workgroup_size_;
+  uint32_t max_groups_;
+  Array<uint32_t> count_;
+  // the tile counter and the status of each tile, grown to the largest input
+  ::std::unique_ptr<Array<uint32_t>> state_;
+
+ public:
+  explicit Compaction(Device &device, uint32_t workgroup_size = 256)
+      : device_(device),
+        program_(device, kernels::compact()),
+        workgroup_size_(workgroup_size),
+        max_groups_(device.properties().limits.maxComputeWorkGroupCount[0]),
+        count_(device, 1) {
+  }
+
+  /**
+   * @brief output = the elements of input which satisfy the predicate, the ones past the end of output are dropped
+   */
+  template<class In, class Out>
+  void copy_if(In &input, Out &output, const Predicate<typename In::value_type> &predicate) {
+    run(eCopyIf, predicate, input, output, input);
+  }
+
+  /**
+   * @brief output = the elements of input whose flag is not zero, the flags can be written by any kernel
+   */
+  template<class In, class Flags, class Out>
+  void copy_if(In &input, Flags &flags, Out &output) {
+    static_assert(::std::is_same_v<typename Flags::value_type, uint32_t>, "flags are uint32_t");
+    if (flags.size() < input.size()) {
+      ERROR("%u flags for %u elements", static_cast<uint32_t>(flags.size()), static_cast<uint32_t>(input.size()));
+      throw ::std::invalid_argument("fewer flags than elements");
+    }
+    run(eStencil, Predicate<typename In::value_type>{}, input, output, flags);
+  }
+
+  /**
+   * @brief the elements which satisfy the predicate in order at the front of output, the others in reverse order at
+   * the back, count()[0] is where the second part starts. output is as large as input.
+   */
+  template<class In, class Out>
+  void partition(In &input, Out &output, const Predicate<typename In::value_type> &predicate) {
+    if (output.size() < input.size()) {
+      ERROR("partition of %u elements into %u",
+            static_cast<uint32_t>(input.size()),
+            static_cast<uint32_t>(output.size()));
+      throw ::std::invalid_argument("the partition output is smaller than the input");
+    }
+    run(ePartition, predicate, input, output, input);
+  }
+
+  /**
+   * @brief output = input without the elements equal (bitwise) to the one before them
+   */
+  template<class In, class Out>
+  void unique(In &input, Out &output) {
+    run(eUnique, Predicate<typename In::value_type>{}, input, output, input);
+  }
+
+  /**
+   * @brief number of elements selected by the last call, written on the device
+   */
+  Array<uint32_t> &count() { return count_; }
+
+  /**
+   * @brief read the count back, waits for the last call
+   */
+  uint32_t hostCount() {
+    uint32_t count = 0;
+    count_.rangeToHost(0, 1, &count);
+    return count;
+  }
+
+ private:
+  template<class In, class Out, class Flags>
+  void run(Mode mode, const Predicate<typename In::value_type> &predicate, In &input, Out &output, Flags &flags) {
+    using T = typename In::value_type;
+    static_assert(::std::is_same_v<typename Out::value_type, T>, "compaction does not convert elements");
+    auto size = static_cast<uint32_t>(input.size());
+    if (size >= max_size) {
+      ERROR("compaction of %u elements, at most %u", size, max_size - 1);
+      throw ::std::length_error("too many elements for a compaction");
+    }
+
+    auto tiles = div_up(size, workgroup_size_ * items_per_invocation);
+    if (tiles == 0) {
+      array::fill_buf(device_, count_, count_.hazards(), 0, sizeof(uint32_t));
+      return;
+    }
+    if (!state_ || state_->size() < 1 + tiles) {
+      state_ = ::std::make_unique<Array<uint32_t>>(device_, 1 + tiles);
+    }
+    array::fill_buf(device_, *state_, state_->hazards(), 0, (1 + tiles) * sizeof(uint32_t));
+
+    uint32_t value = 0;
+    ::std::memcpy(&value, &predicate.value, sizeof(value));
+    // the workgroups loop over the tiles the largest grid does not cover
+    program_
+        .grid(::std::min(tiles, max_groups_))
+        .spec(workgroup_size_, mode, static_cast<uint32_t>(predicate.op), details::compact_type<T>())
+        .run({size, static_cast<uint32_t>(output.size()), value},
+             in(input), out(output), in(flags), inout(*state_), out(count_));
+  }
+};
+
+/**
+ * @brief one-off versions of the Compaction calls, they build the kernel every time and wait for the count. Keep a
+ * Compaction to filter repeatedly or to feed the count to another dispatch.
+ */
+template<class In, class Out>
+uint32_t copy_if(In &input, Out &output, const Predicate<typename In::value_type> &predicate) {
+  auto compaction = Compaction(input.device());
+  compaction.copy_if(input, output, predicate);
+  return compaction.hostCount();
+}
+
+template<class In, class Out>
+uint32_t partition(In &input, Out &output, const Predicate<typename In::value_type> &predicate) {
+  auto compaction = Compaction(input.device());
+  compaction.partition(input, output, predicate);
+  return compaction.hostCount();
+}
+
+template<class In, class Out>
+uint32_t unique(In &input, Out &output) {
+  auto compaction = Compaction(input.device());
+  compaction.unique(input, output);
+  return compaction.hostCount();
+}
+
+/**
+ * @brief element formats the conversion kernel reads and writes
+ */
+enum class Format : uint32_t {
+  eFloat32,
+  eFloat16,
+  eBFloat16,
+  eInt8,
+};
+
+namespace details {
+
+template<typename T>
+constexpr Format format_of() {
+  if constexpr (::std::is_same_v<T, float>) {
+    return Format::eFloat32;
+  } else if constexpr (::std::is_same_v<T, half>) {
+    return Format::eFloat16;
+  } else if constexpr (::std::is_same_v<T, bfloat16>) {
+    return Format::eBFloat16;
+  } else {
+    static_assert(::std::is_same_v<T, int8_t>, "conversion supports float, half, bfloat16 and int8_t elements");
+    return Format::eInt8;
+  }
+}
+
+} // namespace details
+
+/**
+ * @brief convert elements on the device, between float, half, bfloat16 and int8_t. An int8_t element i stands for
+ * i * scale: floats are divided by the scale, rounded to nearest even and clamped to [-128, 127].
+ *
+ * upload() and download() do the conversion at the device end of a transfer: the host data crosses the bus as it
+ * is, and there is no conversion pass on the host. Downloading float results as half moves half the bytes.
+ */
+class Converter {
+ private:
+  struct Params {
+    uint32_t size;
+    float scale;
+  };
+
+  static constexpr uint32_t items_per_invocation = 4;
+
+  Device &device_;
+  Program<type_list<uint32_t, uint32_t, uint32_t>, Params> program_;
+  uint32_t workgroup_size_;
+  uint32_t max_groups_;
+
+ public:
+  explicit Converter(Device &device, uint32_t workgroup_size = 256)
+      : device_(device),
+        program_(device, kernels::convert()),
+        workgroup_size_(workgroup_size),
+        max_groups_(device.properties().limits.maxComputeWorkGroupCount[0]) {
+  }
+
+  /**
+   * @brief submit without waiting: dst[i] = src[i] converted, for the elements both arrays have
+   */
+  template<class Src, class Dst>
+  void operator()(Src &src, Dst &dst, float scale = 1.0f) {
+    if (scale == 0.0f) {
+      ERROR("int8 conversion with a zero scale");
+      throw ::std::invalid_argument("int8 conversion with a zero scale");
+    }
+    auto size = static_cast<uint32_t>(::std::min<::std::size_t>(src.size(), dst.size()));
+    if (size == 0) {
+      return;
+    }
+    constexpr auto src_format = details::format_of<typename Src::value_type>();
+    constexpr auto dst_format = details::format_of<typename Dst::value_type>();
+    // a grid-stride loop covers what the largest grid does not
+    auto groups = ::std::min(div_up(size, workgroup_size_ * items_per_invocation), max_groups_);
+    program_
+        .grid(groups)
+        .spec(workgroup_size_, static_cast<uint32_t>(src_format), static_cast<uint32_t>(dst_format))
+        .run({size, scale}, in(src), inout(dst));
+  }
+
+  /**
+   * @brief fill dst from host elements of another format, converted on the device
+   */
+  template<class Dst, typename It, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
+  void upload(Dst &dst, It begin, It end, float scale = 1.0f) {
+    using T = typename ::std::iterator_traits<It>::value_type;
+    if constexpr (::std::is_same_v<T, typename Dst::value_type>) {
+      dst.fromHost(begin, end);
+    } else {
+      auto raw = Array<T>(device_, begin, end);
+      // raw waits for the conversion when it goes
+      (*this)(raw, dst, scale);
+    }
+  }
+
+  /**
+   * @brief copy src to host elements of another format, converted on the device
+   */
+  template<class Src, typename It, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
+  void download(Src &src, It dst, float scale = 1.0f) {
+    using T = typename ::std::iterator_traits<It>::value_type;
+    static_assert(!::std::is_void_v<T>, "the host element type is taken from the iterator");
+    if constexpr (::std::is_same_v<T, typename Src::value_type>) {
+      src.toHost(dst);
+    } else {
+      auto raw = Array<T>(device_, src.size());
+      (*this)(src, raw, scale);
+      raw.toHost(dst);
+    }
+  }
+};
+
+} // namespace vuml
+
+#endif //VUML_INCLUDE_VUML_KERNELS_H_
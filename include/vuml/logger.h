@@ -7,14 +7,29 @@
 
 #include <cerrno>
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
-#include <sstream>
-
 #include "non_copyable.h"
 #include "vuml/vuml.h"
 
+// levels below this one compile to nothing, ERROR and FATAL are always kept
+#ifndef VUML_MIN_LOG_LEVEL
+#ifdef NDEBUG
+#define VUML_MIN_LOG_LEVEL 2 // INFO
+#else
+#define VUML_MIN_LOG_LEVEL 0 // TRACE
+#endif
+#endif // VUML_MIN_LOG_LEVEL
+
+#if defined(__GNUC__) || defined(__clang__)
+#define VUML_PRINTF_FORMAT(_fmt_, _args_) __attribute__((format(printf, _fmt_, _args_)))
+#else
+#define VUML_PRINTF_FORMAT(_fmt_, _args_)
+#endif
+
 #define LOG_LEVEL(VUML) \
   VUML(TRACE)           \
   VUML(DEBUG)           \
@@ -40,6 +55,32 @@ void set_log_file(FILE *_file);
 
 void timestamp(char *_buf, ::std::size_t size);
 
+/**
+ * @brief format a record and queue it for the logging thread, the caller never waits: when the queue is full the
+ * record is dropped and counted
+ * @param _tag level name printed before the timestamp
+ */
+void write(const char *_tag, const char *_format, ...) VUML_PRINTF_FORMAT(2, 3);
+
+/**
+ * @brief block until every record queued so far is written to the log file. ERROR, FATAL and the system errors flush,
+ * they are often followed by an exception which may end the process.
+ */
+void flush();
+
+struct Stats {
+  uint64_t written;    // records written to the log file
+  uint64_t dropped;    // records lost because the queue was full
+  uint64_t truncated;  // records cut to the record size
+};
+
+Stats stats();
+
+/**
+ * @brief sink of the compiled out levels, keeps the arguments type checked and used without evaluating them
+ */
+VUML_PRINTF_FORMAT(1, 2) inline void discard(const char *_format, ...) { (void) _format; }
+
 inline const char *level_str(Level _level) {
   const static char *level_str_table[] = {
 #define LOG_STR(_name) #_name,
@@ -55,69 +96,90 @@ inline const char *level_str(Level _level) {
 
 #undef LOG_LEVEL
 
-#define LOG_BASE(_log_file_, _level_, _file_, _line_, _abort_, _formatter_, ...) \
-  do {                                                                           \
-    char buf[32]{0};                                                             \
-    vuml::logger::timestamp(buf, sizeof(buf));                                   \
-    int err = fprintf((_log_file_), "[%s] [%s] "#_formatter_" - %s:%d\n", vuml::logger::level_str((_level_)), buf, ##__VA_ARGS__, strrchr((_file_), '/') + 1, (_line_)); \
-    if (err == -1) {                                                             \
-      fprintf(stderr, "log failed");                                             \
-    }                                                                            \
-    if ((_abort_)) {                                                             \
-      abort();                                                                   \
-    }                                                                            \
-  } while (0)                                                                    \
+#define LOG_BASE(_level_, _file_, _line_, _abort_, _formatter_, ...) \
+  do {                                                               \
+    vuml::logger::write(vuml::logger::level_str((_level_)), #_formatter_" - %s:%d", ##__VA_ARGS__, strrchr((_file_), '/') + 1, (_line_)); \
+    if ((_level_) >= vuml::logger::Level::ERROR) {                   \
+      vuml::logger::flush();                                         \
+    }                                                                \
+    if ((_abort_)) {                                                 \
+      abort();                                                       \
+    }                                                                \
+  } while (0)                                                        \
+  //
+
+#define LOG_SYS(_file_, _line_, _abort_, _formatter_, ...) \
+  do {                                                     \
+    vuml::logger::write((_abort_) ? "SYSFA" : "SYSER", #_formatter_": %s - %s:%d", ##__VA_ARGS__, strerror(errno), strrchr((_file_), '/') + 1, (_line_)); \
+    vuml::logger::flush();                                 \
+    if ((_abort_)) {                                       \
+      abort();                                             \
+    }                                                      \
+  } while (0)                                              \
   //
 
-#define LOG_SYS(_log_file_, _file_, _line_, _abort_, _formatter_, ...) \
-  do {                                                                 \
-    char buf[32]{0};                                                   \
-    vuml::logger::timestamp(buf, sizeof(buf));                         \
-    fprintf((_log_file_), "[%s] [%s] "#_formatter_": %s - %s:%d\n", (_abort_) ? "SYSFA" : "SYSER", buf, ##__VA_ARGS__, strerror(errno), strrchr((_file_), '/') + 1, (_line_)); \
-    if ((_abort_)) {                                                   \
-      abort();                                                         \
-    }                                                                  \
-  } while (0)                                                          \
+#define LOG_DISCARD(_formatter_, ...)                                   \
+  do {                                                                  \
+    if (false) {                                                        \
+      vuml::logger::discard(#_formatter_, ##__VA_ARGS__);               \
+    }                                                                   \
+  } while (0)                                                           \
   //
 
+#if VUML_MIN_LOG_LEVEL <= 0
 #define TRACE(_formatter_, ...) \
   do {                          \
     if (vuml::logger::log_level <= vuml::logger::Level::TRACE) { \
-      LOG_BASE(vuml::logger::log_file, vuml::logger::Level::TRACE, __FILE__, __LINE__, false, _formatter_, ##__VA_ARGS__); \
+      LOG_BASE(vuml::logger::Level::TRACE, __FILE__, __LINE__, false, _formatter_, ##__VA_ARGS__); \
     }                           \
   } while (0)                   \
   //
+#else
+#define TRACE(_formatter_, ...) LOG_DISCARD(_formatter_, ##__VA_ARGS__)
+#endif
 
+#if VUML_MIN_LOG_LEVEL <= 1
 #define DEBUG(_formatter_, ...) \
   do {                          \
     if (vuml::logger::log_level <= vuml::logger::Level::DEBUG) { \
-      LOG_BASE(vuml::logger::log_file, vuml::logger::Level::DEBUG, __FILE__, __LINE__, false, _formatter_, ##__VA_ARGS__); \
+      LOG_BASE(vuml::logger::Level::DEBUG, __FILE__, __LINE__, false, _formatter_, ##__VA_ARGS__); \
     }                           \
   } while (0)                   \
   //
+#else
+#define DEBUG(_formatter_, ...) LOG_DISCARD(_formatter_, ##__VA_ARGS__)
+#endif
 
+#if VUML_MIN_LOG_LEVEL <= 2
 #define INFO(_formatter_, ...) \
   do {                         \
     if (vuml::logger::log_level <= vuml::logger::Level::INFO) { \
-      LOG_BASE(vuml::logger::log_file, vuml::logger::Level::INFO, __FILE__, __LINE__, false, _formatter_, ##__VA_ARGS__); \
+      LOG_BASE(vuml::logger::Level::INFO, __FILE__, __LINE__, false, _formatter_, ##__VA_ARGS__); \
     }                          \
   } while (0)                  \
   //
+#else
+#define INFO(_formatter_, ...) LOG_DISCARD(_formatter_, ##__VA_ARGS__)
+#endif
 
+#if VUML_MIN_LOG_LEVEL <= 3
 #define WARN(_formatter_, ...) \
   do {                         \
     if (vuml::logger::log_level <= vuml::logger::Level::WARN) { \
-      LOG_BASE(vuml::logger::log_file, vuml::logger::Level::WARN, __FILE__, __LINE__, false, _formatter_, ##__VA_ARGS__); \
+      LOG_BASE(vuml::logger::Level::WARN, __FILE__, __LINE__, false, _formatter_, ##__VA_ARGS__); \
     }                          \
   } while (0)                  \
   //
+#else
+#define WARN(_formatter_, ...) LOG_DISCARD(_formatter_, ##__VA_ARGS__)
+#endif
 
-#define ERROR(_formatter_, ...) LOG_BASE(vuml::logger::log_file, vuml::logger::Level::ERROR, __FILE__, __LINE__, false, _formatter_, ##__VA_ARGS__)
+#define ERROR(_formatter_, ...) LOG_BASE(vuml::logger::Level::ERROR, __FILE__, __LINE__, false, _formatter_, ##__VA_ARGS__)
 
-#define FATAL(_formatter_, ...) LOG_BASE(vuml::logger::log_file, vuml::logger::Level::FATAL, __FILE__, __LINE__, true, _formatter_, ##__VA_ARGS__)
+#define FATAL(_formatter_, ...) LOG_BASE(vuml::logger::Level::FATAL, __FILE__, __LINE__, true, _formatter_, ##__VA_ARGS__)
 
-#define SYSERR(_formatter_, ...) LOG_SYS(vuml::logger::log_file, __FILE__, __LINE__, false, _formatter_, ##__VA_ARGS__)
+#define SYSERR(_formatter_, ...) LOG_SYS(__FILE__, __LINE__, false, _formatter_, ##__VA_ARGS__)
 
-#define SYSFATAL(_formatter_, ...) LOG_SYS(vuml::logger::log_file, __FILE__, __LINE__, true, _formatter_, ##__VA_ARGS__)
+#define SYSFATAL(_formatter_, ...) LOG_SYS(__FILE__, __LINE__, true, _formatter_, ##__VA_ARGS__)
 
 #endif //VUML_INCLUDE_VUML_LOGGER_H_
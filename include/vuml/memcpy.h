@@ -0,0 +1,43 @@
+//
+// Created by Homin Su on 2023/7/19.
+//
+
+#ifndef VUML_INCLUDE_VUML_MEMCPY_H_
+#define VUML_INCLUDE_VUML_MEMCPY_H_
+
+#include <cstddef>
+
+namespace vuml {
+
+/**
+ * @brief instruction sets the non-temporal copies can use, each one implies the previous
+ */
+enum class Simd {
+  eNone,
+  eSse41,
+  eAvx2,
+  eAvx512,
+};
+
+const char *to_string(Simd simd);
+
+/**
+ * @brief widest instruction set of the running CPU, detected once
+ */
+Simd simd_support();
+
+/**
+ * @brief copy into write-combined memory (host visible, not host cached): non-temporal stores of whole vectors, so
+ * the write-combining buffers are flushed as full lines and the destination never goes through the cache
+ */
+void stream_store(void *dst, const void *src, ::std::size_t size_bytes, Simd simd = simd_support());
+
+/**
+ * @brief copy out of uncached memory: streaming loads (movntdqa) fill a whole line per access where plain loads take
+ * one uncached round trip each
+ */
+void stream_load(void *dst, const void *src, ::std::size_t size_bytes, Simd simd = simd_support());
+
+} // namespace vuml
+
+#endif //VUML_INCLUDE_VUML_MEMCPY_H_
@@ -0,0 +1,195 @@
+//
+// Created by Homin Su on 2023/7/18.
+//
+
+#ifndef VUML_INCLUDE_VUML_PARALLEL_H_
+#define VUML_INCLUDE_VUML_PARALLEL_H_
+
+#include <cstddef>
+
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "memcpy.h"
+#include "thread_pool.h"
+#include "traits.h"
+
+namespace vuml::parallel {
+
+// below it the pool costs more than it saves
+constexpr ::std::size_t min_chunk_bytes = 1 << 20;
+constexpr ::std::size_t page_size = 4096;
+
+namespace details {
+
+template<typename It>
+constexpr bool is_random_access_v = ::std::is_base_of_v<
+    ::std::random_access_iterator_tag, typename ::std::iterator_traits<It>::iterator_category
+>;
+
+} // namespace details
+
+/**
+ * @brief opt in to calling a user function concurrently from the pool, e.g. DeviceArray(device, n, parallel::par, f).
+ * The function must then be safe to call from several threads, the overloads without it call it in order.
+ */
+struct Par {};
+inline constexpr Par par{};
+
+/**
+ * @brief call f(begin, end) on contiguous ranges covering [0, n), one per pool thread and one on the caller. Ranges
+ * are whole multiples of a page worth of elements: when the destination starts on a page, as mapped memory does, each
+ * page is written by one thread, sequentially, it is first touched on that thread's NUMA node and write-combining
+ * buffers are flushed whole. Otherwise only the pages at the range boundaries are shared by two threads.
+ */
+template<typename F>
+void for_ranges(::std::size_t n, ::std::size_t element_size, F &&f) {
+  auto &pool = ThreadPool::global();
+  auto parts = ::std::min(pool.size() + 1, n * element_size / min_chunk_bytes);
+  if (parts <= 1 || ThreadPool::onWorker()) {
+    f(::std::size_t{0}, n);
+    return;
+  }
+  auto per_page = ::std::max<::std::size_t>(1, page_size / element_size);
+  auto step = ((n + parts - 1) / parts + per_page - 1) / per_page * per_page;
+
+  auto tasks = ::std::vector<::std::future<void>>{};
+  for (auto begin = step; begin < n; begin += step) {
+    tasks.push_back(pool.submit([&f, begin, end = ::std::min(n, begin + step)] { f(begin, end); }));
+  }
+  ::std::exception_ptr error;
+  try {
+    f(::std::size_t{0}, ::std::min(n, step));
+  } catch (...) {
+    error = ::std::current_exception();
+  }
+  // the ranges reference f and the data, wait for all of them before rethrowing
+  for (auto &task : tasks) {
+    try {
+      task.get();
+    } catch (...) {
+      if (!error) { error = ::std::current_exception(); }
+    }
+  }
+  if (error) { ::std::rethrow_exception(error); }
+}
+
+template<typename It, typename T>
+void fill_n(It dst, ::std::size_t n, const T &value) {
+  if constexpr (details::is_random_access_v<It>) {
+    for_ranges(n, sizeof(T), [&](::std::size_t begin, ::std::size_t end) {
+      ::std::fill(dst + begin, dst + end, value);
+    });
+  } else {
+    ::std::fill_n(dst, n, value);
+  }
+}
+
+template<typename Src, typename Dst>
+void copy_n(Src src, ::std::size_t n, Dst dst) {
+  if constexpr (details::is_random_access_v<Src> && details::is_random_access_v<Dst>) {
+    using T = typename ::std::iterator_traits<Src>::value_type;
+    for_ranges(n, sizeof(T), [&](::std::size_t begin, ::std::size_t end) {
+      ::std::copy(src + begin, src + end, dst + begin);
+    });
+  } else {
+    ::std::copy_n(src, n, dst);
+  }
+}
+
+template<typename Src, typename Dst>
+void copy(Src begin, Src end, Dst dst) {
+  if constexpr (details::is_random_access_v<Src>) {
+    copy_n(begin, static_cast<::std::size_t>(end - begin), dst);
+  } else {
+    ::std::copy(begin, end, dst);
+  }
+}
+
+/**
+ * @brief dst[i] = f(src[i]), f is called concurrently
+ */
+template<typename Src, typename Dst, typename F>
+void transform_n(Src src, ::std::size_t n, Dst dst, F &&f) {
+  if constexpr (details::is_random_access_v<Src> && details::is_random_access_v<Dst>) {
+    using T = typename ::std::iterator_traits<Src>::value_type;
+    for_ranges(n, sizeof(T), [&](::std::size_t begin, ::std::size_t end) {
+      ::std::transform(src + begin, src + end, dst + begin, f);
+    });
+  } else {
+    for (::std::size_t i = 0; i < n; ++i, ++src, ++dst) {
+      *dst = f(*src);
+    }
+  }
+}
+
+/**
+ * @brief dst[i] = f(i), f is called concurrently
+ */
+template<typename Dst, typename F>
+void generate_n(Dst dst, ::std::size_t n, F &&f) {
+  using T = typename ::std::iterator_traits<Dst>::value_type;
+  for_ranges(n, sizeof(T), [&](::std::size_t begin, ::std::size_t end) {
+    for (auto i = begin; i < end; ++i) {
+      dst[i] = f(i);
+    }
+  });
+}
+
+/**
+ * @brief stream_store() split over the pool, each range fences its own non-temporal stores
+ */
+inline void stream_store(void *dst, const void *src, ::std::size_t size_bytes) {
+  for_ranges(size_bytes, 1, [&](::std::size_t begin, ::std::size_t end) {
+    ::vuml::stream_store(static_cast<char *>(dst) + begin, static_cast<const char *>(src) + begin, end - begin);
+  });
+}
+
+/**
+ * @brief stream_load() split over the pool
+ */
+inline void stream_load(void *dst, const void *src, ::std::size_t size_bytes) {
+  for_ranges(size_bytes, 1, [&](::std::size_t begin, ::std::size_t end) {
+    ::vuml::stream_load(static_cast<char *>(dst) + begin, static_cast<const char *>(src) + begin, end - begin);
+  });
+}
+
+/**
+ * @brief copy_n into mapped memory, with non-temporal stores when it is write-combined and src is contiguous
+ */
+template<typename Src, typename T>
+void copy_to_mapped(Src src, ::std::size_t n, T *dst, bool write_combined) {
+  using V = typename ::std::iterator_traits<Src>::value_type;
+  if constexpr (traits::is_contiguous_iterator_v<Src> && ::std::is_same_v<::std::remove_cv_t<V>, T>) {
+    if (write_combined && n != 0) {
+      stream_store(dst, ::std::addressof(*src), n * sizeof(T));
+      return;
+    }
+  }
+  copy_n(src, n, dst);
+}
+
+/**
+ * @brief copy_n out of mapped memory, with streaming loads when it is uncached and dst is contiguous
+ */
+template<typename T, typename Dst>
+void copy_from_mapped(const T *src, ::std::size_t n, Dst dst, bool uncached) {
+  using V = typename ::std::iterator_traits<Dst>::value_type;
+  if constexpr (traits::is_contiguous_iterator_v<Dst> && ::std::is_same_v<V, T>) {
+    if (uncached && n != 0) {
+      stream_load(::std::addressof(*dst), src, n * sizeof(T));
+      return;
+    }
+  }
+  copy_n(src, n, dst);
+}
+
+} // namespace vuml::parallel
+
+#endif //VUML_INCLUDE_VUML_PARALLEL_H_
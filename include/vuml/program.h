@@ -7,14 +7,28 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 
+#include <algorithm>
 #include <array>
+#include <exception>
+#include <future>
+#include <initializer_list>
+#include <map>
 #include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
 #include <tuple>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "arg.h"
+#include "logger.h"
+#include "reflect.h"
+#include "shaders.h"
+#include "thread_pool.h"
 #include "traits.h"
 #include "utils.h"
 #include "vuml.h"
@@ -26,33 +40,40 @@ namespace vuml {
 template<typename ...Ts>
 struct type_list {};
 
+class WarmUp;
+
 namespace details {
 
 template<typename ...Ts>
 ::std::array<vk::DescriptorType, sizeof...(Ts)> descriptor_types() {
-  return {Ts::descriptor_type...};
+  return {::std::remove_reference_t<Ts>::descriptor_type...};
 }
 
-template<::std::size_t ...N>
-::std::array<vk::DescriptorSetLayoutBinding, sizeof...(N)> binding_descriptor_types_impl(
-    const ::std::array<vk::DescriptorType, sizeof...(N)> &desc_types,
-    ::std::index_sequence<N...>
-) {
-  return {
-      {{
-           static_cast<uint32_t>(N),
-           desc_types[N],
-           1,
-           vk::ShaderStageFlagBits::eCompute
-       }...}
-  };
+inline ::std::vector<vk::DescriptorSetLayoutBinding> binding_descriptor_types(const reflect::ShaderInfo &info) {
+  auto r = ::std::vector<vk::DescriptorSetLayoutBinding>{};
+  for (const auto &b : info.bindings()) {
+    if (b.set != 0) { continue; }
+    r.emplace_back(b.binding, b.type, b.count, vk::ShaderStageFlagBits::eCompute);
+  }
+  return r;
 }
 
-template<::std::size_t N>
-::std::array<vk::DescriptorSetLayoutBinding, N> binding_descriptor_types(
-    const ::std::array<vk::DescriptorType, N> &desc_types
+/**
+ * @brief one pool size per descriptor type of the layout, dynamic types included
+ */
+inline ::std::vector<vk::DescriptorPoolSize> descriptor_pool_sizes(
+    const ::std::vector<vk::DescriptorSetLayoutBinding> &bindings
 ) {
-  return binding_descriptor_types_impl(desc_types, ::std::make_index_sequence<N>());
+  auto r = ::std::vector<vk::DescriptorPoolSize>{};
+  for (const auto &b : bindings) {
+    auto it = ::std::find_if(r.begin(), r.end(), [&](const auto &s) { return s.type == b.descriptorType; });
+    if (it == r.end()) {
+      r.emplace_back(b.descriptorType, b.descriptorCount);
+    } else {
+      it->descriptorCount += b.descriptorCount;
+    }
+  }
+  return r;
 }
 
 template<::std::size_t Index, typename Tuple>
@@ -81,10 +102,24 @@ template<typename Tuple>
   return specs_to_map_entries_impl(specs, ::std::make_index_sequence<traits::tuple_args_len_v<Tuple>>());
 }
 
+/**
+ * @brief what a descriptor points to, the buffer or the image according to its type
+ */
+struct DescriptorInfo {
+  vk::DescriptorBufferInfo buffer;
+  vk::DescriptorImageInfo image;
+
+  bool operator==(const DescriptorInfo &other) const {
+    return buffer == other.buffer && image == other.image;
+  }
+};
+
+// the write reads the info of its type and ignores the other one
 template<::std::size_t ...N>
 ::std::array<vk::WriteDescriptorSet, sizeof...(N)> write_descriptor_set_impl(
     vk::DescriptorSet desc_set,
-    const ::std::array<vk::DescriptorBufferInfo, sizeof...(N)> &desc_buf_infos,
+    const ::std::array<vk::DescriptorType, sizeof...(N)> &desc_types,
+    const ::std::array<DescriptorInfo, sizeof...(N)> &desc_infos,
     ::std::index_sequence<N...>
 ) {
   return {
@@ -93,9 +128,9 @@ template<::std::size_t ...N>
            static_cast<uint32_t>(N),
            0,
            1,
-           vk::DescriptorType::eStorageBuffer,
-           nullptr,
-           &desc_buf_infos[N]
+           desc_types[N],
+           &desc_infos[N].image,
+           &desc_infos[N].buffer
        }...}
   };
 }
@@ -103,11 +138,136 @@ template<::std::size_t ...N>
 template<::std::size_t N>
 ::std::array<vk::WriteDescriptorSet, N> write_descriptor_set(
     vk::DescriptorSet desc_set,
-    const ::std::array<vk::DescriptorBufferInfo, N> &desc_buf_infos
+    const ::std::array<vk::DescriptorType, N> &desc_types,
+    const ::std::array<DescriptorInfo, N> &desc_infos
 ) {
-  return write_descriptor_set_impl(desc_set, desc_buf_infos, ::std::make_index_sequence<N>());
+  return write_descriptor_set_impl(desc_set, desc_types, desc_infos, ::std::make_index_sequence<N>());
+}
+
+template<typename T>
+Access arg_access(const T &arg, const reflect::Binding *binding) {
+  if constexpr (is_arg_v<T>) {
+    return arg.access();
+  } else {
+    // plain arrays get the access declared by the shader
+    if (binding == nullptr || binding->readable == binding->writable) {
+      return Access::eReadWrite;
+    }
+    return binding->readable ? Access::eRead : Access::eWrite;
+  }
+}
+
+/**
+ * @brief descriptor info of an array: the range ends on a whole 32-bit word, the shader reads the last bytes of an
+ * array of 8 or 16-bit elements as a uint. Buffers are padded for it, see AllocDevice::makeBuffer().
+ */
+template<typename T>
+vk::DescriptorBufferInfo buffer_info(T &arg) {
+  auto &array = unwrap(arg);
+  auto offset = static_cast<vk::DeviceSize>(array.offset() * sizeof(typename T::value_type));
+  auto size = static_cast<vk::DeviceSize>(array.size_bytes());
+  if constexpr (is_dynamic(T::descriptor_type)) {
+    // the window, its offset is given when the set is bound
+    size = arg.count() * sizeof(typename T::value_type);
+  }
+  auto end = (offset + size + 3) & ~vk::DeviceSize{3};
+  return {array.buffer(), offset, end - offset};
+}
+
+template<typename T>
+DescriptorInfo descriptor_info(T &arg) {
+  if constexpr (is_image(T::descriptor_type)) {
+    return {{}, unwrap(arg).descriptorInfo(T::descriptor_type)};
+  } else {
+    return {buffer_info(arg), {}};
+  }
 }
 
+/**
+ * @brief what a descriptor was last written with, the set is only written again when it changes
+ */
+struct WrittenDescriptor {
+  vk::DescriptorType type;
+  DescriptorInfo info;
+  uint64_t generation;
+
+  bool operator==(const WrittenDescriptor &other) const {
+    return type == other.type && info == other.info && generation == other.generation;
+  }
+};
+
+/**
+ * @brief what a program remembers of a bound array to synchronize it around the dispatch
+ */
+struct BoundArg {
+  // the generation of the array itself, it moves on when the array is evicted after the bind, null for images.
+  // Handles of destroyed buffers are reused, a new buffer may have the bound handle.
+  const uint64_t *array_generation;
+  uint64_t generation;
+  vk::Buffer buffer;
+  vk::DeviceMemory memory;
+  vk::DeviceSize offset;
+  vk::DeviceSize size;
+  Access access;
+  bool needs_flush;
+  Hazards *hazards;
+  // read through the uniform cache, it has its own access flag
+  bool uniform = false;
+  // set for images, they get image barriers
+  vk::Image image = nullptr;
+};
+
+/**
+ * @brief what it takes to create the pipeline of a program, independent of the program so it can be compiled on
+ * another thread or batched with other programs
+ */
+struct PipelineDesc {
+  Device *device;
+  vk::PipelineLayout layout;
+  vk::ShaderModule shader;
+  vk::PipelineCache cache;
+  ::std::vector<vk::SpecializationMapEntry> spec_entries;
+  ::std::vector<uint8_t> spec_data;
+  vk::SpecializationInfo spec_info;
+  // the spec values packed without padding, then the subgroup settings, which variant of the program the pipeline is
+  ::std::vector<uint8_t> variant;
+  // 0 lets the driver pick, see ProgramBase::setSubgroupSize()
+  uint32_t subgroup_size = 0;
+  bool full_subgroups = false;
+  vk::PipelineShaderStageRequiredSubgroupSizeCreateInfoEXT subgroup_info;
+
+  /**
+   * @brief points into the desc, which must stay in place until the pipeline is created
+   */
+  vk::PipelineShaderStageCreateInfo stage_info() {
+    spec_info = vk::SpecializationInfo(
+        static_cast<uint32_t>(spec_entries.size()),
+        spec_entries.data(),
+        spec_data.size(),
+        spec_data.data()
+    );
+    auto info = vk::PipelineShaderStageCreateInfo(
+        vk::PipelineShaderStageCreateFlags(),
+        vk::ShaderStageFlagBits::eCompute,
+        shader,
+        "main",
+        spec_entries.empty() ? nullptr : &spec_info
+    );
+    if (full_subgroups) {
+      info.flags |= vk::PipelineShaderStageCreateFlagBits::eRequireFullSubgroupsEXT;
+    }
+    if (subgroup_size != 0) {
+      subgroup_info = vk::PipelineShaderStageRequiredSubgroupSizeCreateInfoEXT(subgroup_size);
+      info.pNext = &subgroup_info;
+    }
+    return info;
+  }
+
+  vk::Pipeline create() {
+    return device->createPipeline(layout, cache, stage_info());
+  }
+};
+
 struct ComputeBuffer {
  public:
   vk::CommandBuffer cmd_buffer_;
@@ -125,28 +285,197 @@ struct ComputeBuffer {
 };
 
 class ProgramBase : NonCopyable {
+  friend class ::vuml::WarmUp;
+
  protected:
   vk::ShaderModule shader_;
   vk::DescriptorSetLayout desc_layout_;
   vk::DescriptorPool desc_pool_;
   vk::DescriptorSet desc_set_;
+  // the set 0 bindings of the shader, with dynamic types where the arguments asked for them
+  ::std::vector<vk::DescriptorSetLayoutBinding> bindings_;
+  ::std::vector<details::WrittenDescriptor> written_;
+  uint32_t push_constant_size_ = 0;
   vk::PipelineCache pipe_cache_;
   vk::PipelineLayout pipe_layout_;
+  // the variant used by the next bind(), owned by variants_
   mutable vk::Pipeline pipeline_;
+  // one pipeline per spec values the program was bound with, keyed by the packed values
+  ::std::map<::std::vector<uint8_t>, vk::Pipeline> variants_;
+  // compiled on a pool thread by WarmUp, taken by the next bind()
+  ::std::shared_future<vk::Pipeline> pending_pipeline_;
+  ::std::vector<uint8_t> pending_variant_;
+  vk::CommandBuffer cmd_buffer_;
   Device &device_;
+  reflect::ShaderInfo info_;
+  ::std::vector<details::BoundArg> bound_;
+  SyncPoint last_run_;
   ::std::array<uint32_t, 3> batch_ = {0, 0, 0};
+  // where the workgroup counts are read from instead of batch_, see grid_indirect()
+  ::std::optional<details::BoundArg> indirect_;
+  uint32_t subgroup_size_ = 0;
+  bool full_subgroups_ = false;
 
  public:
+  /**
+   * @brief bindings, push constant block, specialization constants and workgroup size declared by the shader
+   */
+  [[nodiscard]] const reflect::ShaderInfo &info() const { return info_; }
+
+  /**
+   * @brief number of spec values the program holds a pipeline for
+   */
+  [[nodiscard]] ::std::size_t variants() const { return variants_.size(); }
+
+  /**
+   * @brief require the subgroup size of the pipelines compiled from now on, 0 lets the driver pick it, e.g. the width
+   * a reduction is specialized for. With full_subgroups every subgroup of a workgroup is complete, the workgroup
+   * width must then be a multiple of the size. Takes VK_EXT_subgroup_size_control, see Device::subgroup().
+   */
+  void setSubgroupSize(uint32_t size, bool full_subgroups = false) {
+    const auto &subgroup = device_.subgroup();
+    if (size != 0) {
+      if (!subgroup.size_control) {
+        ERROR("the device cannot require a subgroup size for compute pipelines");
+        throw ::std::runtime_error("subgroup size control is not supported");
+      }
+      if ((size & (size - 1)) != 0 || size < subgroup.min_size || size > subgroup.max_size) {
+        ERROR("subgroup size %u, the device supports powers of two in [%u, %u]",
+              size,
+              subgroup.min_size,
+              subgroup.max_size);
+        throw ::std::invalid_argument("unsupported subgroup size");
+      }
+    }
+    if (full_subgroups) {
+      if (!subgroup.full_subgroups) {
+        ERROR("the device cannot require full subgroups for compute pipelines");
+        throw ::std::runtime_error("full subgroups are not supported");
+      }
+      check_full_subgroups(info_, size);
+    }
+    subgroup_size_ = size;
+    full_subgroups_ = full_subgroups;
+  }
+
+  /**
+   * @brief the required subgroup size, or the one the driver picks by default
+   */
+  [[nodiscard]] uint32_t subgroupSize() const {
+    return subgroup_size_ != 0 ? subgroup_size_ : device_.subgroup().size;
+  }
+
+  /**
+   * @brief bytes of workgroup (shared) memory a workgroup may use on the device, see sharedMemorySize()
+   */
+  [[nodiscard]] uint32_t sharedMemoryLimit() const {
+    return device_.properties().limits.maxComputeSharedMemorySize;
+  }
+
+  /**
+   * @brief submit the bound dispatch without waiting for it, it starts once the last writes of its inputs and the
+   * last accesses of its outputs are done. Host accesses to the arrays wait for it. Running the same bind() again
+   * waits for the previous run first.
+   */
   void run() {
-    auto submit_info = vk::SubmitInfo(0, nullptr, nullptr, 1, &device_.computeCmdBuffer());
-    auto queue = device_.computeQueue();
-    queue.submit({submit_info}, nullptr);
-    queue.waitIdle();
+    if (!pipeline_) {
+      ERROR("run() before bind(), or after the program was reloaded");
+      throw ::std::logic_error("the program has no recorded dispatch, bind() it first");
+    }
+    auto waits = ::std::vector<SyncPoint>{};
+    for (const auto &arg : bound_) {
+      prepare(arg, waits);
+    }
+    // the dispatch arguments are read like an input
+    if (indirect_) {
+      prepare(*indirect_, waits);
+    }
+    // the command buffer is not recorded for simultaneous use, a second run() of the same bind() waits for the first
+    device_.wait(last_run_);
+    last_run_ = device_.submit(QueueKind::eCompute, cmd_buffer_, waits);
+    // inputs-only arrays are not modified by the kernel, the host will not invalidate them
+    for (const auto &arg : bound_) {
+      if (writes(arg.access)) {
+        arg.hazards->write(last_run_);
+      } else {
+        arg.hazards->read(last_run_, QueueKind::eCompute);
+      }
+    }
+    if (indirect_) {
+      indirect_->hazards->read(last_run_, QueueKind::eCompute);
+    }
+  }
+
+  /**
+   * @brief block until the last submitted dispatch is done
+   */
+  void wait() {
+    device_.wait(last_run_);
+  }
+
+  /**
+   * @brief replace the shader between dispatches, e.g. an edited kernel from glsl::ShaderWatch. The pipelines and the
+   * recorded dispatch go with the old shader, the next bind() compiles the new one. It must take the same parameters,
+   * its bindings may change, the subgroup settings stay. Throws and keeps the current shader if the new one does not
+   * fit the program.
+   */
+  void reload(const uint32_t *spirv, ::std::size_t size, vk::ShaderModuleCreateFlags flags = {}) {
+    auto info = reflect::ShaderInfo(spirv, size);
+    info.validatePushConstants(push_constant_size_);
+    check_capabilities(info);
+    // the new shader may declare another workgroup width
+    if (full_subgroups_) {
+      check_full_subgroups(info, subgroup_size_);
+    }
+    auto shader = device_.createShaderModule({flags, size, spirv});
+
+    device_.wait(last_run_);
+    if (pending_pipeline_.valid()) {
+      try {
+        take_pending_pipeline();
+      } catch (::std::exception &e) {
+        WARN("background pipeline compilation failed: %s", e.what());
+      }
+    }
+    for (const auto &variant : variants_) {
+      device_.destroyPipeline(variant.second);
+    }
+    variants_.clear();
+    pipeline_ = nullptr;
+    device_.destroyShaderModule(shader_);
+    shader_ = shader;
+    info_ = ::std::move(info);
+    // the bindings of the new shader, matched again to the arguments by the next bind()
+    device_.destroyDescriptorPool(desc_pool_);
+    desc_pool_ = nullptr;
+    desc_set_ = nullptr;
+    written_.clear();
+    device_.destroyDescriptorSetLayout(desc_layout_);
+    device_.destroyPipelineLayout(pipe_layout_);
+    bindings_ = details::binding_descriptor_types(info_);
+    create_layout();
+    bound_.clear();
+  }
+
+  void reload(const ::std::vector<uint32_t> &spirv, vk::ShaderModuleCreateFlags flags = {}) {
+    reload(spirv.data(), sizeof(uint32_t) * spirv.size(), flags);
+  }
+
+  void reload(const SpirvFile &spirv, vk::ShaderModuleCreateFlags flags = {}) {
+    reload(spirv.data(), spirv.size(), flags);
   }
 
  protected:
   ProgramBase(Device &device, const char *file, vk::ShaderModuleCreateFlags flags = {})
-      : ProgramBase(device, read_spirv(file), flags) {
+      : ProgramBase(device, SpirvFile(file), flags) {
+  }
+
+  ProgramBase(Device &device, const SpirvFile &spirv, vk::ShaderModuleCreateFlags flags = {})
+      : ProgramBase(device, spirv.data(), spirv.size(), flags) {
+  }
+
+  ProgramBase(Device &device, const shaders::Shader &shader, vk::ShaderModuleCreateFlags flags = {})
+      : ProgramBase(device, shader.code, shader.size, flags) {
   }
 
   ProgramBase(Device &device, const ::std::vector<uint32_t> &spirv, vk::ShaderModuleCreateFlags flags = {})
@@ -154,8 +483,11 @@ class ProgramBase : NonCopyable {
   }
 
   ProgramBase(Device &device, const uint32_t *spirv, ::std::size_t size, vk::ShaderModuleCreateFlags flags = {})
-      : device_(device) {
+      : device_(device), info_(spirv, size) {
+    check_capabilities(info_);
     shader_ = device.createShaderModule({flags, size, spirv});
+    // own a command buffer so several programs can be in flight
+    cmd_buffer_ = device.releaseComputeCmdBuffer();
   }
 
   ~ProgramBase() noexcept { release(); }
@@ -165,12 +497,25 @@ class ProgramBase : NonCopyable {
         desc_layout_(other.desc_layout_),
         desc_pool_(other.desc_pool_),
         desc_set_(other.desc_set_),
+        bindings_(::std::move(other.bindings_)),
+        written_(::std::move(other.written_)),
+        push_constant_size_(other.push_constant_size_),
         pipe_cache_(other.pipe_cache_),
         pipe_layout_(other.pipe_layout_),
         pipeline_(other.pipeline_),
+        variants_(::std::move(other.variants_)),
+        pending_pipeline_(::std::move(other.pending_pipeline_)),
+        pending_variant_(::std::move(other.pending_variant_)),
+        cmd_buffer_(other.cmd_buffer_),
         device_(other.device_),
-        batch_(other.batch_) {
-    other.shader_ = nullptr;
+        info_(::std::move(other.info_)),
+        bound_(::std::move(other.bound_)),
+        last_run_(other.last_run_),
+        batch_(other.batch_),
+        indirect_(other.indirect_),
+        subgroup_size_(other.subgroup_size_),
+        full_subgroups_(other.full_subgroups_) {
+    other.detach();
   }
 
   ProgramBase &operator=(ProgramBase &&other) noexcept {
@@ -179,53 +524,235 @@ class ProgramBase : NonCopyable {
     desc_layout_ = other.desc_layout_;
     desc_pool_ = other.desc_pool_;
     desc_set_ = other.desc_set_;
+    bindings_ = ::std::move(other.bindings_);
+    written_ = ::std::move(other.written_);
+    push_constant_size_ = other.push_constant_size_;
     pipe_cache_ = other.pipe_cache_;
     pipe_layout_ = other.pipe_layout_;
     pipeline_ = other.pipeline_;
+    variants_ = ::std::move(other.variants_);
+    pending_pipeline_ = ::std::move(other.pending_pipeline_);
+    pending_variant_ = ::std::move(other.pending_variant_);
+    cmd_buffer_ = other.cmd_buffer_;
     device_ = other.device_;
+    info_ = ::std::move(other.info_);
+    bound_ = ::std::move(other.bound_);
+    last_run_ = other.last_run_;
     batch_ = other.batch_;
+    indirect_ = other.indirect_;
+    subgroup_size_ = other.subgroup_size_;
+    full_subgroups_ = other.full_subgroups_;
 
-    other.shader_ = nullptr;
+    other.detach();
     return *this;
   }
 
   void release() {
+    device_.wait(last_run_);
+    if (pending_pipeline_.valid()) {
+      try {
+        take_pending_pipeline();
+      } catch (::std::exception &e) {
+        WARN("background pipeline compilation failed: %s", e.what());
+      }
+    }
+    if (cmd_buffer_) {
+      device_.freeCommandBuffers(device_.computeCmdPool(), cmd_buffer_);
+    }
     device_.destroyShaderModule(shader_);
     device_.destroyDescriptorPool(desc_pool_);
     device_.destroyDescriptorSetLayout(desc_layout_);
     device_.destroyPipelineCache(pipe_cache_);
-    device_.destroyPipeline(pipeline_);
+    for (const auto &variant : variants_) {
+      device_.destroyPipeline(variant.second);
+    }
     device_.destroyPipelineLayout(pipe_layout_);
   }
 
-  template<::std::size_t N, typename ...Args>
-  void init_pipe_layout(const ::std::array<vk::PushConstantRange, N> &range, Args &...) {
-    auto desc_types = details::descriptor_types<Args...>();
-    auto bindings = details::binding_descriptor_types(desc_types);
+  // the handles now belong to another program
+  void detach() noexcept {
+    shader_ = nullptr;
+    desc_layout_ = nullptr;
+    desc_pool_ = nullptr;
+    desc_set_ = nullptr;
+    written_.clear();
+    pipe_cache_ = nullptr;
+    pipe_layout_ = nullptr;
+    pipeline_ = nullptr;
+    variants_.clear();
+    pending_pipeline_ = {};
+    pending_variant_.clear();
+    cmd_buffer_ = nullptr;
+    last_run_ = {};
+    indirect_.reset();
+  }
+
+  /**
+   * @brief wait for the pipeline compiled in the background, if any
+   * @return whether there was one
+   */
+  bool take_pending_pipeline() {
+    if (!pending_pipeline_.valid()) {
+      return false;
+    }
+    auto pending = ::std::move(pending_pipeline_);
+    pending_pipeline_ = {};
+    add_variant(::std::move(pending_variant_), pending.get());
+    pending_variant_.clear();
+    return true;
+  }
+
+  [[nodiscard]] bool has_pipeline(const ::std::vector<uint8_t> &variant) const {
+    return variants_.count(variant) != 0 || (pending_pipeline_.valid() && pending_variant_ == variant);
+  }
+
+  void add_variant(::std::vector<uint8_t> variant, vk::Pipeline pipeline) {
+    auto r = variants_.emplace(::std::move(variant), pipeline);
+    if (!r.second) {
+      // compiled twice, keep the first one, it may be recorded already
+      device_.destroyPipeline(pipeline);
+    }
+    pipeline_ = r.first->second;
+  }
+
+  /**
+   * @brief refuse a shader which declares capabilities the device has not enabled, its pipeline would be undefined
+   */
+  void check_capabilities(const reflect::ShaderInfo &info) const {
+    auto missing = device_.missingCapabilities(info.capabilities());
+    if (missing.empty()) {
+      return;
+    }
+    auto names = ::std::string{};
+    for (const auto &name : missing) {
+      names += names.empty() ? name : ", " + name;
+    }
+    ERROR("the shader needs capabilities the device has not enabled: %s, see DeviceFeatures", names.c_str());
+    throw ::std::runtime_error("the shader needs capabilities the device has not enabled: " + names);
+  }
+
+  void check_full_subgroups(const reflect::ShaderInfo &info, uint32_t size) const {
+    const auto &width = info.localSize()[0];
+    auto multiple = size != 0 ? size : device_.subgroup().max_size;
+    if (!width.specialized() && width.value % multiple != 0) {
+      ERROR("full subgroups of %u invocations, the workgroup width is %u", multiple, width.value);
+      throw ::std::invalid_argument("full subgroups need a workgroup width multiple of the subgroup size");
+    }
+  }
+
+  void set_subgroup(details::PipelineDesc &desc) const {
+    desc.subgroup_size = subgroup_size_;
+    desc.full_subgroups = full_subgroups_;
+  }
+
+  // a pipeline with other subgroup settings is another variant, the defaults add nothing to the key
+  [[nodiscard]] ::std::vector<uint8_t> subgroup_key() const {
+    if (subgroup_size_ == 0 && !full_subgroups_) {
+      return {};
+    }
+    auto r = ::std::vector<uint8_t>(sizeof(subgroup_size_) + 1);
+    ::std::memcpy(r.data(), &subgroup_size_, sizeof(subgroup_size_));
+    r.back() = full_subgroups_ ? 1 : 0;
+    return r;
+  }
+
+  // drivers may compile a pipeline declaring more workgroup memory than the device has, its dispatch loses the device
+  void check_shared_memory(uint64_t size) const {
+    if (size > sharedMemoryLimit()) {
+      ERROR("the shader declares %llu bytes of workgroup memory, the device has %u",
+            static_cast<unsigned long long>(size),
+            sharedMemoryLimit());
+      throw ::std::invalid_argument("the shader declares more workgroup memory than the device has");
+    }
+  }
+
+  /**
+   * @brief make the pipeline of the spec values the current one, compile it if the program has none
+   */
+  void use_variant(details::PipelineDesc desc) {
+    take_pending_pipeline();
+    auto it = variants_.find(desc.variant);
+    if (it != variants_.end()) {
+      pipeline_ = it->second;
+      return;
+    }
+    auto pipeline = desc.create();
+    add_variant(::std::move(desc.variant), pipeline);
+  }
+
+  /**
+   * @brief the layout depends on the shader and the size of the push constants, it is built once, and again only if
+   * the arguments switch a binding to a dynamic offset
+   */
+  void init_pipe_layout(uint32_t push_constant_size) {
+    info_.validatePushConstants(push_constant_size);
+    push_constant_size_ = push_constant_size;
+    bindings_ = details::binding_descriptor_types(info_);
+    pipe_cache_ = device_.createPipelineCache({});
+    create_layout();
+  }
+
+  void create_layout() {
     desc_layout_ = device_.createDescriptorSetLayout(
         {
             vk::DescriptorSetLayoutCreateFlags(),
-            static_cast<uint32_t>(bindings.size()),
-            bindings.data()
+            static_cast<uint32_t>(bindings_.size()),
+            bindings_.data()
         }
     );
-    pipe_cache_ = device_.createPipelineCache({});
+    auto range = vk::PushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, push_constant_size_);
     pipe_layout_ = device_.createPipelineLayout(
         {
             vk::PipelineLayoutCreateFlags(),
             1,
             &desc_layout_,
-            static_cast<uint32_t>(N),
-            range.data()
+            push_constant_size_ == 0 ? 0u : 1u,
+            push_constant_size_ == 0 ? nullptr : &range
         }
     );
+    alloc_descriptor_sets();
   }
 
+  /**
+   * @brief switch the bindings to the dynamic or static types of the arguments. The pipelines are built against the
+   * layout, they go with it, so alternating between the two is slow.
+   */
   template<typename ...Args>
-  void alloc_descriptor_sets(Args &...) {
+  void match_layout() {
+    auto types = details::descriptor_types<Args...>();
+    auto changed = false;
+    for (auto &b : bindings_) {
+      if (b.binding < types.size() && b.descriptorType != types[b.binding]
+          && details::static_type(b.descriptorType) == details::static_type(types[b.binding])) {
+        b.descriptorType = types[b.binding];
+        changed = true;
+      }
+    }
+    if (!changed) {
+      return;
+    }
+    device_.wait(last_run_);
+    take_pending_pipeline();
+    for (const auto &variant : variants_) {
+      device_.destroyPipeline(variant.second);
+    }
+    variants_.clear();
+    pipeline_ = nullptr;
+    device_.destroyDescriptorPool(desc_pool_);
+    desc_pool_ = nullptr;
+    desc_set_ = nullptr;
+    written_.clear();
+    device_.destroyDescriptorSetLayout(desc_layout_);
+    device_.destroyPipelineLayout(pipe_layout_);
+    create_layout();
+  }
+
+  void alloc_descriptor_sets() {
     VUML_ASSERT(desc_layout_);
-    auto size = vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, sizeof...(Args));
-    auto sizes = ::std::array<vk::DescriptorPoolSize, 1>({size});
+    auto sizes = details::descriptor_pool_sizes(bindings_);
+    if (sizes.empty()) {
+      return;
+    }
     desc_pool_ = device_.createDescriptorPool(
         {
             vk::DescriptorPoolCreateFlags(),
@@ -237,33 +764,285 @@ class ProgramBase : NonCopyable {
     desc_set_ = device_.allocateDescriptorSets({desc_pool_, 1, &desc_layout_})[0];
   }
 
+  template<typename ...Args>
+  void validate_arguments() const {
+    // the shader declares the static type of a dynamic binding
+    auto desc_types = ::std::array<vk::DescriptorType, sizeof...(Args)>{
+        details::static_type(::std::remove_reference_t<Args>::descriptor_type)...
+    };
+    info_.validateArguments(desc_types.data(), desc_types.size());
+  }
+
   template<typename ...Args>
   void command_buffer_begin(Args &...args) {
     VUML_ASSERT(pipeline_);
+    // the descriptor set and the command buffer may still be in use by the previous run
+    device_.wait(last_run_);
     constexpr auto n_args = sizeof...(Args);
-    auto desc_infos = ::std::array<vk::DescriptorBufferInfo, n_args>{
-        {{
-             args.buffer(),
-             args.offset() * sizeof(typename Args::value_type),
-             args.size_bytes()
-         }...}
-    };
-    auto desc_set = write_descriptor_set(desc_set_, desc_infos);
-    device_.updateDescriptorSets(desc_set, {});
+    bound_.clear();
+    uint32_t binding = 0;
+    (bound_.push_back(bound_arg(args, binding++)), ...);
+    auto desc_types = details::descriptor_types<Args...>();
+    auto desc_infos = ::std::array<details::DescriptorInfo, n_args>{details::descriptor_info(args)...};
+    // binding the same arrays again, or moving dynamic windows, leaves the set as it is
+    auto written = ::std::vector<details::WrittenDescriptor>{};
+    written.reserve(n_args);
+    for (::std::size_t i = 0; i < n_args; ++i) {
+      written.push_back({desc_types[i], desc_infos[i], 0});
+    }
+    {
+      ::std::size_t i = 0;
+      ((written[i++].generation = details::unwrap(args).generation()), ...);
+    }
+    if (n_args != 0 && written != written_) {
+      auto desc_set = write_descriptor_set(desc_set_, desc_types, desc_infos);
+      device_.updateDescriptorSets(desc_set, {});
+      written_ = ::std::move(written);
+    }
+
+    // in binding order, as the dynamic bindings are numbered
+    auto dynamic_offsets = ::std::vector<uint32_t>{};
+    (push_dynamic_offset(args, dynamic_offsets), ...);
 
-    auto cmd_buf = device_.computeCmdBuffer();
+    auto cmd_buf = cmd_buffer_;
     auto begin_info = vk::CommandBufferBeginInfo();
     cmd_buf.begin(begin_info);
 
     cmd_buf.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline_);
-    cmd_buf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipe_layout_, 0, {desc_set_}, {});
+    if (desc_set_) {
+      cmd_buf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipe_layout_, 0, {desc_set_}, dynamic_offsets);
+    }
   }
 
   void command_buffer_end() {
-    auto cmd_buf = device_.computeCmdBuffer();
-    cmd_buf.dispatch(batch_[0], batch_[1], batch_[2]);
+    auto cmd_buf = cmd_buffer_;
+    record_barriers(cmd_buf, true);
+    if (indirect_) {
+      // the counts are written by an earlier dispatch or copy and read when the dispatch is issued
+      auto barrier = vk::BufferMemoryBarrier(vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite,
+                                             vk::AccessFlagBits::eIndirectCommandRead,
+                                             VK_QUEUE_FAMILY_IGNORED,
+                                             VK_QUEUE_FAMILY_IGNORED,
+                                             indirect_->buffer,
+                                             indirect_->offset,
+                                             indirect_->size);
+      cmd_buf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+                              vk::PipelineStageFlagBits::eDrawIndirect,
+                              {},
+                              {},
+                              barrier,
+                              {});
+      cmd_buf.dispatchIndirect(indirect_->buffer, indirect_->offset);
+    } else {
+      cmd_buf.dispatch(batch_[0], batch_[1], batch_[2]);
+    }
+    record_barriers(cmd_buf, false);
     cmd_buf.end();
   }
+
+  /**
+   * @brief read the x, y, z workgroup counts from three uint32_t of args at the next bind() instead of batch_
+   */
+  template<typename T>
+  void set_indirect(T &args, ::std::size_t offset) {
+    static_assert(::std::is_same_v<typename T::value_type, uint32_t>, "dispatch arguments are uint32_t");
+    if (!(args.usage() & vk::BufferUsageFlagBits::eIndirectBuffer)) {
+      ERROR("the dispatch arguments array needs the indirect buffer usage");
+      throw ::std::invalid_argument("the dispatch arguments array needs the indirect buffer usage");
+    }
+    if (offset + 3 > args.size()) {
+      ERROR("dispatch arguments at %zu overflow an array of %u elements", offset, static_cast<uint32_t>(args.size()));
+      throw ::std::out_of_range("dispatch arguments overflow the array");
+    }
+    args.touch();
+    indirect_ = details::BoundArg{
+        &args.generation(),
+        args.generation(),
+        args.buffer(),
+        args.memory(),
+        (args.offset() + offset) * sizeof(uint32_t),
+        3 * sizeof(uint32_t),
+        Access::eRead,
+        args.needsFlush(),
+        &args.hazards()
+    };
+  }
+
+  void prepare(const details::BoundArg &arg, ::std::vector<SyncPoint> &waits) const {
+    if (arg.array_generation != nullptr && *arg.array_generation != arg.generation) {
+      ERROR("an array was evicted to host memory since the program was bound, bind it again");
+      throw ::std::runtime_error("an array was evicted to host memory since the program was bound, bind it again");
+    }
+    if (writes(arg.access)) {
+      arg.hazards->writeDependencies(waits);
+    } else {
+      arg.hazards->readDependencies(waits);
+    }
+    // outputs-only arrays are never read by the kernel, no need to flush them
+    if (arg.needs_flush && reads(arg.access)) {
+      device_.flushMappedMemoryRanges(vk::MappedMemoryRange(arg.memory, 0, VK_WHOLE_SIZE));
+    }
+  }
+
+  template<typename T>
+  details::BoundArg bound_arg(T &arg, uint32_t binding) const {
+    constexpr auto type = T::descriptor_type;
+    if constexpr (details::is_image(type)) {
+      return bound_image(arg, binding);
+    } else {
+      return bound_buffer(arg, binding);
+    }
+  }
+
+  template<typename T>
+  details::BoundArg bound_image(T &arg, uint32_t binding) const {
+    auto &image = details::unwrap(arg);
+    constexpr auto storage = T::descriptor_type == vk::DescriptorType::eStorageImage;
+    if (storage ? !image.isStorage() : !image.isSampled()) {
+      ERROR("argument %u: format %s cannot be %s by a shader",
+            binding,
+            vk::to_string(image.format()).c_str(),
+            storage ? "stored to" : "sampled");
+      throw ::std::invalid_argument("image format does not support the descriptor type of the argument");
+    }
+    return {
+        nullptr,
+        0,
+        nullptr,
+        image.memory(),
+        0,
+        VK_WHOLE_SIZE,
+        details::arg_access(arg, info_.findBinding(binding)),
+        false,
+        &image.hazards(),
+        false,
+        image.image()
+    };
+  }
+
+  template<typename T>
+  details::BoundArg bound_buffer(T &arg, uint32_t binding) const {
+    auto &array = details::unwrap(arg);
+    constexpr auto type = T::descriptor_type;
+    // page an evicted array back before its buffer goes into the descriptor set
+    array.touch();
+    auto offset = array.offset() * sizeof(typename T::value_type);
+    auto size = static_cast<::std::size_t>(array.size_bytes());
+    if constexpr (details::is_dynamic(type)) {
+      check_window(arg, binding);
+      offset += arg.offset() * sizeof(typename T::value_type);
+      size = arg.count() * sizeof(typename T::value_type);
+    }
+    if constexpr (details::is_uniform(type)) {
+      if (!(array.usage() & vk::BufferUsageFlagBits::eUniformBuffer)) {
+        ERROR("argument %u is bound as a uniform buffer, the array needs the uniform buffer usage", binding);
+        throw ::std::invalid_argument("a uniform buffer argument needs the uniform buffer usage");
+      }
+      auto max_range = device_.properties().limits.maxUniformBufferRange;
+      if (size > max_range) {
+        ERROR("argument %u binds %zu bytes as a uniform buffer, at most %u", binding, size, max_range);
+        throw ::std::length_error("uniform buffer argument larger than maxUniformBufferRange");
+      }
+    }
+    return {
+        &array.generation(),
+        array.generation(),
+        array.buffer(),
+        array.memory(),
+        offset,
+        size,
+        details::arg_access(arg, info_.findBinding(binding)),
+        array.needsFlush(),
+        &array.hazards(),
+        details::is_uniform(type)
+    };
+  }
+
+  /**
+   * @brief a dynamic window lies in the array, and its offset in bytes is aligned as the device requires
+   */
+  template<typename T>
+  void check_window(const T &arg, uint32_t binding) const {
+    const auto &array = arg.array();
+    if (arg.count() == 0 || arg.offset() + arg.count() > array.size()) {
+      ERROR("argument %u: window [%zu, %zu) of an array of %zu elements",
+            binding,
+            arg.offset(),
+            arg.offset() + arg.count(),
+            static_cast<::std::size_t>(array.size()));
+      throw ::std::out_of_range("dynamic window outside of the array");
+    }
+    const auto &limits = device_.properties().limits;
+    auto alignment = details::is_uniform(T::descriptor_type)
+                     ? limits.minUniformBufferOffsetAlignment
+                     : limits.minStorageBufferOffsetAlignment;
+    auto bytes = arg.offset() * sizeof(typename T::value_type);
+    if (bytes % alignment != 0) {
+      ERROR("argument %u: dynamic offset of %zu bytes, it must be a multiple of %llu",
+            binding,
+            bytes,
+            static_cast<unsigned long long>(alignment));
+      throw ::std::invalid_argument("misaligned dynamic offset");
+    }
+  }
+
+  template<typename T>
+  static void push_dynamic_offset(const T &arg, ::std::vector<uint32_t> &offsets) {
+    if constexpr (details::is_dynamic(T::descriptor_type)) {
+      offsets.push_back(static_cast<uint32_t>(arg.offset() * sizeof(typename T::value_type)));
+    }
+  }
+
+  /**
+   * @brief before the dispatch wait for prior writes with the access the kernel needs, after the dispatch only
+   * publish the arrays the kernel writes
+   */
+  void record_barriers(vk::CommandBuffer cmd_buf, bool before_dispatch) const {
+    auto barriers = ::std::vector<vk::BufferMemoryBarrier>{};
+    auto image_barriers = ::std::vector<vk::ImageMemoryBarrier>{};
+    for (const auto &arg : bound_) {
+      auto src = vk::AccessFlags{};
+      auto dst = vk::AccessFlags{};
+      if (before_dispatch) {
+        src = vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderWrite;
+        if (reads(arg.access)) {
+          dst |= arg.uniform ? vk::AccessFlagBits::eUniformRead : vk::AccessFlagBits::eShaderRead;
+        }
+        if (writes(arg.access)) { dst |= vk::AccessFlagBits::eShaderWrite; }
+      } else if (writes(arg.access)) {
+        src = vk::AccessFlagBits::eShaderWrite;
+        dst = vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eHostRead;
+      } else {
+        continue;
+      }
+      if (arg.image) {
+        // images stay in the general layout, the barrier only orders the accesses
+        image_barriers.emplace_back(src,
+                                    dst,
+                                    vk::ImageLayout::eGeneral,
+                                    vk::ImageLayout::eGeneral,
+                                    VK_QUEUE_FAMILY_IGNORED,
+                                    VK_QUEUE_FAMILY_IGNORED,
+                                    arg.image,
+                                    vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+        continue;
+      }
+      barriers.emplace_back(src, dst, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, arg.buffer, arg.offset, arg.size);
+    }
+    if (barriers.empty() && image_barriers.empty()) {
+      return;
+    }
+    auto shader_stage = vk::PipelineStageFlags(vk::PipelineStageFlagBits::eComputeShader);
+    auto other_stages = before_dispatch
+                        ? vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader
+                        : vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eHost;
+    cmd_buf.pipelineBarrier(before_dispatch ? other_stages : shader_stage,
+                            before_dispatch ? shader_stage : other_stages,
+                            {},
+                            {},
+                            barriers,
+                            image_barriers);
+  }
 };
 
 template<typename Specs>
@@ -271,12 +1050,48 @@ class SpecBase;
 
 template<template<typename ...> typename Specs, typename ...Spec_Ts>
 class SpecBase<Specs<Spec_Ts...>> : public ProgramBase {
+  friend class ::vuml::WarmUp;
+
  protected:
   ::std::tuple<Spec_Ts...> specs_;
 
+ public:
+  template<::std::size_t I>
+  using spec_type = ::std::tuple_element_t<I, ::std::tuple<Spec_Ts...>>;
+
+  /**
+   * @brief bytes of workgroup (shared) memory the shader declares with the spec values of the next bind(), arrays
+   * sized by spec constants included
+   */
+  [[nodiscard]] uint64_t sharedMemorySize() const { return shared_memory_size(specs_); }
+
+  /**
+   * @brief the largest of candidates for spec value I whose workgroup memory fits the device, the other spec values
+   * as given to spec(), e.g. the tile edge of a tiled kernel. Throws when none fits.
+   */
+  template<::std::size_t I>
+  spec_type<I> largestFitting(::std::initializer_list<spec_type<I>> candidates) const {
+    auto specs = specs_;
+    auto best = ::std::optional<spec_type<I>>{};
+    for (const auto &candidate : candidates) {
+      ::std::get<I>(specs) = candidate;
+      if ((!best || *best < candidate) && shared_memory_size(specs) <= sharedMemoryLimit()) {
+        best = candidate;
+      }
+    }
+    if (!best) {
+      ERROR("none of %zu values of spec constant %zu fits in %u bytes of workgroup memory",
+            candidates.size(),
+            I,
+            sharedMemoryLimit());
+      throw ::std::invalid_argument("no spec value fits the workgroup memory of the device");
+    }
+    return *best;
+  }
+
  protected:
   SpecBase(Device &device, const char *file, vk::ShaderModuleCreateFlags flags = {})
-      : ProgramBase(device, read_spirv(file), flags) {
+      : ProgramBase(device, SpirvFile(file), flags) {
   }
 
   SpecBase(Device &device, const ::std::vector<uint32_t> &spirv, vk::ShaderModuleCreateFlags flags = {})
@@ -287,30 +1102,70 @@ class SpecBase<Specs<Spec_Ts...>> : public ProgramBase {
       : ProgramBase(device, spirv, size, flags) {
   }
 
-  void init_pipeline() {
+  details::PipelineDesc pipeline_desc() const {
+    auto sizes = ::std::array<::std::size_t, sizeof...(Spec_Ts)>{sizeof(Spec_Ts)...};
+    info_.validateSpecConstants(sizes.data(), sizes.size());
     auto entries = specs_to_map_entries(specs_);
+    auto desc = details::PipelineDesc{
+        &device_, pipe_layout_, shader_, pipe_cache_, {entries.begin(), entries.end()},
+        ::std::vector<uint8_t>(sizeof(specs_)), {}, variant()
+    };
+    set_subgroup(desc);
+    ::std::memcpy(desc.spec_data.data(), &specs_, sizeof(specs_));
+    check_shared_memory(shared_memory_size(specs_));
+    return desc;
+  }
+
+  void init_pipeline() {
+    take_pending_pipeline();
+    auto it = variants_.find(variant());
+    if (it != variants_.end()) {
+      pipeline_ = it->second;
+      return;
+    }
+    use_variant(pipeline_desc());
+  }
+
+ private:
+  // the padding of the tuple is not part of the key, equal values always find the same pipeline
+  [[nodiscard]] ::std::vector<uint8_t> variant() const {
+    auto r = ::std::vector<uint8_t>{};
+    r.reserve((sizeof(Spec_Ts) + ... + 0));
+    ::std::apply([&](const auto &...spec) {
+      (r.insert(r.end(),
+                reinterpret_cast<const uint8_t *>(&spec),
+                reinterpret_cast<const uint8_t *>(&spec) + sizeof(spec)), ...);
+    }, specs_);
+    auto subgroup = subgroup_key();
+    r.insert(r.end(), subgroup.begin(), subgroup.end());
+    return r;
+  }
+
+  [[nodiscard]] uint64_t shared_memory_size(const ::std::tuple<Spec_Ts...> &specs) const {
+    auto entries = specs_to_map_entries(specs);
     auto spec_info = vk::SpecializationInfo(
         static_cast<uint32_t>(entries.size()),
         entries.data(),
-        sizeof(specs_),
-        &specs_
-    );
-    auto create_info = vk::PipelineShaderStageCreateInfo(
-        vk::PipelineShaderStageCreateFlags(),
-        vk::ShaderStageFlagBits::eCompute,
-        shader_,
-        "main",
-        &spec_info
+        sizeof(specs),
+        &specs
     );
-    pipeline_ = device_.createPipeline(pipe_layout_, pipe_cache_, create_info);
+    return info_.sharedMemorySize(&spec_info);
   }
 };
 
 template<>
 class SpecBase<type_list<>> : public ProgramBase {
+  friend class ::vuml::WarmUp;
+
+ public:
+  /**
+   * @brief bytes of workgroup (shared) memory the shader declares
+   */
+  [[nodiscard]] uint64_t sharedMemorySize() const { return info_.sharedMemorySize(); }
+
  protected:
   SpecBase(Device &device, const char *file, vk::ShaderModuleCreateFlags flags = {})
-      : ProgramBase(device, read_spirv(file), flags) {
+      : ProgramBase(device, SpirvFile(file), flags) {
   }
 
   SpecBase(Device &device, const ::std::vector<uint32_t> &spirv, vk::ShaderModuleCreateFlags flags = {})
@@ -321,15 +1176,15 @@ class SpecBase<type_list<>> : public ProgramBase {
       : ProgramBase(device, spirv, size, flags) {
   }
 
+  details::PipelineDesc pipeline_desc() const {
+    auto desc = details::PipelineDesc{&device_, pipe_layout_, shader_, pipe_cache_, {}, {}, {}, subgroup_key()};
+    set_subgroup(desc);
+    check_shared_memory(info_.sharedMemorySize());
+    return desc;
+  }
+
   void init_pipeline() {
-    auto create_info = vk::PipelineShaderStageCreateInfo(
-        vk::PipelineShaderStageCreateFlags(),
-        vk::ShaderStageFlagBits::eCompute,
-        shader_,
-        "main",
-        nullptr
-    );
-    pipeline_ = device_.createPipeline(pipe_layout_, pipe_cache_, create_info);
+    use_variant(pipeline_desc());
   }
 };
 
@@ -345,24 +1200,56 @@ class Program<Specs<Specs_Ts...>, Params> : public details::SpecBase<Specs<Specs
 
  public:
   Program(Device &device, const char *file, vk::ShaderModuleCreateFlags flags = {})
-      : Base(device, read_spirv(file), flags) {
+      : Program(device, SpirvFile(file), flags) {
+  }
+
+  /**
+   * @brief a program of a mapped SPIR-V file, the file can be closed once the program is built
+   */
+  Program(Device &device, const SpirvFile &spirv, vk::ShaderModuleCreateFlags flags = {})
+      : Base(device, spirv.data(), spirv.size(), flags) {
+    Base::init_pipe_layout(static_cast<uint32_t>(sizeof(Params)));
+  }
+
+  /**
+   * @brief a program of a shader embedded by vuml_add_shaders(), see shaders::get()
+   */
+  Program(Device &device, const shaders::Shader &shader, vk::ShaderModuleCreateFlags flags = {})
+      : Base(device, shader.code, shader.size, flags) {
+    Base::init_pipe_layout(static_cast<uint32_t>(sizeof(Params)));
   }
 
   Program(Device &device, const ::std::vector<uint32_t> &spirv, vk::ShaderModuleCreateFlags flags = {})
       : Base(device, spirv.data(), sizeof(uint32_t) * spirv.size(), flags) {
+    Base::init_pipe_layout(static_cast<uint32_t>(sizeof(Params)));
   }
 
   Program(Device &device, const uint32_t *spirv, ::std::size_t size, vk::ShaderModuleCreateFlags flags = {})
       : Base(device, spirv, size, flags) {
+    Base::init_pipe_layout(static_cast<uint32_t>(sizeof(Params)));
   }
 
   using Base::run;
 
   Program &grid(uint32_t x, uint32_t y = 1, uint32_t z = 1) {
     Base::batch_ = {x, y, z};
+    Base::indirect_.reset();
+    return *this;
+  }
+
+  /**
+   * @brief take the workgroup counts from the device: three uint32_t at offset (in elements) of args, written by an
+   * earlier dispatch such as DispatchArgs, no readback to the host. args needs the indirect buffer usage.
+   */
+  template<class Array>
+  Program &grid_indirect(Array &args, ::std::size_t offset = 0) {
+    Base::set_indirect(args, offset);
     return *this;
   }
 
+  /**
+   * @brief spec values of the next bind(), each distinct set gets its own pipeline which is compiled once and kept
+   */
   Program &spec(Specs_Ts ...specs_ts) {
     Base::specs_ = ::std::make_tuple(specs_ts...);
     return *this;
@@ -370,12 +1257,8 @@ class Program<Specs<Specs_Ts...>, Params> : public details::SpecBase<Specs<Specs
 
   template<typename ...Args>
   const Program &bind(const Params &params, Args &&...args) {
-    if (!Base::pipeline_) { // not bind
-      init_pipe_layout(args...);
-      Base::alloc_descriptor_sets(args...);
-      Base::init_pipeline();
-    }
-    create_command_buffer(params, args...);
+    auto flat = ::std::tuple_cat(details::flatten(args)...);
+    ::std::apply([&](auto &...flat_args) { bind_flat(params, flat_args...); }, flat);
     return *this;
   }
 
@@ -393,17 +1276,18 @@ class Program<Specs<Specs_Ts...>, Params> : public details::SpecBase<Specs<Specs
 
  private:
   template<typename ...Args>
-  void init_pipe_layout(Args &...args) {
-    auto range = ::std::array<vk::PushConstantRange, 1>{
-        {vk::PushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(Params))}
-    };
-    Base::init_pipe_layout(range, args...);
+  void bind_flat(const Params &params, Args &...args) {
+    Base::template validate_arguments<Args...>();
+    Base::template match_layout<Args...>();
+    // the pipeline of the current spec values, compiled the first time they are bound
+    Base::init_pipeline();
+    create_command_buffer(params, args...);
   }
 
   template<typename ...Args>
   void create_command_buffer(const Params &params, Args &...args) {
     Base::command_buffer_begin(args...);
-    Base::device_.computeCmdBuffer().pushConstants(
+    Base::cmd_buffer_.pushConstants(
         Base::pipe_layout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(params), &params
     );
     Base::command_buffer_end();
@@ -417,24 +1301,56 @@ class Program<Specs<Specs_Ts...>, type_list<>> : public details::SpecBase<Specs<
 
  public:
   Program(Device &device, const char *file, vk::ShaderModuleCreateFlags flags = {})
-      : Base(device, read_spirv(file), flags) {
+      : Program(device, SpirvFile(file), flags) {
+  }
+
+  /**
+   * @brief a program of a mapped SPIR-V file, the file can be closed once the program is built
+   */
+  Program(Device &device, const SpirvFile &spirv, vk::ShaderModuleCreateFlags flags = {})
+      : Base(device, spirv.data(), spirv.size(), flags) {
+    Base::init_pipe_layout(0);
+  }
+
+  /**
+   * @brief a program of a shader embedded by vuml_add_shaders(), see shaders::get()
+   */
+  Program(Device &device, const shaders::Shader &shader, vk::ShaderModuleCreateFlags flags = {})
+      : Base(device, shader.code, shader.size, flags) {
+    Base::init_pipe_layout(0);
   }
 
   Program(Device &device, const ::std::vector<uint32_t> &spirv, vk::ShaderModuleCreateFlags flags = {})
       : Base(device, spirv.data(), sizeof(uint32_t) * spirv.size(), flags) {
+    Base::init_pipe_layout(0);
   }
 
   Program(Device &device, const uint32_t *spirv, ::std::size_t size, vk::ShaderModuleCreateFlags flags = {})
       : Base(device, spirv, size, flags) {
+    Base::init_pipe_layout(0);
   }
 
   using Base::run;
 
   Program &grid(uint32_t x, uint32_t y = 1, uint32_t z = 1) {
     Base::batch_ = {x, y, z};
+    Base::indirect_.reset();
+    return *this;
+  }
+
+  /**
+   * @brief take the workgroup counts from the device: three uint32_t at offset (in elements) of args, written by an
+   * earlier dispatch such as DispatchArgs, no readback to the host. args needs the indirect buffer usage.
+   */
+  template<class Array>
+  Program &grid_indirect(Array &args, ::std::size_t offset = 0) {
+    Base::set_indirect(args, offset);
     return *this;
   }
 
+  /**
+   * @brief spec values of the next bind(), each distinct set gets its own pipeline which is compiled once and kept
+   */
   Program &spec(Specs_Ts ...specs_ts) {
     Base::specs_ = ::std::make_tuple(specs_ts...);
     return *this;
@@ -442,13 +1358,8 @@ class Program<Specs<Specs_Ts...>, type_list<>> : public details::SpecBase<Specs<
 
   template<typename ...Args>
   const Program &bind(Args &&...args) {
-    if (!Base::pipeline_) { // not bind
-      Base::init_pipe_layout(::std::array<vk::PushConstantRange, 0>{{}, args...});
-      Base::alloc_descriptor_sets(args...);
-      Base::init_pipeline();
-    }
-    Base::command_buffer_begin(args...);
-    Base::command_buffer_end();
+    auto flat = ::std::tuple_cat(details::flatten(args)...);
+    ::std::apply([&](auto &...flat_args) { bind_flat(flat_args...); }, flat);
     return *this;
   }
 
@@ -463,6 +1374,103 @@ class Program<Specs<Specs_Ts...>, type_list<>> : public details::SpecBase<Specs<
     bind(::std::forward<Args>(args)...);
     Base::run();
   }
+
+ private:
+  template<typename ...Args>
+  void bind_flat(Args &...args) {
+    Base::template validate_arguments<Args...>();
+    Base::template match_layout<Args...>();
+    // the pipeline of the current spec values, compiled the first time they are bound
+    Base::init_pipeline();
+    Base::command_buffer_begin(args...);
+    Base::command_buffer_end();
+  }
+};
+
+/**
+ * @brief compiles the pipelines of programs ahead of their first bind(), with the spec values they hold at that time.
+ * Programs which already have a pipeline for those values are skipped.
+ */
+class WarmUp {
+ public:
+  /**
+   * @brief create the pipelines with one createComputePipelines call per device, then return
+   */
+  template<typename ...Progs>
+  static void batched(Progs &...programs) {
+    auto descs = ::std::vector<details::PipelineDesc>{};
+    auto targets = ::std::vector<details::ProgramBase *>{};
+    // the create infos point into the descs, they must not move
+    descs.reserve(sizeof...(Progs));
+    (collect(programs, descs, targets), ...);
+
+    auto done = ::std::vector<bool>(descs.size(), false);
+    for (::std::size_t i = 0; i < descs.size(); ++i) {
+      if (done[i]) { continue; }
+      auto infos = ::std::vector<vk::ComputePipelineCreateInfo>{};
+      auto group = ::std::vector<::std::size_t>{};
+      for (auto j = i; j < descs.size(); ++j) {
+        if (done[j] || descs[j].device != descs[i].device) { continue; }
+        infos.emplace_back(vk::PipelineCreateFlags(), descs[j].stage_info(), descs[j].layout);
+        group.push_back(j);
+        done[j] = true;
+      }
+      auto pipelines = descs[i].device->createPipelines(descs[i].cache, infos);
+      for (::std::size_t k = 0; k < group.size(); ++k) {
+        targets[group[k]]->add_variant(descs[group[k]].variant, pipelines[k]);
+      }
+    }
+  }
+
+  /**
+   * @brief compile every pipeline on its own pool thread, then return once all are done
+   */
+  template<typename ...Progs>
+  static void parallel(ThreadPool &pool, Progs &...programs) {
+    background(pool, programs...);
+    (static_cast<void>(static_cast<details::ProgramBase &>(programs).take_pending_pipeline()), ...);
+  }
+
+  template<typename ...Progs>
+  static void parallel(Progs &...programs) {
+    parallel(ThreadPool::global(), programs...);
+  }
+
+  /**
+   * @brief compile every pipeline on a pool thread and return at once, bind() only waits if its pipeline is not
+   * ready yet and rethrows a failed compilation
+   */
+  template<typename ...Progs>
+  static void background(ThreadPool &pool, Progs &...programs) {
+    (launch(pool, programs), ...);
+  }
+
+  template<typename ...Progs>
+  static void background(Progs &...programs) {
+    background(ThreadPool::global(), programs...);
+  }
+
+ private:
+  template<typename Prog>
+  static void collect(Prog &program,
+                      ::std::vector<details::PipelineDesc> &descs,
+                      ::std::vector<details::ProgramBase *> &targets) {
+    auto desc = program.pipeline_desc();
+    if (program.has_pipeline(desc.variant)) { return; }
+    descs.push_back(::std::move(desc));
+    targets.push_back(&program);
+  }
+
+  template<typename Prog>
+  static void launch(ThreadPool &pool, Prog &program) {
+    auto desc = program.pipeline_desc();
+    // one pending pipeline at a time
+    if (program.has_pipeline(desc.variant) || program.pending_pipeline_.valid()) { return; }
+    program.pending_variant_ = desc.variant;
+    program.pending_pipeline_ = pool.submit([desc = ::std::move(desc)]() mutable {
+      return desc.create();
+    }).share();
+  }
 };
 
 } // namespace vuml
@@ -0,0 +1,138 @@
+//
+// Created by Homin Su on 2023/7/2.
+//
+
+#ifndef VUML_INCLUDE_VUML_REFLECT_H_
+#define VUML_INCLUDE_VUML_REFLECT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+namespace vuml::reflect {
+
+enum class Scalar : uint32_t {
+  eBool,
+  eInt,
+  eUint,
+  eFloat,
+  eOther,
+};
+
+/**
+ * @brief a descriptor declared by the shader
+ */
+struct Binding {
+  uint32_t set = 0;
+  uint32_t binding = 0;
+  uint32_t count = 1;
+  vk::DescriptorType type = vk::DescriptorType::eStorageBuffer;
+  bool readable = true;  // not decorated with NonReadable (writeonly)
+  bool writable = true;  // not decorated with NonWritable (readonly)
+};
+
+/**
+ * @brief a specialization constant declared by the shader, size is the one expected in VkSpecializationInfo
+ */
+struct SpecConstant {
+  uint32_t id = 0;
+  uint32_t size = 0;
+  Scalar kind = Scalar::eOther;
+  uint64_t default_value = 0;
+};
+
+/**
+ * @brief one dimension of the workgroup size, either a literal or a specialization constant
+ */
+struct LocalSize {
+  uint32_t value = 1;
+  uint32_t spec_id = -1U;
+
+  [[nodiscard]] bool specialized() const { return spec_id != -1U; }
+};
+
+/**
+ * @brief an integer constant of the module: a literal, a specialization constant, or an OpSpecConstantOp of other
+ * constants
+ */
+struct ConstantExpr {
+  uint32_t op = 0;         // opcode of the OpSpecConstantOp, 0 for literals and specialization constants
+  uint32_t spec_id = -1U;  // set for specialization constants, value is then the default
+  uint32_t width = 32;
+  bool is_signed = false;
+  uint64_t value = 0;
+  ::std::vector<uint32_t> operands;  // result ids, the constituents of a composite
+  ::std::vector<uint32_t> indexes;   // literal indexes of an OpCompositeExtract
+};
+
+/**
+ * @brief a variable in workgroup (shared) memory, element_size bytes times the lengths of the arrays around it.
+ * Arrays inside structs count with the default length of their constants.
+ */
+struct SharedVariable {
+  uint32_t element_size = 0;
+  ::std::vector<uint32_t> lengths;  // result ids of the constants, outermost first
+  // false when a length is computed by an operation vuml does not evaluate, warned about once when parsed
+  bool counted = true;
+};
+
+/**
+ * @brief what vuml needs to know about a compute shader, parsed from its SPIR-V
+ */
+class ShaderInfo {
+ private:
+  ::std::vector<Binding> bindings_;
+  ::std::vector<SpecConstant> spec_constants_;
+  ::std::vector<uint32_t> capabilities_;
+  ::std::array<LocalSize, 3> local_size_ = {};
+  ::std::vector<SharedVariable> shared_;
+  // the constants the lengths of shared_ are built from
+  ::std::unordered_map<uint32_t, ConstantExpr> constants_;
+  uint32_t push_constant_size_ = 0;
+  bool has_push_constants_ = false;
+
+ public:
+  ShaderInfo() = default;
+  ShaderInfo(const uint32_t *spirv, ::std::size_t size);
+
+  [[nodiscard]] const ::std::vector<Binding> &bindings() const { return bindings_; }
+  [[nodiscard]] const ::std::vector<SpecConstant> &specConstants() const { return spec_constants_; }
+  [[nodiscard]] const ::std::vector<uint32_t> &capabilities() const { return capabilities_; }
+  [[nodiscard]] const ::std::array<LocalSize, 3> &localSize() const { return local_size_; }
+  [[nodiscard]] uint32_t pushConstantSize() const { return push_constant_size_; }
+  [[nodiscard]] bool hasPushConstants() const { return has_push_constants_; }
+  [[nodiscard]] const ::std::vector<SharedVariable> &sharedVariables() const { return shared_; }
+
+  /**
+   * @brief bytes of workgroup memory the shader declares with the spec values of spec, the defaults without. Drivers
+   * may pad the variables, this is a lower bound.
+   */
+  [[nodiscard]] uint64_t sharedMemorySize(const vk::SpecializationInfo *spec = nullptr) const;
+
+  [[nodiscard]] const Binding *findBinding(uint32_t binding, uint32_t set = 0) const;
+  [[nodiscard]] const SpecConstant *findSpecConstant(uint32_t id) const;
+
+  /**
+   * @brief check the descriptor types of the arguments against the bindings of set 0, throw on mismatch
+   */
+  void validateArguments(const vk::DescriptorType *types, ::std::size_t n) const;
+
+  /**
+   * @brief check the size of the C++ push constant struct against the push constant block, throw on mismatch
+   */
+  void validatePushConstants(::std::size_t size) const;
+
+  /**
+   * @brief check the sizes of the C++ specialization values against the constants with id [0, n), throw on mismatch
+   */
+  void validateSpecConstants(const ::std::size_t *sizes, ::std::size_t n) const;
+};
+
+} // namespace vuml::reflect
+
+#endif //VUML_INCLUDE_VUML_REFLECT_H_
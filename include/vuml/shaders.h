@@ -0,0 +1,45 @@
+//
+// Created by Homin Su on 2023/7/10.
+//
+
+#ifndef VUML_INCLUDE_VUML_SHADERS_H_
+#define VUML_INCLUDE_VUML_SHADERS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <vector>
+
+namespace vuml::shaders {
+
+/**
+ * @brief a SPIR-V module compiled into the binary by the vuml_add_shaders() CMake helper
+ */
+struct Shader {
+  const char *name;
+  const uint32_t *code;
+  ::std::size_t size;  // bytes
+};
+
+/**
+ * @brief the embedded shader with this name, the file name of its source such as "mandelbrot.comp", or nullptr
+ */
+const Shader *find(const char *name);
+
+/**
+ * @brief the embedded shader with this name, throw if there is none
+ */
+const Shader &get(const char *name);
+
+const ::std::vector<Shader> &all();
+
+/**
+ * @brief adds a shader to the registry during static initialization, used by the generated sources
+ */
+struct Registration {
+  Registration(const char *name, const uint32_t *code, ::std::size_t size);
+};
+
+} // namespace vuml::shaders
+
+#endif //VUML_INCLUDE_VUML_SHADERS_H_
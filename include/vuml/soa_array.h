@@ -0,0 +1,223 @@
+//
+// Created by Homin Su on 2023/7/20.
+//
+
+#ifndef VUML_INCLUDE_VUML_SOA_ARRAY_H_
+#define VUML_INCLUDE_VUML_SOA_ARRAY_H_
+
+#include <cstddef>
+
+#include <iterator>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "array.h"
+#include "device.h"
+#include "logger.h"
+#include "parallel.h"
+#include "traits.h"
+#include "utils.h"
+
+#include <vulkan/vulkan.hpp>
+
+namespace vuml {
+
+/**
+ * @brief records stored as a struct of arrays: one buffer per field, so a kernel reading a field only loads that field
+ * and neighbouring invocations load neighbouring words. It binds to a program as one argument per field, in order,
+ * in(), out() and inout() apply to all of them.
+ *
+ * On the host the records are converted from and to an array of structures: tuple-like records by default, any other
+ * record through a split function returning its fields, e.g. [](const P &p) { return ::std::tie(p.x, p.y); }. Records
+ * are rebuilt with Record{fields...}, which fits aggregates and tuples.
+ */
+template<class Alloc, typename ...Fields>
+class BasicSoAArray {
+ public:
+  using value_type = ::std::tuple<Fields...>;
+  static constexpr auto descriptor_type = vk::DescriptorType::eStorageBuffer;
+  static constexpr ::std::size_t field_count = sizeof...(Fields);
+
+  template<::std::size_t I>
+  using field_type = ::std::tuple_element_t<I, value_type>;
+
+ private:
+  template<typename T> using Upload = array::HostArray<T, memory::HostCoherent>;
+  template<typename T> using Download = array::HostArray<T, memory::HostCached>;
+
+  Device &device_;
+  ::std::tuple<Array<Fields, Alloc>...> fields_;
+  ::std::size_t size_;
+
+ public:
+  BasicSoAArray(Device &device,
+                ::std::size_t element_nums,
+                vk::MemoryPropertyFlags memory_flags = {},
+                vk::BufferUsageFlags buffer_flags = {})
+      : device_(device),
+        fields_(Array<Fields, Alloc>(device, element_nums, memory_flags, buffer_flags)...),
+        size_(element_nums) {
+    static_assert(sizeof...(Fields) != 0, "a struct of arrays needs fields");
+  }
+
+  template<typename It, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
+  BasicSoAArray(Device &device, It begin, It end)
+      : BasicSoAArray(device, static_cast<::std::size_t>(::std::distance(begin, end))) {
+    fromHost(begin, end);
+  }
+
+  template<typename It, typename Split, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
+  BasicSoAArray(Device &device, It begin, It end, Split &&split)
+      : BasicSoAArray(device, static_cast<::std::size_t>(::std::distance(begin, end))) {
+    fromHost(begin, end, ::std::forward<Split>(split));
+  }
+
+  template<typename It, typename Split, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
+  BasicSoAArray(Device &device, parallel::Par, It begin, It end, Split &&split)
+      : BasicSoAArray(device, static_cast<::std::size_t>(::std::distance(begin, end))) {
+    fromHost(parallel::par, begin, end, ::std::forward<Split>(split));
+  }
+
+  [[nodiscard]] ::std::size_t size() const { return size_; }
+
+  Device &device() { return device_; }
+
+  /**
+   * @brief the arrays of the fields, Program::bind() binds them in this order
+   */
+  ::std::tuple<Array<Fields, Alloc>...> &fields() { return fields_; }
+
+  template<::std::size_t I>
+  Array<field_type<I>, Alloc> &field() { return ::std::get<I>(fields_); }
+
+  template<typename It, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
+  void fromHost(It begin, It end) {
+    // the records are only copied, which is safe from several threads
+    fromHost(parallel::par, begin, end, [](const auto &record) -> decltype(auto) { return record; });
+  }
+
+  /**
+   * @brief scatter the records into the fields, split(record) returns a tuple of the fields. split is called in order.
+   */
+  template<typename It, typename Split, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
+  void fromHost(It begin, It end, Split &&split) {
+    from_host(begin, end, split, false);
+  }
+
+  /**
+   * @brief as above, split is called concurrently from the thread pool when It is random access
+   */
+  template<typename It, typename Split, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
+  void fromHost(parallel::Par, It begin, It end, Split &&split) {
+    from_host(begin, end, split, true);
+  }
+
+  template<typename It, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
+  void toHost(It dst) const {
+    using Record = typename ::std::iterator_traits<It>::value_type;
+    toHost(parallel::par, dst, [](const auto &...fields) { return Record{fields...}; });
+  }
+
+  /**
+   * @brief gather the fields into records, dst[i] = join(field 0 [i], field 1 [i], ...). join is called in order.
+   */
+  template<typename It, typename Join, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
+  void toHost(It dst, Join &&join) const {
+    if (size_ != 0) {
+      gather(dst, join, false, ::std::index_sequence_for<Fields...>());
+    }
+  }
+
+  /**
+   * @brief as above, join is called concurrently from the thread pool when It is random access
+   */
+  template<typename It, typename Join, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
+  void toHost(parallel::Par, It dst, Join &&join) const {
+    if (size_ != 0) {
+      gather(dst, join, true, ::std::index_sequence_for<Fields...>());
+    }
+  }
+
+ private:
+  template<typename It, typename Split>
+  void from_host(It begin, It end, Split &split, bool concurrent) {
+    auto n = static_cast<::std::size_t>(::std::distance(begin, end));
+    if (n > size_) {
+      ERROR("%zu records for a struct of arrays of %zu", n, size_);
+      throw ::std::out_of_range("more records than the struct of arrays holds");
+    }
+    if (n != 0) {
+      scatter(begin, n, split, concurrent, ::std::index_sequence_for<Fields...>());
+    }
+  }
+
+  template<typename It, typename Split, ::std::size_t ...Is>
+  void scatter(It begin, ::std::size_t n, Split &split, bool concurrent, ::std::index_sequence<Is...>) {
+    auto stages = ::std::make_tuple(Upload<Fields>(device_, n)...);
+    auto stage_data = ::std::make_tuple(::std::get<Is>(stages).data()...);
+    auto write = [&](::std::size_t i, const auto &record) {
+      decltype(auto) values = split(record);
+      ((::std::get<Is>(stage_data)[i] = ::std::get<Is>(values)), ...);
+    };
+    if constexpr (parallel::details::is_random_access_v<It>) {
+      if (concurrent) {
+        parallel::for_ranges(n, (sizeof(Fields) + ...), [&](::std::size_t first, ::std::size_t last) {
+          for (auto i = first; i < last; ++i) {
+            write(i, begin[static_cast<typename ::std::iterator_traits<It>::difference_type>(i)]);
+          }
+        });
+      }
+    } else {
+      concurrent = false;
+    }
+    // in order, or the iterator only goes forward
+    for (::std::size_t i = 0; !concurrent && i < n; ++i, ++begin) {
+      write(i, *begin);
+    }
+    (::std::get<Is>(stages).flush(), ...);
+    // the stages wait for their copies when they go
+    (array::copy_buf(device_,
+                     ::std::get<Is>(stages),
+                     ::std::get<Is>(stages).hazards(),
+                     ::std::get<Is>(fields_),
+                     ::std::get<Is>(fields_).hazards(),
+                     n * sizeof(Fields)), ...);
+  }
+
+  template<typename It, typename Join, ::std::size_t ...Is>
+  void gather(It dst, Join &join, bool concurrent, ::std::index_sequence<Is...>) const {
+    auto stages = ::std::make_tuple(Download<Fields>(device_, size_)...);
+    (array::copy_buf(device_,
+                     ::std::get<Is>(fields_),
+                     ::std::get<Is>(fields_).hazards(),
+                     ::std::get<Is>(stages),
+                     ::std::get<Is>(stages).hazards(),
+                     size_ * sizeof(Fields)), ...);
+    // data() waits for the copies
+    auto stage_data = ::std::make_tuple(::std::as_const(::std::get<Is>(stages)).data()...);
+    if constexpr (parallel::details::is_random_access_v<It>) {
+      if (concurrent) {
+        parallel::for_ranges(size_, (sizeof(Fields) + ...), [&](::std::size_t first, ::std::size_t last) {
+          for (auto i = first; i < last; ++i) {
+            dst[static_cast<typename ::std::iterator_traits<It>::difference_type>(i)] =
+                join(::std::get<Is>(stage_data)[i]...);
+          }
+        });
+      }
+    } else {
+      concurrent = false;
+    }
+    for (::std::size_t i = 0; !concurrent && i < size_; ++i, ++dst) {
+      *dst = join(::std::get<Is>(stage_data)[i]...);
+    }
+  }
+};
+
+template<typename ...Fields>
+using SoAArray = BasicSoAArray<memory::Device, Fields...>;
+
+} // namespace vuml
+
+#endif //VUML_INCLUDE_VUML_SOA_ARRAY_H_
@@ -0,0 +1,428 @@
+//
+// Created by Homin Su on 2023/7/16.
+//
+
+#ifndef VUML_INCLUDE_VUML_STREAM_H_
+#define VUML_INCLUDE_VUML_STREAM_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "array.h"
+#include "device.h"
+#include "logger.h"
+#include "non_copyable.h"
+#include "sync.h"
+#include "timestamp.h"
+#include "traits.h"
+#include "utils.h"
+#include "vuml.h"
+
+#if !VUML_WINDOWS
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#endif
+
+#include <vulkan/vulkan.hpp>
+
+namespace vuml {
+
+/**
+ * @brief what each stage of a Stream processed and how long it was busy. The device stage covers upload, kernels and
+ * download of a chunk, measured from the host between its submission (or the completion of the previous chunk) and
+ * its completion, so it is approximate.
+ */
+struct StreamStats {
+  struct Stage {
+    ::std::size_t bytes = 0;
+    nanoseconds busy{0};
+
+    /**
+     * @return bytes per second while busy
+     */
+    [[nodiscard]] double throughput() const {
+      auto seconds = ::std::chrono::duration<double>(busy).count();
+      return seconds > 0 ? static_cast<double>(bytes) / seconds : 0.0;
+    }
+  };
+
+  Stage read;
+  Stage device;
+  Stage write;
+  ::std::size_t chunks = 0;
+  nanoseconds elapsed{0};
+};
+
+namespace details {
+
+/**
+ * @brief blocking queue between two threads, pop() returns nothing once it is closed and empty
+ */
+template<typename T>
+class Channel : NonCopyable {
+ private:
+  ::std::deque<T> items_;
+  ::std::mutex mutex_;
+  ::std::condition_variable cv_;
+  bool closed_ = false;
+
+ public:
+  void push(T item) {
+    {
+      ::std::lock_guard<::std::mutex> lock(mutex_);
+      items_.push_back(::std::move(item));
+    }
+    cv_.notify_one();
+  }
+
+  void close() {
+    {
+      ::std::lock_guard<::std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    cv_.notify_all();
+  }
+
+  ::std::optional<T> pop() {
+    auto lock = ::std::unique_lock<::std::mutex>(mutex_);
+    cv_.wait(lock, [&] { return !items_.empty() || closed_; });
+    return take();
+  }
+
+  /**
+   * @param closed set when nothing will come anymore
+   */
+  ::std::optional<T> try_pop(bool &closed) {
+    ::std::lock_guard<::std::mutex> lock(mutex_);
+    closed = closed_ && items_.empty();
+    return take();
+  }
+
+ private:
+  ::std::optional<T> take() {
+    if (items_.empty()) { return ::std::nullopt; }
+    auto item = ::std::move(items_.front());
+    items_.pop_front();
+    return item;
+  }
+};
+
+} // namespace details
+
+/**
+ * @brief runs kernels over data larger than the device memory, chunk by chunk. The chunks go through N slots, so
+ * reading chunk i + 1 (on a reader thread), the device work of chunk i and writing chunk i - 1 (on a writer thread)
+ * overlap, with memory bounded by the slots. The producer writes straight into mapped staging memory and the consumer
+ * reads straight from it.
+ * @tparam In element type read from the producer
+ * @tparam Out element type handed to the consumer, the kernels write as many as they read
+ */
+template<typename In, typename Out = In>
+class Stream : NonCopyable {
+ public:
+  /**
+   * @brief fill dst with at most capacity elements, return how many, 0 at the end of the input
+   */
+  using Producer = ::std::function<::std::size_t(In *dst, ::std::size_t capacity)>;
+  /**
+   * @brief record the kernels of a chunk of count elements, they run on the device without being waited for
+   */
+  using Kernel = ::std::function<void(Array<In> &input, Array<Out> &output, uint32_t count)>;
+  using Consumer = ::std::function<void(const Out *src, ::std::size_t count)>;
+
+ private:
+  struct Slot {
+    array::HostArray<In, memory::HostCoherent> stage_in;
+    Array<In> input;
+    Array<Out> output;
+    array::HostArray<Out, memory::HostCached> stage_out;
+    In *stage_in_data;
+    const Out *stage_out_data;
+    vk::CommandBuffer upload_cmd;
+    vk::CommandBuffer download_cmd;
+    ::std::size_t count = 0;
+    SyncPoint uploaded;
+    SyncPoint done;
+    steady_time_point submitted;
+
+    Slot(Device &device, ::std::size_t chunk)
+        : stage_in(device, chunk), input(device, chunk), output(device, chunk), stage_out(device, chunk),
+          stage_in_data(stage_in.data()), stage_out_data(stage_out.data()) {}
+  };
+
+  Device &device_;
+  ::std::size_t chunk_;
+  ::std::vector<::std::unique_ptr<Slot>> slots_;
+  Producer producer_;
+  ::std::vector<Kernel> kernels_;
+  Consumer consumer_;
+
+ public:
+  /**
+   * @param chunk elements per chunk
+   * @param slots chunks in flight, 3 lets reading, device work and writing overlap
+   */
+  Stream(Device &device, ::std::size_t chunk, uint32_t slots = 3) : device_(device), chunk_(chunk) {
+    if (chunk == 0 || slots == 0) {
+      ERROR("a stream needs a chunk size and slots");
+      throw ::std::invalid_argument("a stream needs a chunk size and slots");
+    }
+    auto cmd_buffers = device_.allocateCommandBuffers(
+        {device_.transferCmdPool(), vk::CommandBufferLevel::ePrimary, 2 * slots}
+    );
+    for (uint32_t i = 0; i < slots; ++i) {
+      slots_.push_back(::std::make_unique<Slot>(device_, chunk_));
+      slots_.back()->upload_cmd = cmd_buffers[2 * i];
+      slots_.back()->download_cmd = cmd_buffers[2 * i + 1];
+    }
+  }
+
+  ~Stream() noexcept {
+    for (auto &slot : slots_) {
+      device_.wait(slot->uploaded);
+      device_.wait(slot->done);
+      device_.freeCommandBuffers(device_.transferCmdPool(), {slot->upload_cmd, slot->download_cmd});
+    }
+  }
+
+  Stream &source(Producer producer) {
+    producer_ = ::std::move(producer);
+    return *this;
+  }
+
+  template<typename It, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
+  Stream &source(It begin, It end) {
+    return source([begin, end](In *dst, ::std::size_t capacity) mutable {
+      ::std::size_t n = 0;
+      for (; n < capacity && begin != end; ++n, ++begin) {
+        dst[n] = *begin;
+      }
+      return n;
+    });
+  }
+
+  /**
+   * @brief append a kernel, the kernels of a chunk run in the order they were added
+   */
+  Stream &compute(Kernel kernel) {
+    kernels_.push_back(::std::move(kernel));
+    return *this;
+  }
+
+  Stream &sink(Consumer consumer) {
+    consumer_ = ::std::move(consumer);
+    return *this;
+  }
+
+  template<typename It, class = typename ::std::enable_if_t<traits::is_iterator_v<It>>>
+  Stream &sink(It out) {
+    return sink([out](const Out *src, ::std::size_t count) mutable {
+      out = ::std::copy(src, src + count, out);
+    });
+  }
+
+#if !VUML_WINDOWS
+  /**
+   * @brief read the elements from a file descriptor, a trailing partial element is dropped
+   */
+  Stream &source(int fd) {
+    return source([fd](In *dst, ::std::size_t capacity) {
+      auto bytes = read_fd(fd, reinterpret_cast<char *>(dst), capacity * sizeof(In));
+      if (bytes % sizeof(In) != 0) {
+        WARN("dropped a partial element of %zu bytes at the end of the input", bytes % sizeof(In));
+      }
+      return bytes / sizeof(In);
+    });
+  }
+
+  Stream &sink(int fd) {
+    return sink([fd](const Out *src, ::std::size_t count) {
+      write_fd(fd, reinterpret_cast<const char *>(src), count * sizeof(Out));
+    });
+  }
+#endif
+
+  /**
+   * @brief process the whole input, return once the consumer has the last chunk
+   */
+  StreamStats run() {
+    if (!producer_ || kernels_.empty() || !consumer_) {
+      ERROR("a stream needs a source, a kernel and a sink");
+      throw ::std::logic_error("a stream needs a source, a kernel and a sink");
+    }
+
+    auto stats = StreamStats{};
+    auto watch = Stopwatch();
+    auto free = details::Channel<Slot *>{};
+    auto filled = details::Channel<Slot *>{};
+    auto downloaded = details::Channel<Slot *>{};
+    for (auto &slot : slots_) {
+      free.push(slot.get());
+    }
+
+    ::std::exception_ptr reader_error;
+    ::std::exception_ptr writer_error;
+    auto reader = ::std::thread([&] {
+      try {
+        while (auto slot = free.pop()) {
+          auto lap = Stopwatch();
+          (*slot)->count = producer_((*slot)->stage_in_data, chunk_);
+          stats.read.busy += lap.elapsed();
+          stats.read.bytes += (*slot)->count * sizeof(In);
+          if ((*slot)->count == 0) { break; }
+          filled.push(*slot);
+        }
+      } catch (...) {
+        reader_error = ::std::current_exception();
+      }
+      filled.close();
+    });
+    auto writer = ::std::thread([&] {
+      try {
+        while (auto slot = downloaded.pop()) {
+          auto lap = Stopwatch();
+          consumer_((*slot)->stage_out_data, (*slot)->count);
+          stats.write.busy += lap.elapsed();
+          stats.write.bytes += (*slot)->count * sizeof(Out);
+          free.push(*slot);
+        }
+      } catch (...) {
+        writer_error = ::std::current_exception();
+        // unblock the reader, the remaining chunks are not processed
+        free.close();
+      }
+    });
+
+    // every device call is made from this thread
+    try {
+      auto in_flight = ::std::deque<Slot *>{};
+      auto last_done = steady_time_point{};
+      auto retire = [&](Slot *slot) {
+        // the reader refills the staging memory of the slot next
+        device_.wait(slot->uploaded);
+        device_.wait(slot->done);
+        auto now = clock::steady_now();
+        stats.device.busy += now - ::std::max(slot->submitted, last_done);
+        stats.device.bytes += slot->count * sizeof(In);
+        last_done = now;
+        // invalidates non-coherent staging memory
+        static_cast<void>(::std::as_const(slot->stage_out).data());
+        downloaded.push(slot);
+      };
+
+      auto eof = false;
+      while (!eof || !in_flight.empty()) {
+        while (!in_flight.empty() && device_.reached(in_flight.front()->done)) {
+          retire(in_flight.front());
+          in_flight.pop_front();
+        }
+        if (!eof && in_flight.size() < slots_.size()) {
+          auto slot = in_flight.empty() ? filled.pop() : filled.try_pop(eof);
+          if (slot) {
+            submit(**slot);
+            in_flight.push_back(*slot);
+            ++stats.chunks;
+            continue;
+          }
+          if (in_flight.empty()) { eof = true; }
+        }
+        if (!in_flight.empty()) {
+          retire(in_flight.front());
+          in_flight.pop_front();
+        }
+      }
+    } catch (...) {
+      free.close();
+      downloaded.close();
+      reader.join();
+      writer.join();
+      throw;
+    }
+    downloaded.close();
+    writer.join();
+    free.close();
+    reader.join();
+
+    if (reader_error) { ::std::rethrow_exception(reader_error); }
+    if (writer_error) { ::std::rethrow_exception(writer_error); }
+    stats.elapsed = watch.elapsed();
+    return stats;
+  }
+
+ private:
+  void submit(Slot &slot) {
+    slot.submitted = clock::steady_now();
+    slot.uploaded = copy(slot.upload_cmd, slot.stage_in, slot.input, slot.count * sizeof(In));
+    for (auto &kernel : kernels_) {
+      kernel(slot.input, slot.output, static_cast<uint32_t>(slot.count));
+    }
+    slot.done = copy(slot.download_cmd, slot.output, slot.stage_out, slot.count * sizeof(Out));
+  }
+
+  /**
+   * @brief like array::copy_buf, on a command buffer of the slot so the copies of the slots do not wait for each other
+   */
+  template<class Src, class Dst>
+  SyncPoint copy(vk::CommandBuffer cmd_buffer, Src &src, Dst &dst, ::std::size_t size_bytes) {
+    auto waits = ::std::vector<SyncPoint>{};
+    src.hazards().readDependencies(waits);
+    dst.hazards().writeDependencies(waits);
+    cmd_buffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    cmd_buffer.copyBuffer(src, dst, vk::BufferCopy(0, 0, size_bytes));
+    // the consumer reads the downloads from mapped memory
+    array::host_read_barrier(cmd_buffer, dst, 0, size_bytes);
+    cmd_buffer.end();
+    auto point = device_.submit(QueueKind::eTransfer, cmd_buffer, waits);
+    src.hazards().read(point, QueueKind::eTransfer);
+    dst.hazards().write(point);
+    return point;
+  }
+
+#if !VUML_WINDOWS
+  static ::std::size_t read_fd(int fd, char *dst, ::std::size_t size) {
+    ::std::size_t done = 0;
+    while (done < size) {
+      auto n = ::read(fd, dst + done, size - done);
+      if (n == 0) { break; }
+      if (n < 0) {
+        if (errno == EINTR) { continue; }
+        ERROR("read failed: %s", ::std::strerror(errno));
+        throw ::std::runtime_error("read failed");
+      }
+      done += static_cast<::std::size_t>(n);
+    }
+    return done;
+  }
+
+  static void write_fd(int fd, const char *src, ::std::size_t size) {
+    ::std::size_t done = 0;
+    while (done < size) {
+      auto n = ::write(fd, src + done, size - done);
+      if (n < 0) {
+        if (errno == EINTR) { continue; }
+        ERROR("write failed: %s", ::std::strerror(errno));
+        throw ::std::runtime_error("write failed");
+      }
+      done += static_cast<::std::size_t>(n);
+    }
+  }
+#endif
+};
+
+} // namespace vuml
+
+#endif //VUML_INCLUDE_VUML_STREAM_H_
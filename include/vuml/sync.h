@@ -0,0 +1,82 @@
+//
+// Created by Homin Su on 2023/7/5.
+//
+
+#ifndef VUML_INCLUDE_VUML_SYNC_H_
+#define VUML_INCLUDE_VUML_SYNC_H_
+
+#include <cstdint>
+
+#include <array>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+namespace vuml {
+
+enum class QueueKind : uint32_t {
+  eCompute = 0,
+  eTransfer = 1,
+};
+
+/**
+ * @brief a value on the timeline semaphore of a queue, reached when the submission that signals it completes.
+ * The default one is always reached.
+ */
+struct SyncPoint {
+  vk::Semaphore semaphore;
+  uint64_t value = 0;
+
+  explicit operator bool() const { return semaphore && value != 0; }
+};
+
+/**
+ * @brief the last submissions which accessed a resource, so the next access waits exactly for what it depends on
+ */
+struct Hazards {
+  SyncPoint last_write;
+  ::std::array<SyncPoint, 2> last_reads;
+  // the device wrote the resource since the host last looked at it
+  bool device_written = false;
+
+  /**
+   * @brief submissions a read must wait for
+   */
+  void readDependencies(::std::vector<SyncPoint> &waits) const {
+    if (last_write) { waits.push_back(last_write); }
+  }
+
+  /**
+   * @brief submissions a write must wait for
+   */
+  void writeDependencies(::std::vector<SyncPoint> &waits) const {
+    readDependencies(waits);
+    for (const auto &read : last_reads) {
+      if (read) { waits.push_back(read); }
+    }
+  }
+
+  /**
+   * @brief whether the host may access the resource right away: no pending submission it conflicts with and nothing
+   * to invalidate, e.g. from the second element access on
+   */
+  [[nodiscard]] bool hostReady(bool host_writes) const {
+    if (last_write || device_written) { return false; }
+    return !host_writes || (!last_reads[0] && !last_reads[1]);
+  }
+
+  void read(const SyncPoint &point, QueueKind queue) {
+    last_reads[static_cast<uint32_t>(queue)] = point;
+  }
+
+  void write(const SyncPoint &point) {
+    // the write waited for every earlier access
+    last_write = point;
+    last_reads = {};
+    device_written = true;
+  }
+};
+
+} // namespace vuml
+
+#endif //VUML_INCLUDE_VUML_SYNC_H_
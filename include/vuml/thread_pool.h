@@ -0,0 +1,77 @@
+//
+// Created by Homin Su on 2023/7/11.
+//
+
+#ifndef VUML_INCLUDE_VUML_THREAD_POOL_H_
+#define VUML_INCLUDE_VUML_THREAD_POOL_H_
+
+#include <cstddef>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "non_copyable.h"
+
+namespace vuml {
+
+/**
+ * @brief fixed set of worker threads running queued tasks in order
+ */
+class ThreadPool : private NonCopyable {
+ private:
+  ::std::vector<::std::thread> workers_;
+  ::std::deque<::std::function<void()>> tasks_;
+  ::std::mutex mutex_;
+  ::std::condition_variable cv_;
+  bool stop_ = false;
+
+ public:
+  /**
+   * @param threads number of workers, one per hardware thread by default
+   */
+  explicit ThreadPool(::std::size_t threads = 0);
+  ~ThreadPool() noexcept;
+
+  [[nodiscard]] ::std::size_t size() const { return workers_.size(); }
+
+  /**
+   * @brief queue a task, the future holds its result or its exception
+   */
+  template<typename F>
+  ::std::future<::std::invoke_result_t<::std::decay_t<F>>> submit(F &&func) {
+    using R = ::std::invoke_result_t<::std::decay_t<F>>;
+    auto task = ::std::make_shared<::std::packaged_task<R()>>(::std::forward<F>(func));
+    auto future = task->get_future();
+    {
+      ::std::lock_guard<::std::mutex> lock(mutex_);
+      tasks_.emplace_back([task] { (*task)(); });
+    }
+    cv_.notify_one();
+    return future;
+  }
+
+  /**
+   * @brief pool shared by the library, created on first use
+   */
+  static ThreadPool &global();
+
+  /**
+   * @brief whether the calling thread is a worker of some pool, a task waiting for other tasks could starve it
+   */
+  static bool onWorker();
+
+ private:
+  void loop();
+};
+
+} // namespace vuml
+
+#endif //VUML_INCLUDE_VUML_THREAD_POOL_H_
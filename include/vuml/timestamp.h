@@ -6,10 +6,14 @@
 #define VUML_TIMESTAMP_H
 
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <ctime>
 
+#include <algorithm>
 #include <chrono>
+#include <limits>
 
 namespace vuml {
 
@@ -23,6 +27,10 @@ using hours = ::std::chrono::hours;
 using system_clock = ::std::chrono::system_clock;
 using time_point = ::std::chrono::time_point<system_clock, nanoseconds>;
 
+// monotonic, for durations: never jumps with wall clock adjustments
+using steady_clock = ::std::chrono::steady_clock;
+using steady_time_point = ::std::chrono::time_point<steady_clock, nanoseconds>;
+
 namespace clock {
 
 inline time_point now() { return system_clock::now(); }
@@ -31,30 +39,104 @@ inline time_point after_now(nanoseconds _interval) { return now() + _interval; }
 
 inline time_point before_now(nanoseconds _interval) { return now() - _interval; }
 
+inline steady_time_point steady_now() { return steady_clock::now(); }
+
+inline nanoseconds elapsed(steady_time_point _since) { return steady_now() - _since; }
+
+namespace details {
+
+/**
+ * @brief the date and time of the last rendered second, "YYYY-MM-DDTHH:MM:SS."
+ */
+struct SecondCache {
+  int64_t second = ::std::numeric_limits<int64_t>::min();
+  char prefix[32]{0};
+  ::std::size_t length = 0;
+};
+
+inline SecondCache &second_cache() {
+  thread_local SecondCache cache;
+  return cache;
+}
+
+} // namespace details
+
+/**
+ * @brief format as "YYYY-MM-DDTHH:MM:SS.mmmZ", the date is only rendered again when the second changes
+ * @return length of the formatted time, like snprintf
+ */
+inline int to_string(time_point _time, char *_data, ::std::size_t _size) {
+  auto t_s = ::std::chrono::floor<seconds>(_time);
+  auto ms = static_cast<int>(::std::chrono::duration_cast<milliseconds>(_time - t_s).count());
+  auto second = static_cast<int64_t>(t_s.time_since_epoch().count());
+
+  auto &cache = details::second_cache();
+  if (cache.second != second) {
+    auto t = static_cast<::std::time_t>(second);
+    tm tm_time{};
+    gmtime_r(&t, &tm_time);
+    auto n = snprintf(cache.prefix,
+                      sizeof(cache.prefix),
+                      "%4d-%02d-%02dT%02d:%02d:%02d.",
+                      tm_time.tm_year + 1900,
+                      tm_time.tm_mon + 1,
+                      tm_time.tm_mday,
+                      tm_time.tm_hour,
+                      tm_time.tm_min,
+                      tm_time.tm_sec);
+    cache.length = ::std::min(static_cast<::std::size_t>(n), sizeof(cache.prefix) - 1);
+    cache.second = second;
+  }
+
+  // prefix, three digits of milliseconds and the zone
+  char tail[4] = {
+      static_cast<char>('0' + ms / 100),
+      static_cast<char>('0' + ms / 10 % 10),
+      static_cast<char>('0' + ms % 10),
+      'Z'
+  };
+  auto length = cache.length + sizeof(tail);
+  if (_size != 0) {
+    auto n = ::std::min(cache.length, _size - 1);
+    ::std::memcpy(_data, cache.prefix, n);
+    auto m = ::std::min(sizeof(tail), _size - 1 - n);
+    ::std::memcpy(_data + n, tail, m);
+    _data[n + m] = '\0';
+  }
+  return static_cast<int>(length);
+}
+
 inline int to_string(char *_data, ::std::size_t _size) {
-  auto n = system_clock::now();
-  auto t_s = ::std::chrono::duration_cast<seconds>(n.time_since_epoch());
-  auto t_ms = ::std::chrono::duration_cast<milliseconds>(n.time_since_epoch());
-  auto ms = static_cast<int>((t_ms - t_s).count());
-  auto t = system_clock::to_time_t(n);
-
-  tm tm_time{};
-  gmtime_r(&t, &tm_time);
-
-  return snprintf(_data,
-                  _size,
-                  "%4d-%02d-%02dT%02d:%02d:%02d.%03dZ",
-                  tm_time.tm_year + 1900,
-                  tm_time.tm_mon + 1,
-                  tm_time.tm_mday,
-                  tm_time.tm_hour,
-                  tm_time.tm_min,
-                  tm_time.tm_sec,
-                  ms);
+  return to_string(now(), _data, _size);
 }
 
 } // namespace clock
 
+/**
+ * @brief measures latencies on the steady clock
+ */
+class Stopwatch {
+ private:
+  steady_time_point start_;
+
+ public:
+  Stopwatch() : start_(clock::steady_now()) {}
+
+  [[nodiscard]] nanoseconds elapsed() const { return clock::elapsed(start_); }
+
+  /**
+   * @brief time since the start or the last lap, then start a new lap
+   */
+  nanoseconds lap() {
+    auto now = clock::steady_now();
+    auto r = now - start_;
+    start_ = now;
+    return r;
+  }
+
+  void reset() { start_ = clock::steady_now(); }
+};
+
 } // namespace vuml
 
 #endif //VUML_TIMESTAMP_H
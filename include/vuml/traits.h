@@ -5,8 +5,10 @@
 #ifndef VUML_INCLUDE_VUML_TRAITS_H_
 #define VUML_INCLUDE_VUML_TRAITS_H_
 
+#include <iterator>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 namespace vuml::traits {
 
@@ -39,6 +41,26 @@ struct is_iterator<T, ::std::void_t<
 template<typename T>
 constexpr bool is_iterator_v = is_iterator<T>::value;
 
+/**
+ * @brief iterators whose elements are laid out like an array: pointers and std::vector iterators
+ */
+template<typename T, typename = void>
+struct is_contiguous_iterator : ::std::is_pointer<T> {};
+
+template<typename T>
+struct is_contiguous_iterator<T, ::std::enable_if_t<
+    !::std::is_pointer_v<T> && ::std::is_trivially_copyable_v<typename ::std::iterator_traits<T>::value_type>
+>> : ::std::bool_constant<
+    !::std::is_same_v<typename ::std::iterator_traits<T>::value_type, bool> && (
+        ::std::is_same_v<T, typename ::std::vector<typename ::std::iterator_traits<T>::value_type>::iterator> ||
+        ::std::is_same_v<T, typename ::std::vector<typename ::std::iterator_traits<T>::value_type>::const_iterator>
+    )
+> {
+};
+
+template<typename T>
+constexpr bool is_contiguous_iterator_v = is_contiguous_iterator<T>::value;
+
 template<typename Tuple>
 struct tuple_args_len {};
 
@@ -13,6 +13,7 @@
 
 #include "device.h"
 #include "non_copyable.h"
+#include "sync.h"
 
 #include <vulkan/vulkan.hpp>
 
@@ -20,10 +21,55 @@ namespace vuml {
 
 inline uint32_t div_up(uint32_t x, uint32_t y) { return (x + y - 1u) / y; }
 
+constexpr uint32_t spirv_magic = 0x07230203;
+
+/**
+ * @brief check the size and the magic number of a SPIR-V module, throw if it is not one
+ */
+void validate_spirv(const uint32_t *code, ::std::size_t size_bytes, const char *name);
+
 ::std::vector<uint32_t> read_spirv(const char *filename);
 
+/**
+ * @brief a SPIR-V file mapped read-only, the module is handed to the driver without being copied
+ */
+class SpirvFile : private NonCopyable {
+ private:
+  const uint32_t *code_ = nullptr;
+  ::std::size_t size_ = 0;
+  void *mapping_ = nullptr;
+  // where the file is read when it cannot be mapped
+  ::std::vector<uint32_t> buffer_;
+
+ public:
+  explicit SpirvFile(const char *filename);
+  ~SpirvFile() noexcept;
+
+  SpirvFile(SpirvFile &&other) noexcept;
+  SpirvFile &operator=(SpirvFile &&other) noexcept;
+
+  [[nodiscard]] const uint32_t *data() const { return code_; }
+  /**
+   * @return size in bytes
+   */
+  [[nodiscard]] ::std::size_t size() const { return size_; }
+
+ private:
+  void release() noexcept;
+};
+
 namespace array {
 
+/**
+ * @brief make the transfer writes to [offset, offset + size) of dst visible to host reads of mapped memory, the
+ * semaphore of the submission alone does not, even for coherent memory. Recorded after the copies into a buffer the
+ * host may read, it costs nothing to a buffer it does not.
+ */
+void host_read_barrier(vk::CommandBuffer cmd_buffer,
+                       vk::Buffer dst,
+                       vk::DeviceSize offset = 0,
+                       vk::DeviceSize size = VK_WHOLE_SIZE);
+
 void copy_buf(Device &device,
               vk::Buffer src,
               vk::Buffer dst,
@@ -31,6 +77,91 @@ void copy_buf(Device &device,
               ::std::size_t src_offset = 0,
               ::std::size_t dst_offset = 0);
 
+/**
+ * @brief copy without blocking the host, after the last write of src and the last accesses of dst
+ * @return the point reached when the copy is done, also recorded in the hazards
+ */
+SyncPoint copy_buf(Device &device,
+                   vk::Buffer src,
+                   Hazards &src_hazards,
+                   vk::Buffer dst,
+                   Hazards &dst_hazards,
+                   ::std::size_t size_bytes,
+                   ::std::size_t src_offset = 0,
+                   ::std::size_t dst_offset = 0);
+
+/**
+ * @brief fill with a 32-bit value without blocking the host, after the last accesses of dst, which needs the transfer
+ * destination usage. size_bytes and dst_offset are multiples of 4.
+ */
+SyncPoint fill_buf(Device &device,
+                   vk::Buffer dst,
+                   Hazards &dst_hazards,
+                   uint32_t value,
+                   ::std::size_t size_bytes,
+                   ::std::size_t dst_offset = 0);
+
+/**
+ * @brief move a new image to the general layout, which images keep for their whole life: storage images need it and
+ * sampling, copies and the layout transitions in between would cost more than the faster layouts save
+ */
+SyncPoint init_image_layout(Device &device, vk::Image image, Hazards &hazards);
+
+/**
+ * @brief copy tightly packed texels from a buffer into a whole color image in the general layout, without blocking
+ * the host, see copy_buf()
+ */
+SyncPoint copy_buf_to_image(Device &device,
+                            vk::Buffer src,
+                            Hazards &src_hazards,
+                            vk::Image dst,
+                            Hazards &dst_hazards,
+                            vk::Extent3D extent,
+                            ::std::size_t src_offset = 0);
+
+/**
+ * @brief copy a whole color image in the general layout into tightly packed texels of a buffer, the reverse of
+ * copy_buf_to_image()
+ */
+SyncPoint copy_image_to_buf(Device &device,
+                            vk::Image src,
+                            Hazards &src_hazards,
+                            vk::Buffer dst,
+                            Hazards &dst_hazards,
+                            vk::Extent3D extent,
+                            ::std::size_t dst_offset = 0);
+
+/**
+ * @brief read size_bytes of a file from offset into a device buffer. Disk reads go straight into mapped staging
+ * chunks, with O_DIRECT when the file system allows it, several outstanding reads on pool threads and the copy of each
+ * chunk to the device overlapping the reads of the next ones. Returns once dst is written.
+ */
+void read_file(Device &device,
+               const char *path,
+               uint64_t offset,
+               ::std::size_t size_bytes,
+               vk::Buffer dst,
+               Hazards &dst_hazards,
+               ::std::size_t dst_offset = 0);
+
+/**
+ * @brief read size_bytes of a file from offset into host memory, such as a mapped buffer
+ */
+void read_file(const char *path, uint64_t offset, ::std::size_t size_bytes, void *dst);
+
+/**
+ * @brief write size_bytes of a device buffer into a file at offset, creating it if needed, the reverse of read_file()
+ */
+void write_file(Device &device,
+                const char *path,
+                uint64_t offset,
+                ::std::size_t size_bytes,
+                vk::Buffer src,
+                Hazards &src_hazards,
+                ::std::size_t src_offset = 0);
+
+void write_file(const char *path, uint64_t offset, ::std::size_t size_bytes, const void *src);
+
 } // namespace array
 
 template<class T>
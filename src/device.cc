@@ -4,6 +4,7 @@
 
 #include "vuml/device.h"
 
+#include <algorithm>
 #include <array>
 #include <exception>
 #include <limits>
@@ -11,15 +12,23 @@
 #include <utility>
 #include <vector>
 
+#include "vuml/instance.h"
 #include "vuml/logger.h"
 #include "vuml/traits.h"
 
 namespace {
 
+// command buffers of the transfer ring, as many copies can be in flight before one waits
+constexpr uint32_t transfer_ring_size = 4;
+
 #ifndef NDEBUG
-constexpr ::std::array<const char *, 1> default_extensions = {"VK_KHR_portability_subset"};
+constexpr ::std::array<const char *, 3> default_extensions = {
+    "VK_KHR_portability_subset", "VK_EXT_memory_budget", "VK_EXT_subgroup_size_control"
+};
 #else
-constexpr ::std::array<const char *, 1> default_extensions = {"VK_KHR_portability_subset"};
+constexpr ::std::array<const char *, 3> default_extensions = {
+    "VK_KHR_portability_subset", "VK_EXT_memory_budget", "VK_EXT_subgroup_size_control"
+};
 #endif
 
 template<typename T, typename F, class = typename ::std::enable_if_t<
@@ -57,10 +66,159 @@ template<typename U, typename T, typename F, class = typename ::std::enable_if_t
   return r;
 }
 
+bool isVulkan12(const vuml::Instance &instance, const vk::PhysicalDevice &phy_device) {
+  return ::std::min(instance.apiVersion(), phy_device.getProperties().apiVersion) >= VK_API_VERSION_1_2;
+}
+
+bool supportsTimeline(const vuml::Instance &instance, const vk::PhysicalDevice &phy_device) {
+  if (!isVulkan12(instance, phy_device)) {
+    return false;
+  }
+  auto features = phy_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceTimelineSemaphoreFeatures>();
+  return features.get<vk::PhysicalDeviceTimelineSemaphoreFeatures>().timelineSemaphore;
+}
+
+bool hasDeviceExtension(const vk::PhysicalDevice &phy_device, const char *name) {
+  return contains(name, phy_device.enumerateDeviceExtensionProperties(), [](const auto &property) {
+    return property.extensionName.data();
+  });
+}
+
+/**
+ * @brief whether VK_EXT_memory_budget is enabled: filter_extensions() adds it whenever the device has it. Reading it
+ * takes getMemoryProperties2, core in Vulkan 1.1.
+ */
+bool memoryBudget(const vuml::Instance &instance, const vk::PhysicalDevice &phy_device) {
+  return ::std::min(instance.apiVersion(), phy_device.getProperties().apiVersion) >= VK_API_VERSION_1_1
+      && hasDeviceExtension(phy_device, "VK_EXT_memory_budget");
+}
+
+/**
+ * @brief what the device supports of VK_EXT_subgroup_size_control, all false without it
+ */
+vk::PhysicalDeviceSubgroupSizeControlFeaturesEXT subgroupSizeControl(const vuml::Instance &instance,
+                                                                     const vk::PhysicalDevice &phy_device) {
+  if (::std::min(instance.apiVersion(), phy_device.getProperties().apiVersion) < VK_API_VERSION_1_1
+      || !hasDeviceExtension(phy_device, "VK_EXT_subgroup_size_control")) {
+    return {};
+  }
+  auto features = phy_device.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                          vk::PhysicalDeviceSubgroupSizeControlFeaturesEXT>();
+  auto r = features.get<vk::PhysicalDeviceSubgroupSizeControlFeaturesEXT>();
+  r.pNext = nullptr;
+  return r;
+}
+
+vuml::SubgroupProperties querySubgroup(const vuml::Instance &instance, const vk::PhysicalDevice &phy_device) {
+  auto r = vuml::SubgroupProperties{};
+  if (::std::min(instance.apiVersion(), phy_device.getProperties().apiVersion) < VK_API_VERSION_1_1) {
+    return r;
+  }
+  auto fill = [&](const vk::PhysicalDeviceSubgroupProperties &subgroup) {
+    r.size = subgroup.subgroupSize;
+    r.min_size = r.max_size = subgroup.subgroupSize;
+    if (subgroup.supportedStages & vk::ShaderStageFlagBits::eCompute) {
+      r.operations = subgroup.supportedOperations;
+    }
+  };
+  auto control = subgroupSizeControl(instance, phy_device);
+  if (!control.subgroupSizeControl) {
+    fill(phy_device.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceSubgroupProperties>()
+             .get<vk::PhysicalDeviceSubgroupProperties>());
+    return r;
+  }
+  auto chain = phy_device.getProperties2<vk::PhysicalDeviceProperties2,
+                                         vk::PhysicalDeviceSubgroupProperties,
+                                         vk::PhysicalDeviceSubgroupSizeControlPropertiesEXT>();
+  fill(chain.get<vk::PhysicalDeviceSubgroupProperties>());
+  const auto &size_control = chain.get<vk::PhysicalDeviceSubgroupSizeControlPropertiesEXT>();
+  // a device may not let compute pipelines require a size, they can still ask for full subgroups
+  if (size_control.requiredSubgroupSizeStages & vk::ShaderStageFlagBits::eCompute) {
+    r.min_size = size_control.minSubgroupSize;
+    r.max_size = size_control.maxSubgroupSize;
+    r.size_control = true;
+  }
+  r.full_subgroups = control.computeFullSubgroups;
+  return r;
+}
+
+struct FeatureName {
+  bool vuml::DeviceFeatures::*feature;
+  const char *name;
+};
+
+constexpr ::std::array<FeatureName, 15> feature_names = {{
+    {&vuml::DeviceFeatures::shader_float16, "shaderFloat16"},
+    {&vuml::DeviceFeatures::shader_float64, "shaderFloat64"},
+    {&vuml::DeviceFeatures::shader_int8, "shaderInt8"},
+    {&vuml::DeviceFeatures::shader_int16, "shaderInt16"},
+    {&vuml::DeviceFeatures::shader_int64, "shaderInt64"},
+    {&vuml::DeviceFeatures::storage_buffer_8bit, "storageBuffer8BitAccess"},
+    {&vuml::DeviceFeatures::uniform_buffer_8bit, "uniformAndStorageBuffer8BitAccess"},
+    {&vuml::DeviceFeatures::push_constant_8bit, "storagePushConstant8"},
+    {&vuml::DeviceFeatures::storage_buffer_16bit, "storageBuffer16BitAccess"},
+    {&vuml::DeviceFeatures::uniform_buffer_16bit, "uniformAndStorageBuffer16BitAccess"},
+    {&vuml::DeviceFeatures::push_constant_16bit, "storagePushConstant16"},
+    {&vuml::DeviceFeatures::buffer_int64_atomics, "shaderBufferInt64Atomics"},
+    {&vuml::DeviceFeatures::shared_int64_atomics, "shaderSharedInt64Atomics"},
+    {&vuml::DeviceFeatures::storage_image_read_without_format, "shaderStorageImageReadWithoutFormat"},
+    {&vuml::DeviceFeatures::storage_image_write_without_format, "shaderStorageImageWriteWithoutFormat"},
+}};
+
+vuml::DeviceFeatures supportedFeatures(const vuml::Instance &instance, const vk::PhysicalDevice &phy_device) {
+  auto r = vuml::DeviceFeatures{};
+  auto core = phy_device.getFeatures();
+  r.shader_float64 = core.shaderFloat64;
+  r.shader_int16 = core.shaderInt16;
+  r.shader_int64 = core.shaderInt64;
+  r.storage_image_read_without_format = core.shaderStorageImageReadWithoutFormat;
+  r.storage_image_write_without_format = core.shaderStorageImageWriteWithoutFormat;
+  if (!isVulkan12(instance, phy_device)) {
+    return r;
+  }
+  auto features = phy_device.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                          vk::PhysicalDeviceVulkan11Features,
+                                          vk::PhysicalDeviceVulkan12Features>();
+  const auto &v11 = features.get<vk::PhysicalDeviceVulkan11Features>();
+  const auto &v12 = features.get<vk::PhysicalDeviceVulkan12Features>();
+  r.shader_float16 = v12.shaderFloat16;
+  r.shader_int8 = v12.shaderInt8;
+  r.storage_buffer_8bit = v12.storageBuffer8BitAccess;
+  r.uniform_buffer_8bit = v12.uniformAndStorageBuffer8BitAccess;
+  r.push_constant_8bit = v12.storagePushConstant8;
+  r.storage_buffer_16bit = v11.storageBuffer16BitAccess;
+  r.uniform_buffer_16bit = v11.uniformAndStorageBuffer16BitAccess;
+  r.push_constant_16bit = v11.storagePushConstant16;
+  r.buffer_int64_atomics = v12.shaderBufferInt64Atomics;
+  r.shared_int64_atomics = v12.shaderSharedInt64Atomics;
+  return r;
+}
+
+/**
+ * @brief the requested features the device has, the others are reported
+ */
+vuml::DeviceFeatures enableFeatures(const vuml::Instance &instance,
+                                    const vk::PhysicalDevice &phy_device,
+                                    const vuml::DeviceFeatures &requested) {
+  auto supported = supportedFeatures(instance, phy_device);
+  auto r = vuml::DeviceFeatures{};
+  for (const auto &f : feature_names) {
+    r.*f.feature = requested.*f.feature && supported.*f.feature;
+    if (requested.*f.feature && !supported.*f.feature) {
+      WARN("feature %s is missing", f.name);
+    }
+  }
+  return r;
+}
+
 vk::Device createDevice(const vk::PhysicalDevice &phy_device,
                         uint32_t cmp_family_id,
                         uint32_t tfr_family_id,
-                        const ::std::vector<const char *> &extensions) {
+                        const ::std::vector<const char *> &extensions,
+                        bool vulkan12,
+                        bool timeline,
+                        vk::PhysicalDeviceSubgroupSizeControlFeaturesEXT size_control,
+                        const vuml::DeviceFeatures &enabled) {
   float priority = 1.0;
   auto queue_infos = ::std::array<vk::DeviceQueueCreateInfo, 2>{};
   queue_infos[0] = vk::DeviceQueueCreateInfo(vk::DeviceQueueCreateFlags(), cmp_family_id, 1, &priority);
@@ -79,6 +237,38 @@ vk::Device createDevice(const vk::PhysicalDevice &phy_device,
                                           nullptr,
                                           ext.size(),
                                           ext.data());
+  auto features = vk::PhysicalDeviceFeatures2();
+  features.features.shaderFloat64 = enabled.shader_float64;
+  features.features.shaderInt16 = enabled.shader_int16;
+  features.features.shaderInt64 = enabled.shader_int64;
+  features.features.shaderStorageImageReadWithoutFormat = enabled.storage_image_read_without_format;
+  features.features.shaderStorageImageWriteWithoutFormat = enabled.storage_image_write_without_format;
+  auto v11 = vk::PhysicalDeviceVulkan11Features();
+  v11.storageBuffer16BitAccess = enabled.storage_buffer_16bit;
+  v11.uniformAndStorageBuffer16BitAccess = enabled.uniform_buffer_16bit;
+  v11.storagePushConstant16 = enabled.push_constant_16bit;
+  auto v12 = vk::PhysicalDeviceVulkan12Features();
+  v12.shaderFloat16 = enabled.shader_float16;
+  v12.shaderInt8 = enabled.shader_int8;
+  v12.storageBuffer8BitAccess = enabled.storage_buffer_8bit;
+  v12.uniformAndStorageBuffer8BitAccess = enabled.uniform_buffer_8bit;
+  v12.storagePushConstant8 = enabled.push_constant_8bit;
+  v12.shaderBufferInt64Atomics = enabled.buffer_int64_atomics;
+  v12.shaderSharedInt64Atomics = enabled.shared_int64_atomics;
+  v12.timelineSemaphore = timeline;
+  if (vulkan12) {
+    // the Vulkan 1.1 and 1.2 structs take the place of the per-extension ones, the timeline included
+    features.pNext = &v11;
+    v11.pNext = &v12;
+    device_info.pNext = &features;
+  } else {
+    device_info.pEnabledFeatures = &features.features;
+  }
+  // the extension is in the list whenever the device has it, see default_extensions
+  if (size_control.subgroupSizeControl) {
+    size_control.pNext = const_cast<void *>(device_info.pNext);
+    device_info.pNext = &size_control;
+  }
   return phy_device.createDevice(device_info);
 }
 
@@ -97,6 +287,69 @@ uint32_t getFamilyID(const ::std::vector<vk::QueueFamilyProperties> &queue_famil
   return ret;
 }
 
+vk::Semaphore createTimeline(vk::Device device) {
+  auto type_info = vk::SemaphoreTypeCreateInfo(vk::SemaphoreType::eTimeline, 0);
+  auto info = vk::SemaphoreCreateInfo();
+  info.pNext = &type_info;
+  return device.createSemaphore(info);
+}
+
+/**
+ * @brief a SPIR-V capability of compute shaders and what the device needs to run it
+ */
+struct CapabilityNeed {
+  uint32_t capability;
+  const char *name;
+  bool (*available)(const vuml::DeviceFeatures &, const vuml::SubgroupProperties &);
+};
+
+using Features = vuml::DeviceFeatures;
+using Subgroup = vuml::SubgroupProperties;
+using SubgroupOp = vk::SubgroupFeatureFlagBits;
+
+const ::std::array<CapabilityNeed, 22> capability_needs = {{
+    {9, "Float16", [](const Features &f, const Subgroup &) { return f.shader_float16; }},
+    {10, "Float64", [](const Features &f, const Subgroup &) { return f.shader_float64; }},
+    {11, "Int64", [](const Features &f, const Subgroup &) { return f.shader_int64; }},
+    {12, "Int64Atomics", [](const Features &f, const Subgroup &) {
+      return f.buffer_int64_atomics || f.shared_int64_atomics;
+    }},
+    {22, "Int16", [](const Features &f, const Subgroup &) { return f.shader_int16; }},
+    {39, "Int8", [](const Features &f, const Subgroup &) { return f.shader_int8; }},
+    {55, "StorageImageReadWithoutFormat", [](const Features &f, const Subgroup &) {
+      return f.storage_image_read_without_format;
+    }},
+    {56, "StorageImageWriteWithoutFormat", [](const Features &f, const Subgroup &) {
+      return f.storage_image_write_without_format;
+    }},
+    {61, "GroupNonUniform", [](const Features &, const Subgroup &s) { return s.supports(SubgroupOp::eBasic); }},
+    {62, "GroupNonUniformVote", [](const Features &, const Subgroup &s) { return s.supports(SubgroupOp::eVote); }},
+    {63, "GroupNonUniformArithmetic", [](const Features &, const Subgroup &s) {
+      return s.supports(SubgroupOp::eArithmetic);
+    }},
+    {64, "GroupNonUniformBallot", [](const Features &, const Subgroup &s) { return s.supports(SubgroupOp::eBallot); }},
+    {65, "GroupNonUniformShuffle", [](const Features &, const Subgroup &s) {
+      return s.supports(SubgroupOp::eShuffle);
+    }},
+    {66, "GroupNonUniformShuffleRelative", [](const Features &, const Subgroup &s) {
+      return s.supports(SubgroupOp::eShuffleRelative);
+    }},
+    {67, "GroupNonUniformClustered", [](const Features &, const Subgroup &s) {
+      return s.supports(SubgroupOp::eClustered);
+    }},
+    {68, "GroupNonUniformQuad", [](const Features &, const Subgroup &s) { return s.supports(SubgroupOp::eQuad); }},
+    {4433, "StorageBuffer16BitAccess", [](const Features &f, const Subgroup &) { return f.storage_buffer_16bit; }},
+    {4434, "UniformAndStorageBuffer16BitAccess", [](const Features &f, const Subgroup &) {
+      return f.uniform_buffer_16bit;
+    }},
+    {4435, "StoragePushConstant16", [](const Features &f, const Subgroup &) { return f.push_constant_16bit; }},
+    {4448, "StorageBuffer8BitAccess", [](const Features &f, const Subgroup &) { return f.storage_buffer_8bit; }},
+    {4449, "UniformAndStorageBuffer8BitAccess", [](const Features &f, const Subgroup &) {
+      return f.uniform_buffer_8bit;
+    }},
+    {4450, "StoragePushConstant8", [](const Features &f, const Subgroup &) { return f.push_constant_8bit; }},
+}};
+
 vk::CommandBuffer allocCmdBuffer(vk::Device device,
                                  vk::CommandPool pool,
                                  vk::CommandBufferLevel level = vk::CommandBufferLevel::ePrimary) {
@@ -110,8 +363,15 @@ namespace vuml {
 
 inline namespace v1 {
 
-Device::Device(Instance &instance, vk::PhysicalDevice &phy_device, const ::std::vector<const char *> &extensions)
-    : Device(instance, phy_device, phy_device.getQueueFamilyProperties(), extensions) {
+Device::Device(Instance &instance,
+               vk::PhysicalDevice &phy_device,
+               const ::std::vector<const char *> &extensions,
+               const DeviceFeatures &features)
+    : Device(instance,
+             phy_device,
+             phy_device.getQueueFamilyProperties(),
+             extensions,
+             enableFeatures(instance, phy_device, features)) {
 }
 
 Device::~Device() noexcept {
@@ -119,7 +379,12 @@ Device::~Device() noexcept {
 }
 
 Device::Device(const Device &other)
-    : Device(other.instance_, other.phy_device_, other.cmp_family_id_, other.tfr_family_id_, other.extensions_) {
+    : Device(other.instance_,
+             other.phy_device_,
+             other.cmp_family_id_,
+             other.tfr_family_id_,
+             other.extensions_,
+             other.features_) {
 }
 
 Device &Device::operator=(Device other) {
@@ -135,9 +400,23 @@ Device::Device(Device &&other) noexcept
       compute_cmd_buffer_(other.compute_cmd_buffer_),
       transfer_cmd_pool_(other.transfer_cmd_pool_),
       transfer_cmd_buffer_(other.transfer_cmd_buffer_),
+      transfer_ring_(::std::move(other.transfer_ring_)),
+      transfer_next_(other.transfer_next_),
       cmp_family_id_(other.cmp_family_id_),
       tfr_family_id_(other.tfr_family_id_),
-      extensions_(::std::move(other.extensions_)) {
+      extensions_(::std::move(other.extensions_)),
+      compute_timeline_(other.compute_timeline_),
+      transfer_timeline_(other.transfer_timeline_),
+      heap_tracked_(other.heap_tracked_),
+      alloc_policy_(other.alloc_policy_),
+      fallback_count_(other.fallback_count_),
+      use_tick_(other.use_tick_),
+      evictables_(::std::move(other.evictables_)),
+      evicting_(other.evicting_),
+      memory_budget_(other.memory_budget_),
+      subgroup_(other.subgroup_),
+      features_(other.features_) {
+  static_cast<vk::Device &>(other) = nullptr;
 }
 
 Device &Device::operator=(Device &&other) noexcept {
@@ -152,9 +431,22 @@ void swap(Device &d1, Device &d2) {
   ::std::swap(d1.compute_cmd_buffer_, d2.compute_cmd_buffer_);
   ::std::swap(d1.transfer_cmd_pool_, d2.transfer_cmd_pool_);
   ::std::swap(d1.transfer_cmd_buffer_, d2.transfer_cmd_buffer_);
+  ::std::swap(d1.transfer_ring_, d2.transfer_ring_);
+  ::std::swap(d1.transfer_next_, d2.transfer_next_);
   ::std::swap(d1.cmp_family_id_, d2.cmp_family_id_);
   ::std::swap(d1.tfr_family_id_, d2.tfr_family_id_);
   ::std::swap(d1.extensions_, d2.extensions_);
+  ::std::swap(d1.compute_timeline_, d2.compute_timeline_);
+  ::std::swap(d1.transfer_timeline_, d2.transfer_timeline_);
+  ::std::swap(d1.heap_tracked_, d2.heap_tracked_);
+  ::std::swap(d1.alloc_policy_, d2.alloc_policy_);
+  ::std::swap(d1.fallback_count_, d2.fallback_count_);
+  ::std::swap(d1.use_tick_, d2.use_tick_);
+  ::std::swap(d1.evictables_, d2.evictables_);
+  ::std::swap(d1.evicting_, d2.evicting_);
+  ::std::swap(d1.memory_budget_, d2.memory_budget_);
+  ::std::swap(d1.subgroup_, d2.subgroup_);
+  ::std::swap(d1.features_, d2.features_);
 }
 
 vk::PhysicalDeviceProperties Device::properties() const {
@@ -165,9 +457,30 @@ vk::MemoryPropertyFlags Device::memoryProperties(uint32_t id) const {
   return phy_device_.getMemoryProperties().memoryTypes[id].propertyFlags;
 }
 
+vk::FormatProperties Device::formatProperties(vk::Format format) const {
+  return phy_device_.getFormatProperties(format);
+}
+
+::std::vector<::std::string> Device::missingCapabilities(const ::std::vector<uint32_t> &capabilities) const {
+  auto r = ::std::vector<::std::string>{};
+  for (auto capability : capabilities) {
+    auto it = ::std::find_if(capability_needs.begin(), capability_needs.end(), [&](const CapabilityNeed &need) {
+      return need.capability == capability;
+    });
+    if (it != capability_needs.end() && !it->available(features_, subgroup_)) {
+      r.emplace_back(it->name);
+    }
+  }
+  return r;
+}
+
 uint32_t Device::selectMemory(vk::Buffer buffer, vk::MemoryPropertyFlags properties) const {
+  return selectMemory(getBufferMemoryRequirements(buffer), properties);
+}
+
+uint32_t Device::selectMemory(const vk::MemoryRequirements &mem_requirements,
+                              vk::MemoryPropertyFlags properties) const {
   auto mem_properties = phy_device_.getMemoryProperties();
-  auto mem_requirements = getBufferMemoryRequirements(buffer);
   for (uint32_t i = 0; i < mem_properties.memoryTypeCount; ++i) {
     if ((1u << i) & mem_requirements.memoryTypeBits
         && (properties & mem_properties.memoryTypes[i].propertyFlags) == properties) {
@@ -204,6 +517,19 @@ vk::Pipeline Device::createPipeline(vk::PipelineLayout pipeline_layout,
   return result.value;
 }
 
+::std::vector<vk::Pipeline> Device::createPipelines(vk::PipelineCache pipeline_cache,
+                                                    const ::std::vector<vk::ComputePipelineCreateInfo> &infos) {
+  auto result = createComputePipelines(pipeline_cache, infos);
+  if (result.result != vk::Result::eSuccess) {
+    for (auto pipeline : result.value) {
+      destroyPipeline(pipeline);
+    }
+    ERROR("create compute pipelines failed");
+    throw ::std::runtime_error("create compute pipelines failed");
+  }
+  return result.value;
+}
+
 vk::CommandBuffer Device::releaseComputeCmdBuffer() {
   auto new_buffer = allocCmdBuffer(*this, compute_cmd_pool_);
   ::std::swap(new_buffer, compute_cmd_buffer_);
@@ -213,28 +539,203 @@ vk::CommandBuffer Device::releaseComputeCmdBuffer() {
   return new_buffer;
 }
 
+vk::CommandBuffer Device::nextTransferCmdBuffer() {
+  auto &slot = transfer_ring_[transfer_next_];
+  wait(slot.done);
+  return slot.cmd_buffer;
+}
+
+SyncPoint Device::submitTransfer(vk::CommandBuffer cmd_buffer, const ::std::vector<SyncPoint> &waits) {
+  auto &slot = transfer_ring_[transfer_next_];
+  VUML_ASSERT(cmd_buffer == slot.cmd_buffer && "submit the command buffer of nextTransferCmdBuffer()");
+  slot.done = submit(QueueKind::eTransfer, cmd_buffer, waits);
+  transfer_next_ = (transfer_next_ + 1) % transfer_ring_.size();
+  return slot.done;
+}
+
+SyncPoint Device::submit(QueueKind queue, vk::CommandBuffer cmd_buffer, const ::std::vector<SyncPoint> &waits) {
+  auto vk_queue = queue == QueueKind::eCompute ? computeQueue() : transferQueue();
+  if (!hasTimelineSemaphore()) {
+    vk_queue.submit(vk::SubmitInfo(0, nullptr, nullptr, 1, &cmd_buffer), nullptr);
+    vk_queue.waitIdle();
+    return {};
+  }
+
+  // one wait per semaphore on the highest value, skipping what is already reached
+  auto wait_semaphores = ::std::vector<vk::Semaphore>{};
+  auto wait_values = ::std::vector<uint64_t>{};
+  for (const auto &point : waits) {
+    if (reached(point)) { continue; }
+    auto it = ::std::find(wait_semaphores.begin(), wait_semaphores.end(), point.semaphore);
+    if (it == wait_semaphores.end()) {
+      wait_semaphores.push_back(point.semaphore);
+      wait_values.push_back(point.value);
+    } else {
+      auto &value = wait_values[static_cast<::std::size_t>(it - wait_semaphores.begin())];
+      value = ::std::max(value, point.value);
+    }
+  }
+  auto wait_stages = ::std::vector<vk::PipelineStageFlags>(wait_semaphores.size(),
+                                                           vk::PipelineStageFlagBits::eAllCommands);
+
+  auto &t = timeline(queue);
+  auto signal_value = t.value + 1;
+  auto timeline_info = vk::TimelineSemaphoreSubmitInfo(static_cast<uint32_t>(wait_values.size()),
+                                                       wait_values.data(),
+                                                       1,
+                                                       &signal_value);
+  auto submit_info = vk::SubmitInfo(static_cast<uint32_t>(wait_semaphores.size()),
+                                    wait_semaphores.data(),
+                                    wait_stages.data(),
+                                    1,
+                                    &cmd_buffer,
+                                    1,
+                                    &t.semaphore);
+  submit_info.pNext = &timeline_info;
+  vk_queue.submit(submit_info, nullptr);
+  t.value = signal_value;
+  return {t.semaphore, signal_value};
+}
+
+SyncPoint Device::lastSubmit(QueueKind queue) const {
+  const auto &t = queue == QueueKind::eCompute ? compute_timeline_ : transfer_timeline_;
+  return {t.semaphore, t.value};
+}
+
+bool Device::reached(const SyncPoint &point) {
+  if (!point) { return true; }
+  auto &t = timeline(point.semaphore);
+  if (point.value <= t.completed) { return true; }
+  t.completed = getSemaphoreCounterValue(point.semaphore);
+  return point.value <= t.completed;
+}
+
+void Device::wait(const SyncPoint &point) {
+  if (reached(point)) { return; }
+  auto info = vk::SemaphoreWaitInfo(vk::SemaphoreWaitFlags(), 1, &point.semaphore, &point.value);
+  if (waitSemaphores(info, ::std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess) {
+    ERROR("wait timeline semaphore failed");
+    throw ::std::runtime_error("wait timeline semaphore failed");
+  }
+  auto &t = timeline(point.semaphore);
+  t.completed = ::std::max(t.completed, point.value);
+}
+
+uint32_t Device::heapIndex(uint32_t memory_id) const {
+  return phy_device_.getMemoryProperties().memoryTypes[memory_id].heapIndex;
+}
+
+HeapBudget Device::heapBudget(uint32_t heap) const {
+  VUML_ASSERT(heap < VK_MAX_MEMORY_HEAPS);
+  auto r = HeapBudget{};
+  r.tracked = heap_tracked_[heap];
+  if (memory_budget_) {
+    auto props = phy_device_.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2,
+                                                  vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+    const auto &budget = props.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+    r.size = props.get<vk::PhysicalDeviceMemoryProperties2>().memoryProperties.memoryHeaps[heap].size;
+    r.budget = budget.heapBudget[heap];
+    r.usage = budget.heapUsage[heap];
+  } else {
+    r.size = phy_device_.getMemoryProperties().memoryHeaps[heap].size;
+    r.budget = r.size;
+    r.usage = r.tracked;
+  }
+  return r;
+}
+
+::std::vector<HeapBudget> Device::memoryBudget() const {
+  auto r = ::std::vector<HeapBudget>{};
+  auto n = phy_device_.getMemoryProperties().memoryHeapCount;
+  for (uint32_t i = 0; i < n; ++i) {
+    r.push_back(heapBudget(i));
+  }
+  return r;
+}
+
+void Device::trackAlloc(uint32_t memory_id, vk::DeviceSize size) {
+  heap_tracked_[heapIndex(memory_id)] += size;
+}
+
+void Device::trackFree(uint32_t memory_id, vk::DeviceSize size) {
+  auto &tracked = heap_tracked_[heapIndex(memory_id)];
+  VUML_ASSERT(tracked >= size);
+  tracked -= size;
+}
+
+void Device::registerEvictable(Evictable *evictable) {
+  if (::std::find(evictables_.begin(), evictables_.end(), evictable) == evictables_.end()) {
+    evictables_.push_back(evictable);
+  }
+}
+
+void Device::unregisterEvictable(Evictable *evictable) {
+  evictables_.erase(::std::remove(evictables_.begin(), evictables_.end(), evictable), evictables_.end());
+}
+
+vk::DeviceSize Device::evict(uint32_t heap, vk::DeviceSize bytes) {
+  // evicting allocates host memory, which must not evict in turn
+  if (evicting_) { return 0; }
+  evicting_ = true;
+  auto candidates = ::std::vector<Evictable *>{};
+  for (auto *e : evictables_) {
+    if (e->resident() && e->heap() == heap) { candidates.push_back(e); }
+  }
+  ::std::sort(candidates.begin(), candidates.end(), [](const Evictable *l, const Evictable *r) {
+    return l->lastUse() < r->lastUse();
+  });
+  vk::DeviceSize released = 0;
+  for (auto *e : candidates) {
+    if (released >= bytes) { break; }
+    try {
+      released += e->evict();
+    } catch (vk::Error &err) {
+      WARN("eviction failed: %s", err.what());
+      break;
+    }
+  }
+  evicting_ = false;
+  if (released > 0) {
+    WARN("evicted %llu bytes of heap %u to host memory", static_cast<unsigned long long>(released), heap);
+  }
+  return released;
+}
+
 Device::Device(Instance &instance,
                vk::PhysicalDevice phy_device,
                const ::std::vector<vk::QueueFamilyProperties> &families,
-               const ::std::vector<const char *> &extensions)
+               const ::std::vector<const char *> &extensions,
+               const DeviceFeatures &features)
     : Device(instance,
              phy_device,
              getFamilyID(families, vk::QueueFlagBits::eCompute),
              getFamilyID(families, vk::QueueFlagBits::eTransfer),
-             extensions) {
+             extensions,
+             features) {
 }
 
 Device::Device(Instance &instance,
                vk::PhysicalDevice phy_device,
                uint32_t cmp_family_id,
                uint32_t tfr_family_id,
-               const ::std::vector<const char *> &extensions)
-    : vk::Device(createDevice(phy_device, cmp_family_id, tfr_family_id, extensions)),
+               const ::std::vector<const char *> &extensions,
+               const DeviceFeatures &features)
+    : vk::Device(createDevice(phy_device,
+                              cmp_family_id,
+                              tfr_family_id,
+                              extensions,
+                              isVulkan12(instance, phy_device),
+                              supportsTimeline(instance, phy_device),
+                              subgroupSizeControl(instance, phy_device),
+                              features)),
       instance_(instance),
       phy_device_(phy_device),
       cmp_family_id_(cmp_family_id),
       tfr_family_id_(tfr_family_id),
-      extensions_(extensions) {
+      extensions_(extensions),
+      memory_budget_(memoryBudget(instance, phy_device)),
+      subgroup_(querySubgroup(instance, phy_device)),
+      features_(features) {
   try {
     compute_cmd_pool_ = createCommandPool({vk::CommandPoolCreateFlagBits::eResetCommandBuffer, cmp_family_id_});
     compute_cmd_buffer_ = allocCmdBuffer(*this, compute_cmd_pool_);
@@ -245,6 +746,16 @@ Device::Device(Instance &instance,
       transfer_cmd_pool_ = createCommandPool({vk::CommandPoolCreateFlagBits::eResetCommandBuffer, tfr_family_id_});
       transfer_cmd_buffer_ = allocCmdBuffer(*this, transfer_cmd_pool_);
     }
+    auto ring = allocateCommandBuffers({transfer_cmd_pool_, vk::CommandBufferLevel::ePrimary, transfer_ring_size});
+    for (auto cmd_buffer : ring) {
+      transfer_ring_.push_back({cmd_buffer, {}});
+    }
+    if (supportsTimeline(instance, phy_device)) {
+      compute_timeline_.semaphore = createTimeline(*this);
+      transfer_timeline_.semaphore = createTimeline(*this);
+    } else {
+      WARN("timeline semaphores are not supported, every submission waits for the queue to be idle");
+    }
   } catch (vk::Error &) {
     release();
     throw;
@@ -253,6 +764,12 @@ Device::Device(Instance &instance,
 
 void Device::release() {
   if (static_cast<vk::Device &>(*this)) {
+    vk::Device::waitIdle();
+    destroySemaphore(compute_timeline_.semaphore);
+    destroySemaphore(transfer_timeline_.semaphore);
+    for (const auto &slot : transfer_ring_) {
+      freeCommandBuffers(transfer_cmd_pool_, slot.cmd_buffer);
+    }
     if (tfr_family_id_ != cmp_family_id_) {
       freeCommandBuffers(transfer_cmd_pool_, transfer_cmd_buffer_);
       destroyCommandPool(transfer_cmd_pool_);
@@ -263,6 +780,16 @@ void Device::release() {
   }
 }
 
+Device::Timeline &Device::timeline(QueueKind queue) {
+  return queue == QueueKind::eCompute ? compute_timeline_ : transfer_timeline_;
+}
+
+Device::Timeline &Device::timeline(vk::Semaphore semaphore) {
+  VUML_ASSERT((semaphore == compute_timeline_.semaphore || semaphore == transfer_timeline_.semaphore)
+                  && "the semaphore does not belong to this device");
+  return semaphore == compute_timeline_.semaphore ? compute_timeline_ : transfer_timeline_;
+}
+
 } // namespace v1
 
 } // namespace vuml
\ No newline at end of file
@@ -0,0 +1,343 @@
+//
+// Created by Homin Su on 2023/7/17.
+//
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "vuml/array.h"
+#include "vuml/device.h"
+#include "vuml/logger.h"
+#include "vuml/non_copyable.h"
+#include "vuml/thread_pool.h"
+#include "vuml/utils.h"
+#include "vuml/vuml.h"
+
+#if !VUML_WINDOWS
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace vuml::array {
+
+namespace {
+
+// O_DIRECT wants the memory, the file offset and the length aligned to the logical block size, a page covers them all
+constexpr ::std::size_t direct_alignment = 4096;
+constexpr ::std::size_t chunk_bytes = 8 << 20;
+constexpr ::std::size_t max_slots = 4;
+
+using UploadStaging = HostArray<uint8_t, AllocDevice<properties::HostCoherent>>;
+using DownloadStaging = HostArray<uint8_t, AllocDevice<properties::HostCached>>;
+
+bool is_aligned(uint64_t value) { return value % direct_alignment == 0; }
+bool is_aligned(const void *p) { return is_aligned(reinterpret_cast<uintptr_t>(p)); }
+
+uint64_t round_up(uint64_t value, uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+/**
+ * @brief a file opened twice: with O_DIRECT for the aligned transfers, when the file system supports it, and through
+ * the page cache for the others. Reads and writes are positional, so pool threads share it.
+ */
+class File : NonCopyable {
+ private:
+  ::std::string path_;
+  int fd_ = -1;
+  int direct_fd_ = -1;
+
+ public:
+  File(const char *path, bool write) : path_(path) {
+#if VUML_WINDOWS
+    (void) write;
+    ERROR("file transfers need POSIX I/O");
+    throw ::std::runtime_error("file transfers need POSIX I/O");
+#else
+    auto flags = (write ? O_WRONLY | O_CREAT : O_RDONLY) | O_CLOEXEC;
+    fd_ = ::open(path, flags, 0644);
+    if (fd_ == -1) {
+      SYSERR("open %s failed", path);
+      throw ::std::runtime_error(::std::string("open ") + path + " failed");
+    }
+#ifdef O_DIRECT
+    // tmpfs and a few others refuse it, the page cache is used then
+    direct_fd_ = ::open(path, flags | O_DIRECT, 0644);
+    if (direct_fd_ == -1) {
+      DEBUG("%s cannot be opened with O_DIRECT", path);
+    }
+#endif
+#endif
+  }
+
+  ~File() noexcept {
+#if !VUML_WINDOWS
+    if (fd_ != -1) { ::close(fd_); }
+    if (direct_fd_ != -1) { ::close(direct_fd_); }
+#endif
+  }
+
+  /**
+   * @return the bytes read, less than size only at the end of the file
+   */
+  ::std::size_t read(void *dst, ::std::size_t size, uint64_t offset) const {
+    ::std::size_t done = 0;
+#if !VUML_WINDOWS
+    auto fd = pick(dst, size, offset);
+    while (done < size) {
+      auto n = ::pread(fd, static_cast<char *>(dst) + done, size - done, static_cast<off_t>(offset + done));
+      if (n == 0) { break; }
+      if (n < 0) {
+        if (errno == EINTR) { continue; }
+        SYSERR("read %s failed", path_.c_str());
+        throw ::std::runtime_error("read " + path_ + " failed");
+      }
+      done += static_cast<::std::size_t>(n);
+      // a short direct read leaves the rest unaligned
+      fd = pick(static_cast<char *>(dst) + done, size - done, offset + done);
+    }
+#endif
+    return done;
+  }
+
+  void write(const void *src, ::std::size_t size, uint64_t offset) const {
+#if !VUML_WINDOWS
+    ::std::size_t done = 0;
+    while (done < size) {
+      auto fd = pick(static_cast<const char *>(src) + done, size - done, offset + done);
+      auto n = ::pwrite(fd, static_cast<const char *>(src) + done, size - done, static_cast<off_t>(offset + done));
+      if (n < 0) {
+        if (errno == EINTR) { continue; }
+        SYSERR("write %s failed", path_.c_str());
+        throw ::std::runtime_error("write " + path_ + " failed");
+      }
+      done += static_cast<::std::size_t>(n);
+    }
+#endif
+  }
+
+ private:
+  [[nodiscard]] int pick(const void *p, ::std::size_t size, uint64_t offset) const {
+    return direct_fd_ != -1 && is_aligned(p) && is_aligned(size) && is_aligned(offset) ? direct_fd_ : fd_;
+  }
+};
+
+vk::CommandBuffer record_copy(vk::CommandBuffer cmd_buffer,
+                              vk::Buffer src,
+                              vk::Buffer dst,
+                              const vk::BufferCopy &region,
+                              bool host_reads = false) {
+  cmd_buffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+  cmd_buffer.copyBuffer(src, dst, region);
+  if (host_reads) {
+    host_read_barrier(cmd_buffer, dst, region.dstOffset, region.size);
+  }
+  cmd_buffer.end();
+  return cmd_buffer;
+}
+
+/**
+ * @brief run the I/O on the pool, or right away on a pool thread: a worker blocked on tasks queued behind its own would
+ * wait for them forever, as in parallel::for_ranges()
+ */
+template<typename F>
+::std::future<::std::invoke_result_t<F>> run_io(F &&f) {
+  if (!ThreadPool::onWorker()) {
+    return ThreadPool::global().submit(::std::forward<F>(f));
+  }
+  auto task = ::std::packaged_task<::std::invoke_result_t<F>()>(::std::forward<F>(f));
+  auto future = task.get_future();
+  task();
+  return future;
+}
+
+template<typename F>
+void wait_all(::std::vector<::std::future<F>> &futures) noexcept {
+  for (auto &f : futures) {
+    if (f.valid()) { f.wait(); }
+  }
+}
+
+} // namespace
+
+void read_file(const char *path, uint64_t offset, ::std::size_t size_bytes, void *dst) {
+  auto file = File(path, false);
+  auto reads = ::std::vector<::std::future<::std::size_t>>{};
+  for (::std::size_t done = 0; done < size_bytes; done += chunk_bytes) {
+    auto n = ::std::min(chunk_bytes, size_bytes - done);
+    reads.push_back(run_io([&file, p = static_cast<char *>(dst) + done, n, at = offset + done] {
+      return file.read(p, n, at);
+    }));
+  }
+  ::std::size_t total = 0;
+  try {
+    for (auto &read : reads) { total += read.get(); }
+  } catch (::std::exception &) {
+    wait_all(reads);
+    throw;
+  }
+  if (total != size_bytes) {
+    ERROR("%s ends before %zu bytes from %llu", path, size_bytes, static_cast<unsigned long long>(offset));
+    throw ::std::runtime_error(::std::string(path) + " is too short");
+  }
+}
+
+void write_file(const char *path, uint64_t offset, ::std::size_t size_bytes, const void *src) {
+  auto file = File(path, true);
+  auto writes = ::std::vector<::std::future<void>>{};
+  for (::std::size_t done = 0; done < size_bytes; done += chunk_bytes) {
+    auto n = ::std::min(chunk_bytes, size_bytes - done);
+    writes.push_back(run_io([&file, p = static_cast<const char *>(src) + done, n, at = offset + done] {
+      file.write(p, n, at);
+    }));
+  }
+  try {
+    for (auto &write : writes) { write.get(); }
+  } catch (::std::exception &) {
+    wait_all(writes);
+    throw;
+  }
+}
+
+void read_file(Device &device,
+               const char *path,
+               uint64_t offset,
+               ::std::size_t size_bytes,
+               vk::Buffer dst,
+               Hazards &dst_hazards,
+               ::std::size_t dst_offset) {
+  if (size_bytes == 0) { return; }
+  auto file = File(path, false);
+
+  // read whole aligned blocks, the copies skip what is outside [offset, end)
+  auto begin = offset - offset % direct_alignment;
+  auto end = offset + size_bytes;
+  auto chunk = static_cast<::std::size_t>(::std::min<uint64_t>(chunk_bytes, round_up(end - begin, direct_alignment)));
+  auto chunks = static_cast<::std::size_t>((end - begin + chunk - 1) / chunk);
+  auto slots = ::std::min(max_slots, chunks);
+
+  auto staging = ::std::vector<::std::unique_ptr<UploadStaging>>{};
+  auto data = ::std::vector<uint8_t *>{};
+  for (::std::size_t s = 0; s < slots; ++s) {
+    staging.push_back(::std::make_unique<UploadStaging>(device, chunk));
+    data.push_back(staging.back()->data());
+  }
+  auto cmd_buffers = device.allocateCommandBuffers(
+      {device.transferCmdPool(), vk::CommandBufferLevel::ePrimary, static_cast<uint32_t>(slots)}
+  );
+  auto reads = ::std::vector<::std::future<::std::size_t>>(slots);
+  auto copies = ::std::vector<SyncPoint>(slots);
+  // every copy waits for the accesses before the transfer, a semaphore wait only covers its own batch
+  auto waits = ::std::vector<SyncPoint>{};
+  dst_hazards.writeDependencies(waits);
+
+  auto finish = [&] {
+    wait_all(reads);
+    for (const auto &copy : copies) { device.wait(copy); }
+    device.freeCommandBuffers(device.transferCmdPool(), cmd_buffers);
+  };
+
+  try {
+    ::std::size_t issued = 0;
+    for (::std::size_t c = 0; c < chunks; ++c) {
+      // keep a read in flight on every slot, a slot is reused once its copy is done
+      for (; issued < chunks && issued < c + slots; ++issued) {
+        auto s = issued % slots;
+        device.wait(copies[s]);
+        auto at = begin + issued * chunk;
+        reads[s] = run_io([&file, p = data[s], chunk, at] { return file.read(p, chunk, at); });
+      }
+
+      auto s = c % slots;
+      auto got = reads[s].get();
+      auto at = begin + c * chunk;
+      auto chunk_end = ::std::min<uint64_t>(at + chunk, end);
+      if (at + got < chunk_end) {
+        ERROR("%s ends before %zu bytes from %llu", path, size_bytes, static_cast<unsigned long long>(offset));
+        throw ::std::runtime_error(::std::string(path) + " is too short");
+      }
+      auto from = ::std::max<uint64_t>(at, offset);
+      auto region = vk::BufferCopy(from - at, dst_offset + (from - offset), chunk_end - from);
+      copies[s] = device.submit(QueueKind::eTransfer, record_copy(cmd_buffers[s], *staging[s], dst, region), waits);
+      dst_hazards.write(copies[s]);
+    }
+  } catch (::std::exception &) {
+    finish();
+    throw;
+  }
+  finish();
+}
+
+void write_file(Device &device,
+                const char *path,
+                uint64_t offset,
+                ::std::size_t size_bytes,
+                vk::Buffer src,
+                Hazards &src_hazards,
+                ::std::size_t src_offset) {
+  if (size_bytes == 0) { return; }
+  auto file = File(path, true);
+
+  auto chunk = ::std::min(chunk_bytes, static_cast<::std::size_t>(round_up(size_bytes, direct_alignment)));
+  auto chunks = (size_bytes + chunk - 1) / chunk;
+  auto slots = ::std::min(max_slots, chunks);
+
+  auto staging = ::std::vector<::std::unique_ptr<DownloadStaging>>{};
+  for (::std::size_t s = 0; s < slots; ++s) {
+    staging.push_back(::std::make_unique<DownloadStaging>(device, chunk));
+  }
+  auto cmd_buffers = device.allocateCommandBuffers(
+      {device.transferCmdPool(), vk::CommandBufferLevel::ePrimary, static_cast<uint32_t>(slots)}
+  );
+  auto writes = ::std::vector<::std::future<void>>(slots);
+  auto copies = ::std::vector<SyncPoint>(slots);
+
+  auto finish = [&] {
+    wait_all(writes);
+    for (const auto &copy : copies) { device.wait(copy); }
+    device.freeCommandBuffers(device.transferCmdPool(), cmd_buffers);
+  };
+
+  try {
+    ::std::size_t issued = 0;
+    for (::std::size_t c = 0; c < chunks; ++c) {
+      // copy ahead into every slot whose previous chunk is on disk
+      for (; issued < chunks && issued < c + slots; ++issued) {
+        auto s = issued % slots;
+        if (writes[s].valid()) { writes[s].get(); }
+        auto waits = ::std::vector<SyncPoint>{};
+        src_hazards.readDependencies(waits);
+        auto n = ::std::min(chunk, size_bytes - issued * chunk);
+        auto region = vk::BufferCopy(src_offset + issued * chunk, 0, n);
+        auto cmd_buffer = record_copy(cmd_buffers[s], src, *staging[s], region, true);
+        copies[s] = device.submit(QueueKind::eTransfer, cmd_buffer, waits);
+        src_hazards.read(copies[s], QueueKind::eTransfer);
+        staging[s]->hazards().write(copies[s]);
+      }
+
+      auto s = c % slots;
+      // waits for the copy and invalidates non-coherent memory
+      auto p = static_cast<const DownloadStaging &>(*staging[s]).data();
+      auto n = ::std::min(chunk, size_bytes - c * chunk);
+      writes[s] = run_io([&file, p, n, at = offset + c * chunk] { file.write(p, n, at); });
+    }
+    for (auto &write : writes) {
+      if (write.valid()) { write.get(); }
+    }
+  } catch (::std::exception &) {
+    finish();
+    throw;
+  }
+  finish();
+}
+
+} // namespace vuml::array
@@ -0,0 +1,168 @@
+//
+// Created by Homin Su on 2023/7/24.
+//
+
+#include "vuml/glsl.h"
+
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+
+#include "vuml/utils.h"
+
+#ifndef VUML_HAS_SHADERC
+#define VUML_HAS_SHADERC 0
+#endif
+
+#if VUML_HAS_SHADERC
+#include <shaderc/shaderc.hpp>
+#endif
+
+namespace vuml::glsl {
+
+namespace {
+
+struct Cache {
+  ::std::mutex mutex;
+  ::std::unordered_map<::std::string, ::std::shared_ptr<const ::std::vector<uint32_t>>> modules;
+};
+
+Cache &cache() {
+  static Cache c;
+  return c;
+}
+
+// everything the module depends on, the map hashes it
+::std::string cache_key(const ::std::string &source, const CompileOptions &options, const ::std::string &name) {
+  auto key = name + '\0' + ::std::to_string(options.vulkan_version) + (options.optimize ? "O" : "") + '\0';
+  for (const auto &[macro, value] : options.defines) {
+    key += macro + '=' + value + '\0';
+  }
+  return key + source;
+}
+
+::std::string read_file(const ::std::string &path) {
+  auto file = ::std::ifstream(path, ::std::ios::binary);
+  if (!file) {
+    ERROR("cannot open %s", path.c_str());
+    throw ::std::runtime_error("cannot open " + path);
+  }
+  return {::std::istreambuf_iterator<char>(file), ::std::istreambuf_iterator<char>()};
+}
+
+::std::filesystem::file_time_type modified_time(const ::std::string &path) {
+  auto ec = ::std::error_code{};
+  auto time = ::std::filesystem::last_write_time(path, ec);
+  // a file being replaced by an editor may be missing for a moment, it is checked again at the next poll
+  return ec ? ::std::filesystem::file_time_type::min() : time;
+}
+
+#if VUML_HAS_SHADERC
+::std::vector<uint32_t> compile_spirv(const ::std::string &source,
+                                      const CompileOptions &options,
+                                      const ::std::string &name) {
+  auto compiler = shaderc::Compiler();
+  auto opts = shaderc::CompileOptions();
+  for (const auto &[macro, value] : options.defines) {
+    opts.AddMacroDefinition(macro, value);
+  }
+  if (options.vulkan_version >= VK_API_VERSION_1_2) {
+    opts.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+    opts.SetTargetSpirv(shaderc_spirv_version_1_5);
+  } else if (options.vulkan_version >= VK_API_VERSION_1_1) {
+    opts.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_1);
+    opts.SetTargetSpirv(shaderc_spirv_version_1_3);
+  } else {
+    opts.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_0);
+  }
+  if (options.optimize) {
+    opts.SetOptimizationLevel(shaderc_optimization_level_performance);
+  }
+  auto result = compiler.CompileGlslToSpv(source, shaderc_compute_shader, name.c_str(), opts);
+  if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+    ERROR("%s does not compile:\n%s", name.c_str(), result.GetErrorMessage().c_str());
+    throw ::std::runtime_error(name + " does not compile");
+  }
+  if (result.GetNumWarnings() != 0) {
+    WARN("%s:\n%s", name.c_str(), result.GetErrorMessage().c_str());
+  }
+  return {result.cbegin(), result.cend()};
+}
+#else
+::std::vector<uint32_t> compile_spirv(const ::std::string &, const CompileOptions &, const ::std::string &name) {
+  ERROR("cannot compile %s, vuml was built without VUML_ENABLE_SHADERC", name.c_str());
+  throw ::std::runtime_error("runtime GLSL compilation needs vuml built with VUML_ENABLE_SHADERC");
+}
+#endif
+
+::std::shared_ptr<const ::std::vector<uint32_t>> compile_module(const ::std::string &source,
+                                                                const CompileOptions &options,
+                                                                const ::std::string &name) {
+  auto spirv = ::std::make_shared<const ::std::vector<uint32_t>>(compile_spirv(source, options, name));
+  validate_spirv(spirv->data(), sizeof(uint32_t) * spirv->size(), name.c_str());
+  return spirv;
+}
+
+} // namespace
+
+bool available() { return VUML_HAS_SHADERC != 0; }
+
+::std::shared_ptr<const ::std::vector<uint32_t>> compile(const ::std::string &source,
+                                                         const CompileOptions &options,
+                                                         const ::std::string &name) {
+  auto key = cache_key(source, options, name);
+  auto &c = cache();
+  {
+    auto lock = ::std::lock_guard<::std::mutex>(c.mutex);
+    auto it = c.modules.find(key);
+    if (it != c.modules.end()) {
+      return it->second;
+    }
+  }
+  // compiled without the lock, two threads may compile the same source, the first one is kept
+  auto spirv = compile_module(source, options, name);
+  auto lock = ::std::lock_guard<::std::mutex>(c.mutex);
+  return c.modules.emplace(::std::move(key), ::std::move(spirv)).first->second;
+}
+
+::std::shared_ptr<const ::std::vector<uint32_t>> compile_file(const ::std::string &path,
+                                                              const CompileOptions &options) {
+  return compile(read_file(path), options, path);
+}
+
+void clear_cache() {
+  auto &c = cache();
+  auto lock = ::std::lock_guard<::std::mutex>(c.mutex);
+  c.modules.clear();
+}
+
+ShaderWatch::ShaderWatch(::std::string path, CompileOptions options)
+    : path_(::std::move(path)), options_(::std::move(options)), modified_(modified_time(path_)) {
+  spirv_ = compile_file(path_, options_);
+}
+
+bool ShaderWatch::poll() {
+  auto modified = modified_time(path_);
+  if (modified == modified_ || modified == ::std::filesystem::file_time_type::min()) {
+    return false;
+  }
+  modified_ = modified;
+  try {
+    // not cached, every edit would stay in the cache until clear_cache()
+    auto spirv = compile_module(read_file(path_), options_, path_);
+    // saved without a change
+    if (*spirv == *spirv_) {
+      return false;
+    }
+    spirv_ = ::std::move(spirv);
+    return true;
+  } catch (::std::exception &e) {
+    WARN("keeping the previous module of %s: %s", path_.c_str(), e.what());
+    return false;
+  }
+}
+
+} // namespace vuml::glsl
@@ -0,0 +1,201 @@
+//
+// Created by Homin Su on 2023/7/21.
+//
+
+#include "vuml/image.h"
+
+#include <array>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+
+#include "vuml/logger.h"
+
+namespace vuml {
+
+BasicImage::BasicImage(Device &device,
+                       vk::ImageType type,
+                       vk::Format format,
+                       vk::Extent3D extent,
+                       vk::ImageUsageFlags flags)
+    : device_(&device), format_(format), extent_(extent) {
+  auto features = device.formatProperties(format).optimalTilingFeatures;
+  usage_ = flags | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst;
+  if (features & vk::FormatFeatureFlagBits::eStorageImage) {
+    usage_ |= vk::ImageUsageFlagBits::eStorage;
+  }
+  if (features & vk::FormatFeatureFlagBits::eSampledImage) {
+    usage_ |= vk::ImageUsageFlagBits::eSampled;
+  }
+  if (!isStorage() && !isSampled()) {
+    ERROR("format %s can neither be stored to nor sampled by a shader", vk::to_string(format).c_str());
+    throw ::std::invalid_argument("image format not usable by shaders");
+  }
+
+  // transfers and dispatches may run on different queue families
+  auto families = ::std::array<uint32_t, 2>{device.computeFamily(), device.transferFamily()};
+  auto concurrent = families[0] != families[1];
+  image_ = device.createImage(
+      {
+          {},
+          type,
+          format,
+          extent,
+          1,
+          1,
+          vk::SampleCountFlagBits::e1,
+          vk::ImageTiling::eOptimal,
+          usage_,
+          concurrent ? vk::SharingMode::eConcurrent : vk::SharingMode::eExclusive,
+          concurrent ? 2u : 0u,
+          concurrent ? families.data() : nullptr,
+          vk::ImageLayout::eUndefined
+      }
+  );
+  try {
+    auto requirements = device.getImageMemoryRequirements(image_);
+    mem_id_ = device.selectMemory(requirements, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    if (mem_id_ == -1U) {
+      WARN("no device local memory for an image, using any memory");
+      mem_id_ = device.selectMemory(requirements, {});
+    }
+    mem_ = device.allocateMemory({requirements.size, mem_id_});
+    mem_size_ = requirements.size;
+    device.trackAlloc(mem_id_, mem_size_);
+    device.bindImageMemory(image_, mem_, 0);
+    view_ = device.createImageView(
+        {
+            {},
+            image_,
+            type == vk::ImageType::e3D ? vk::ImageViewType::e3D : vk::ImageViewType::e2D,
+            format,
+            {},
+            vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)
+        }
+    );
+    if (isSampled()) {
+      auto desc = SamplerDesc{};
+      if (!(features & vk::FormatFeatureFlagBits::eSampledImageFilterLinear)) {
+        desc.filter = vk::Filter::eNearest;
+      }
+      sampler_ = create_sampler(desc);
+    }
+    array::init_image_layout(device, image_, hazards_);
+  } catch (::std::exception &) {
+    release();
+    throw;
+  }
+}
+
+BasicImage::~BasicImage() noexcept { release(); }
+
+BasicImage::BasicImage(BasicImage &&other) noexcept
+    : device_(other.device_), image_(other.image_), mem_(other.mem_), view_(other.view_), sampler_(other.sampler_),
+      format_(other.format_), extent_(other.extent_), usage_(other.usage_), mem_id_(other.mem_id_),
+      mem_size_(other.mem_size_), hazards_(other.hazards_), generation_(other.generation_) {
+  other.detach();
+}
+
+BasicImage &BasicImage::operator=(BasicImage &&other) noexcept {
+  release();
+  device_ = other.device_;
+  image_ = other.image_;
+  mem_ = other.mem_;
+  view_ = other.view_;
+  sampler_ = other.sampler_;
+  format_ = other.format_;
+  extent_ = other.extent_;
+  usage_ = other.usage_;
+  mem_id_ = other.mem_id_;
+  mem_size_ = other.mem_size_;
+  hazards_ = other.hazards_;
+  generation_ = other.generation_;
+  other.detach();
+  return *this;
+}
+
+void BasicImage::setSampler(const SamplerDesc &desc) {
+  if (!isSampled()) {
+    ERROR("format %s cannot be sampled", vk::to_string(format_).c_str());
+    throw ::std::logic_error("the image cannot be sampled");
+  }
+  auto features = device_->formatProperties(format_).optimalTilingFeatures;
+  if (desc.filter == vk::Filter::eLinear && !(features & vk::FormatFeatureFlagBits::eSampledImageFilterLinear)) {
+    ERROR("format %s cannot be filtered linearly", vk::to_string(format_).c_str());
+    throw ::std::invalid_argument("linear filtering not supported by the image format");
+  }
+  auto sampler = create_sampler(desc);
+  // the sampler may be in use by a pending dispatch
+  device_->wait(hazards_.last_write);
+  for (const auto &read : hazards_.last_reads) {
+    device_->wait(read);
+  }
+  device_->destroySampler(sampler_);
+  sampler_ = sampler;
+  generation_ = array::details::next_generation();
+}
+
+vk::DescriptorImageInfo BasicImage::descriptorInfo(vk::DescriptorType type) const {
+  auto sampler = type == vk::DescriptorType::eCombinedImageSampler ? sampler_ : vk::Sampler{};
+  return {sampler, view_, vk::ImageLayout::eGeneral};
+}
+
+void BasicImage::release() noexcept {
+  if (!image_) {
+    return;
+  }
+  // the image may still be used by a pending submission
+  device_->wait(hazards_.last_write);
+  for (const auto &read : hazards_.last_reads) {
+    device_->wait(read);
+  }
+  device_->destroySampler(sampler_);
+  device_->destroyImageView(view_);
+  device_->destroyImage(image_);
+  if (mem_) {
+    device_->trackFree(mem_id_, mem_size_);
+    device_->freeMemory(mem_);
+  }
+  detach();
+}
+
+// the handles now belong to another image, or are gone
+void BasicImage::detach() noexcept {
+  image_ = nullptr;
+  mem_ = nullptr;
+  view_ = nullptr;
+  sampler_ = nullptr;
+  hazards_ = {};
+}
+
+vk::Sampler BasicImage::create_sampler(const SamplerDesc &desc) const {
+  // unnormalized coordinates only go with clamping and a single level
+  if (!desc.normalized && desc.address_mode != vk::SamplerAddressMode::eClampToEdge
+      && desc.address_mode != vk::SamplerAddressMode::eClampToBorder) {
+    ERROR("unnormalized coordinates need clamp to edge or border addressing");
+    throw ::std::invalid_argument("unnormalized coordinates need clamp to edge or border addressing");
+  }
+  auto address_mode = desc.address_mode;
+  return device_->createSampler(
+      {
+          {},
+          desc.filter,
+          desc.filter,
+          vk::SamplerMipmapMode::eNearest,
+          address_mode,
+          address_mode,
+          address_mode,
+          0.0f,
+          VK_FALSE,
+          1.0f,
+          VK_FALSE,
+          vk::CompareOp::eNever,
+          0.0f,
+          0.0f,
+          vk::BorderColor::eFloatTransparentBlack,
+          desc.normalized ? VK_FALSE : VK_TRUE
+      }
+  );
+}
+
+} // namespace vuml
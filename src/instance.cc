@@ -4,7 +4,11 @@
 
 #include "vuml/instance.h"
 
+#include <algorithm>
 #include <array>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
 #include <type_traits>
 #include <utility>
 
@@ -85,7 +89,8 @@ inline namespace v1 {
 Instance::Instance(const ::std::vector<const char *> &layers,
                    const ::std::vector<const char *> &extensions,
                    const vk::ApplicationInfo &info)
-    : instance_(createInstance(filter_layers(layers), filter_extensions(extensions), info)) {
+    : instance_(createInstance(filter_layers(layers), filter_extensions(extensions), info)),
+      api_version_(info.apiVersion) {
 }
 
 Instance::~Instance() noexcept {
@@ -93,12 +98,13 @@ Instance::~Instance() noexcept {
 }
 
 Instance::Instance(Instance &&other) noexcept
-    : instance_(other.instance_) {
+    : instance_(other.instance_), api_version_(other.api_version_) {
   other.instance_ = nullptr;
 }
 
 Instance &Instance::operator=(Instance &&other) noexcept {
   ::std::swap(instance_, other.instance_);
+  ::std::swap(api_version_, other.api_version_);
   return *this;
 }
 
@@ -117,6 +123,92 @@ Instance &Instance::operator=(Instance &&other) noexcept {
   return r;
 }
 
+bool PhysicalDeviceInfo::hasExtension(const char *name) const {
+  return contains(name, extensions, [](const auto &property) { return property.extensionName.data(); });
+}
+
+::std::vector<PhysicalDeviceInfo> Instance::physicalDevices() const {
+  auto phy_devices = instance_.enumeratePhysicalDevices();
+  auto r = ::std::vector<PhysicalDeviceInfo>{};
+  r.reserve(phy_devices.size());
+  for (uint32_t i = 0; i < phy_devices.size(); ++i) {
+    auto phy = phy_devices[i];
+    auto info = PhysicalDeviceInfo{};
+    info.device = phy;
+    info.index = i;
+    info.properties = phy.getProperties();
+
+    auto memory = phy.getMemoryProperties();
+    for (uint32_t h = 0; h < memory.memoryHeapCount; ++h) {
+      if (memory.memoryHeaps[h].flags & vk::MemoryHeapFlagBits::eDeviceLocal) {
+        info.device_local_memory = ::std::max(info.device_local_memory, memory.memoryHeaps[h].size);
+      }
+    }
+
+    for (const auto &family : phy.getQueueFamilyProperties()) {
+      if (family.queueFlags & vk::QueueFlagBits::eCompute) {
+        info.compute_queues = ::std::max(info.compute_queues, family.queueCount);
+      }
+    }
+
+    if (::std::min(api_version_, info.properties.apiVersion) >= VK_API_VERSION_1_1) {
+      auto props = phy.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceSubgroupProperties>();
+      info.subgroup_size = props.get<vk::PhysicalDeviceSubgroupProperties>().subgroupSize;
+    }
+
+    info.extensions = phy.enumerateDeviceExtensionProperties();
+    r.push_back(::std::move(info));
+  }
+  return r;
+}
+
+int64_t Instance::score(const PhysicalDeviceInfo &info, const DeviceRequirements &requirements) {
+  for (const auto *extension : requirements.extensions) {
+    if (!info.hasExtension(extension)) { return -1; }
+  }
+  if (info.device_local_memory < requirements.min_device_local_memory
+      || info.compute_queues < requirements.min_compute_queues
+      || info.subgroup_size < requirements.min_subgroup_size) {
+    return -1;
+  }
+
+  const auto &types = requirements.preferred_types;
+  auto it = ::std::find(types.begin(), types.end(), info.properties.deviceType);
+  auto type_rank = static_cast<int64_t>(it == types.end() ? 0 : types.end() - it);
+  auto memory_mib = ::std::min<int64_t>(static_cast<int64_t>(info.device_local_memory >> 20), 0xffffffff);
+  auto queues = ::std::min<int64_t>(info.compute_queues, 0xff);
+  auto subgroup = ::std::min<int64_t>(info.subgroup_size, 0xff);
+  // compared in this order
+  return type_rank << 48 | memory_mib << 16 | queues << 8 | subgroup;
+}
+
+Device Instance::select(const DeviceRequirements &requirements) {
+  auto infos = physicalDevices();
+  const PhysicalDeviceInfo *best = nullptr;
+  int64_t best_score = -1;
+  for (const auto &info : infos) {
+    auto s = score(info, requirements);
+    DEBUG("device [%s] scored %lld", info.properties.deviceName.data(), static_cast<long long>(s));
+    if (s > best_score) {
+      best = &info;
+      best_score = s;
+    }
+  }
+  if (best == nullptr) {
+    ERROR("no device among %zu meets the requirements", infos.size());
+    throw ::std::runtime_error("no device meets the requirements");
+  }
+  INFO("selected device [%s]", best->properties.deviceName.data());
+  return device(*best, requirements.extensions, requirements.features);
+}
+
+Device Instance::device(const PhysicalDeviceInfo &info,
+                        const ::std::vector<const char *> &extensions,
+                        const DeviceFeatures &features) {
+  auto phy = info.device;
+  return Device(*this, phy, extensions, features);
+}
+
 void Instance::clear() noexcept {
   if (instance_) {
     instance_.destroy();
@@ -0,0 +1,69 @@
+//
+// Created by Homin Su on 2023/7/14.
+//
+
+#include "vuml/kernels.h"
+
+#include <cstdint>
+
+#include <stdexcept>
+#include <string>
+
+#include "vuml/logger.h"
+
+#ifndef VUML_EMBED_KERNELS
+#define VUML_EMBED_KERNELS 0
+#endif
+
+#if VUML_EMBED_KERNELS
+// generated by vuml_add_shaders(vuml EMBED_ONLY ...) in src/CMakeLists.txt
+#include "compact.comp.h"
+#include "convert.comp.h"
+#include "dispatch_args.comp.h"
+#endif
+
+namespace vuml::kernels {
+
+#if VUML_EMBED_KERNELS
+
+const shaders::Shader &dispatch_args() {
+  static const auto shader = shaders::Shader{
+      "dispatch_args.comp", vuml_shader_dispatch_args_comp, sizeof(vuml_shader_dispatch_args_comp)
+  };
+  return shader;
+}
+
+const shaders::Shader &compact() {
+  static const auto shader = shaders::Shader{
+      "compact.comp", vuml_shader_compact_comp, sizeof(vuml_shader_compact_comp)
+  };
+  return shader;
+}
+
+const shaders::Shader &convert() {
+  static const auto shader = shaders::Shader{
+      "convert.comp", vuml_shader_convert_comp, sizeof(vuml_shader_convert_comp)
+  };
+  return shader;
+}
+
+#else
+
+namespace {
+
+[[noreturn]] void not_embedded(const char *name) {
+  ERROR("the kernel %s is not embedded, vuml was built without VUML_EMBED_KERNELS", name);
+  throw ::std::runtime_error(::std::string("kernel not embedded in the library: ") + name);
+}
+
+} // namespace
+
+const shaders::Shader &dispatch_args() { not_embedded("dispatch_args.comp"); }
+
+const shaders::Shader &compact() { not_embedded("compact.comp"); }
+
+const shaders::Shader &convert() { not_embedded("convert.comp"); }
+
+#endif
+
+} // namespace vuml::kernels
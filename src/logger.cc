@@ -4,6 +4,17 @@
 
 #include "vuml/logger.h"
 
+#include <cstdarg>
+#include <cstdint>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <thread>
+
 #include "vuml/timestamp.h"
 
 namespace vuml::logger {
@@ -16,6 +27,230 @@ Level log_level = INFO;
 
 FILE* log_file = stdout;
 
+namespace {
+
+constexpr ::std::size_t queue_size = 1024;  // power of two
+constexpr ::std::size_t message_size = 256;
+
+static_assert((queue_size & (queue_size - 1)) == 0, "queue size must be a power of two");
+
+struct Record {
+  // queue position the slot is ready for, see Backend::push()
+  ::std::atomic<::std::size_t> sequence;
+  time_point time;
+  const char *tag;
+  char message[message_size];
+};
+
+/**
+ * @brief bounded lock-free multi-producer single-consumer queue of preformatted records, written to the log file by
+ * a background thread. Producers claim a slot with a CAS on the head and publish it through the slot sequence, a full
+ * queue drops the record instead of waiting.
+ *
+ * The backend is never destroyed, statics of any translation unit may log while they are destroyed. At exit the
+ * thread drains the queue and stops, later records are written by the caller.
+ */
+class Backend : NonCopyable {
+ private:
+  ::std::array<Record, queue_size> ring_;
+  alignas(64) ::std::atomic<::std::size_t> head_{0};
+  alignas(64) ::std::atomic<::std::size_t> tail_{0};
+  ::std::atomic<uint64_t> written_{0};
+  ::std::atomic<uint64_t> dropped_{0};
+  ::std::atomic<uint64_t> truncated_{0};
+  uint64_t reported_drops_ = 0;
+  ::std::atomic<bool> idle_{false};
+  ::std::atomic<bool> stop_{false};
+  // set once the thread is stopping, records are then written on the caller's thread
+  ::std::atomic<bool> direct_{false};
+  ::std::mutex direct_mutex_;
+  ::std::mutex mutex_;
+  ::std::condition_variable wake_;
+  ::std::condition_variable drained_;
+  ::std::thread thread_;
+
+ public:
+  Backend() {
+    for (::std::size_t i = 0; i < queue_size; ++i) {
+      ring_[i].sequence.store(i, ::std::memory_order_relaxed);
+    }
+    thread_ = ::std::thread(&Backend::loop, this);
+  }
+
+  /**
+   * @brief write what is queued and stop the thread, called at exit
+   */
+  void shutdown() {
+    if (direct_.exchange(true, ::std::memory_order_acq_rel)) {
+      return;
+    }
+    stop_.store(true, ::std::memory_order_release);
+    {
+      ::std::lock_guard<::std::mutex> lock(mutex_);
+      wake_.notify_one();
+    }
+    thread_.join();
+  }
+
+  void push(const char *tag, const char *format, va_list args) {
+    auto now = clock::now();
+    if (direct_.load(::std::memory_order_acquire)) {
+      write_direct(now, tag, format, args);
+      return;
+    }
+    auto pos = head_.load(::std::memory_order_relaxed);
+    Record *record;
+    for (;;) {
+      record = &ring_[pos & (queue_size - 1)];
+      auto seq = record->sequence.load(::std::memory_order_acquire);
+      auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1, ::std::memory_order_relaxed)) { break; }
+      } else if (diff < 0) {
+        // the consumer has not freed the slot yet, the queue is full
+        dropped_.fetch_add(1, ::std::memory_order_relaxed);
+        return;
+      } else {
+        pos = head_.load(::std::memory_order_relaxed);
+      }
+    }
+
+    record->time = now;
+    record->tag = tag;
+    auto n = vsnprintf(record->message, message_size, format, args);
+    if (n >= static_cast<int>(message_size)) {
+      truncated_.fetch_add(1, ::std::memory_order_relaxed);
+    }
+    record->sequence.store(pos + 1, ::std::memory_order_release);
+
+    // never take the lock on the caller's thread, the consumer also polls
+    if (idle_.load(::std::memory_order_relaxed)) {
+      wake_.notify_one();
+    }
+  }
+
+  /**
+   * @param timeout negative to wait as long as it takes
+   * @return false if the records were not written within timeout
+   */
+  bool flush(milliseconds timeout = milliseconds(-1)) {
+    if (direct_.load(::std::memory_order_acquire) || ::std::this_thread::get_id() == thread_.get_id()) {
+      return true;
+    }
+    auto target = head_.load(::std::memory_order_acquire);
+    auto lock = ::std::unique_lock<::std::mutex>(mutex_);
+    wake_.notify_one();
+    auto drained = [&] { return tail_.load(::std::memory_order_acquire) >= target; };
+    if (timeout < milliseconds(0)) {
+      drained_.wait(lock, drained);
+      return true;
+    }
+    return drained_.wait_for(lock, timeout, drained);
+  }
+
+  Stats stats() const {
+    return {
+        written_.load(::std::memory_order_relaxed),
+        dropped_.load(::std::memory_order_relaxed),
+        truncated_.load(::std::memory_order_relaxed),
+    };
+  }
+
+ private:
+  void loop() {
+    for (;;) {
+      if (drain() != 0) { continue; }
+      if (stop_.load(::std::memory_order_acquire)) {
+        drain();
+        return;
+      }
+      auto lock = ::std::unique_lock<::std::mutex>(mutex_);
+      idle_.store(true, ::std::memory_order_relaxed);
+      wake_.wait_for(lock, milliseconds(10), [&] { return ready() || stop_.load(::std::memory_order_acquire); });
+      idle_.store(false, ::std::memory_order_relaxed);
+    }
+  }
+
+  void write_direct(time_point time, const char *tag, const char *format, va_list args) {
+    char message[message_size];
+    if (vsnprintf(message, message_size, format, args) >= static_cast<int>(message_size)) {
+      truncated_.fetch_add(1, ::std::memory_order_relaxed);
+    }
+    char buf[64]{0};
+    clock::to_string(time, buf, sizeof(buf));
+    ::std::lock_guard<::std::mutex> lock(direct_mutex_);
+    if (fprintf(log_file, "[%s] [%s] %s\n", tag, buf, message) == -1) {
+      fprintf(stderr, "log failed");
+    }
+    fflush(log_file);
+    written_.fetch_add(1, ::std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] bool ready() const {
+    auto tail = tail_.load(::std::memory_order_relaxed);
+    return ring_[tail & (queue_size - 1)].sequence.load(::std::memory_order_acquire) == tail + 1;
+  }
+
+  ::std::size_t drain() {
+    ::std::size_t n = 0;
+    char buf[64]{0};
+    auto tail = tail_.load(::std::memory_order_relaxed);
+    for (;;) {
+      auto &record = ring_[tail & (queue_size - 1)];
+      if (record.sequence.load(::std::memory_order_acquire) != tail + 1) { break; }
+      clock::to_string(record.time, buf, sizeof(buf));
+      if (fprintf(log_file, "[%s] [%s] %s\n", record.tag, buf, record.message) == -1) {
+        fprintf(stderr, "log failed");
+      }
+      record.sequence.store(tail + queue_size, ::std::memory_order_release);
+      ++tail;
+      ++n;
+    }
+
+    auto dropped = dropped_.load(::std::memory_order_relaxed);
+    if (dropped != reported_drops_) {
+      clock::to_string(buf, sizeof(buf));
+      fprintf(log_file, "[WARN] [%s] log queue full, dropped %llu records\n",
+              buf, static_cast<unsigned long long>(dropped - reported_drops_));
+      reported_drops_ = dropped;
+    }
+
+    if (n != 0) {
+      fflush(log_file);
+      written_.fetch_add(n, ::std::memory_order_relaxed);
+      tail_.store(tail, ::std::memory_order_release);
+      ::std::lock_guard<::std::mutex> lock(mutex_);
+      drained_.notify_all();
+    }
+    return n;
+  }
+};
+
+::std::terminate_handler previous_terminate = nullptr;
+
+Backend &backend();
+
+// an uncaught exception aborts before the thread gets to the records, ERROR flushes but other levels do not
+[[noreturn]] void on_terminate() {
+  backend().flush(milliseconds(1000));
+  if (previous_terminate != nullptr) {
+    previous_terminate();
+  }
+  ::std::abort();
+}
+
+Backend &backend() {
+  static auto *b = [] {
+    auto *r = new Backend();
+    ::std::atexit([] { backend().shutdown(); });
+    previous_terminate = ::std::set_terminate(on_terminate);
+    return r;
+  }();
+  return *b;
+}
+
+} // namespace
+
 void set_log_level(Level _level) {
   VUML_ASSERT((_level >= TRACE && _level <= FATAL) && "log level out of range");
   log_level = _level;
@@ -23,6 +258,8 @@ void set_log_level(Level _level) {
 
 void set_log_file(FILE *_file) {
   VUML_ASSERT(_file != nullptr && "file pointer should not be nullptr");
+  // records already queued go to the old file
+  flush();
   log_file = _file;
 }
 
@@ -30,4 +267,19 @@ void timestamp(char *_buf, std::size_t _size) {
   clock::to_string(_buf, _size);
 }
 
+void write(const char *_tag, const char *_format, ...) {
+  va_list args;
+  va_start(args, _format);
+  backend().push(_tag, _format, args);
+  va_end(args);
+}
+
+void flush() {
+  backend().flush();
+}
+
+Stats stats() {
+  return backend().stats();
+}
+
 } // namespace vuml::logger
@@ -0,0 +1,268 @@
+//
+// Created by Homin Su on 2023/7/19.
+//
+
+#include "vuml/memcpy.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VUML_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define VUML_X86 0
+#endif
+
+// msvc emits any intrinsic, gcc and clang only inside functions built for the instruction set
+#if defined(__GNUC__) || defined(__clang__)
+#define VUML_TARGET(x) __attribute__((target(x)))
+#else
+#define VUML_TARGET(x)
+#endif
+
+namespace vuml {
+
+namespace {
+
+// below a few lines the fence and the alignment head cost more than the cache pollution
+constexpr ::std::size_t min_stream_bytes = 256;
+
+#if VUML_X86
+
+::std::size_t align_head(const void *p, ::std::size_t alignment, ::std::size_t size_bytes) {
+  auto misaligned = reinterpret_cast<uintptr_t>(p) % alignment;
+  return ::std::min(size_bytes, misaligned == 0 ? 0 : alignment - misaligned);
+}
+
+VUML_TARGET("sse4.1")
+void store_sse41(char *dst, const char *src, ::std::size_t n) {
+  auto head = align_head(dst, 16, n);
+  ::std::memcpy(dst, src, head);
+  dst += head, src += head, n -= head;
+  for (; n >= 64; n -= 64, dst += 64, src += 64) {
+    auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+    auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16));
+    auto c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 32));
+    auto d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 48));
+    _mm_stream_si128(reinterpret_cast<__m128i *>(dst), a);
+    _mm_stream_si128(reinterpret_cast<__m128i *>(dst + 16), b);
+    _mm_stream_si128(reinterpret_cast<__m128i *>(dst + 32), c);
+    _mm_stream_si128(reinterpret_cast<__m128i *>(dst + 48), d);
+  }
+  for (; n >= 16; n -= 16, dst += 16, src += 16) {
+    _mm_stream_si128(reinterpret_cast<__m128i *>(dst), _mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+  }
+  ::std::memcpy(dst, src, n);
+  _mm_sfence();
+}
+
+VUML_TARGET("avx2")
+void store_avx2(char *dst, const char *src, ::std::size_t n) {
+  auto head = align_head(dst, 32, n);
+  ::std::memcpy(dst, src, head);
+  dst += head, src += head, n -= head;
+  for (; n >= 128; n -= 128, dst += 128, src += 128) {
+    auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+    auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 32));
+    auto c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 64));
+    auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 96));
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(dst), a);
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(dst + 32), b);
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(dst + 64), c);
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(dst + 96), d);
+  }
+  for (; n >= 32; n -= 32, dst += 32, src += 32) {
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(dst), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src)));
+  }
+  ::std::memcpy(dst, src, n);
+  _mm_sfence();
+}
+
+VUML_TARGET("avx512f")
+void store_avx512(char *dst, const char *src, ::std::size_t n) {
+  auto head = align_head(dst, 64, n);
+  ::std::memcpy(dst, src, head);
+  dst += head, src += head, n -= head;
+  for (; n >= 256; n -= 256, dst += 256, src += 256) {
+    auto a = _mm512_loadu_si512(src);
+    auto b = _mm512_loadu_si512(src + 64);
+    auto c = _mm512_loadu_si512(src + 128);
+    auto d = _mm512_loadu_si512(src + 192);
+    _mm512_stream_si512(reinterpret_cast<__m512i *>(dst), a);
+    _mm512_stream_si512(reinterpret_cast<__m512i *>(dst + 64), b);
+    _mm512_stream_si512(reinterpret_cast<__m512i *>(dst + 128), c);
+    _mm512_stream_si512(reinterpret_cast<__m512i *>(dst + 192), d);
+  }
+  for (; n >= 64; n -= 64, dst += 64, src += 64) {
+    _mm512_stream_si512(reinterpret_cast<__m512i *>(dst), _mm512_loadu_si512(src));
+  }
+  ::std::memcpy(dst, src, n);
+  _mm_sfence();
+}
+
+// the streaming loads take a non-const pointer on some compilers, they do not write through it
+
+VUML_TARGET("sse4.1")
+void load_sse41(char *dst, const char *src, ::std::size_t n) {
+  auto head = align_head(src, 16, n);
+  ::std::memcpy(dst, src, head);
+  dst += head, src += head, n -= head;
+  auto p = const_cast<char *>(src);
+  for (; n >= 64; n -= 64, dst += 64, p += 64) {
+    auto a = _mm_stream_load_si128(reinterpret_cast<__m128i *>(p));
+    auto b = _mm_stream_load_si128(reinterpret_cast<__m128i *>(p + 16));
+    auto c = _mm_stream_load_si128(reinterpret_cast<__m128i *>(p + 32));
+    auto d = _mm_stream_load_si128(reinterpret_cast<__m128i *>(p + 48));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), a);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 16), b);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 32), c);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 48), d);
+  }
+  for (; n >= 16; n -= 16, dst += 16, p += 16) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_stream_load_si128(reinterpret_cast<__m128i *>(p)));
+  }
+  ::std::memcpy(dst, p, n);
+}
+
+VUML_TARGET("avx2")
+void load_avx2(char *dst, const char *src, ::std::size_t n) {
+  auto head = align_head(src, 32, n);
+  ::std::memcpy(dst, src, head);
+  dst += head, src += head, n -= head;
+  auto p = const_cast<char *>(src);
+  for (; n >= 128; n -= 128, dst += 128, p += 128) {
+    auto a = _mm256_stream_load_si256(reinterpret_cast<__m256i *>(p));
+    auto b = _mm256_stream_load_si256(reinterpret_cast<__m256i *>(p + 32));
+    auto c = _mm256_stream_load_si256(reinterpret_cast<__m256i *>(p + 64));
+    auto d = _mm256_stream_load_si256(reinterpret_cast<__m256i *>(p + 96));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), a);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 32), b);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 64), c);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 96), d);
+  }
+  for (; n >= 32; n -= 32, dst += 32, p += 32) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), _mm256_stream_load_si256(reinterpret_cast<__m256i *>(p)));
+  }
+  ::std::memcpy(dst, p, n);
+}
+
+VUML_TARGET("avx512f")
+void load_avx512(char *dst, const char *src, ::std::size_t n) {
+  auto head = align_head(src, 64, n);
+  ::std::memcpy(dst, src, head);
+  dst += head, src += head, n -= head;
+  auto p = const_cast<char *>(src);
+  for (; n >= 256; n -= 256, dst += 256, p += 256) {
+    auto a = _mm512_stream_load_si512(p);
+    auto b = _mm512_stream_load_si512(p + 64);
+    auto c = _mm512_stream_load_si512(p + 128);
+    auto d = _mm512_stream_load_si512(p + 192);
+    _mm512_storeu_si512(dst, a);
+    _mm512_storeu_si512(dst + 64, b);
+    _mm512_storeu_si512(dst + 128, c);
+    _mm512_storeu_si512(dst + 192, d);
+  }
+  for (; n >= 64; n -= 64, dst += 64, p += 64) {
+    _mm512_storeu_si512(dst, _mm512_stream_load_si512(p));
+  }
+  ::std::memcpy(dst, p, n);
+}
+
+Simd detect() {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) { return Simd::eAvx512; }
+  if (__builtin_cpu_supports("avx2")) { return Simd::eAvx2; }
+  if (__builtin_cpu_supports("sse4.1")) { return Simd::eSse41; }
+  return Simd::eNone;
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  auto max_leaf = info[0];
+  __cpuid(info, 1);
+  auto sse41 = (info[2] & (1 << 19)) != 0;
+  // the os must save the wider registers on context switches too
+  auto osxsave = (info[2] & (1 << 27)) != 0;
+  auto xcr0 = osxsave ? _xgetbv(0) : 0;
+  auto avx2 = false, avx512 = false;
+  if (max_leaf >= 7 && (xcr0 & 0x6) == 0x6) {
+    __cpuidex(info, 7, 0);
+    avx2 = (info[1] & (1 << 5)) != 0;
+    avx512 = (info[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6;
+  }
+  if (avx512) { return Simd::eAvx512; }
+  if (avx2) { return Simd::eAvx2; }
+  return sse41 ? Simd::eSse41 : Simd::eNone;
+#else
+  return Simd::eNone;
+#endif
+}
+
+#else
+
+Simd detect() { return Simd::eNone; }
+
+#endif // VUML_X86
+
+Simd clamp(Simd simd) {
+  return static_cast<int>(simd) < static_cast<int>(simd_support()) ? simd : simd_support();
+}
+
+} // namespace
+
+const char *to_string(Simd simd) {
+  switch (simd) {
+    case Simd::eNone: return "none";
+    case Simd::eSse41: return "sse4.1";
+    case Simd::eAvx2: return "avx2";
+    case Simd::eAvx512: return "avx512";
+  }
+  return "unknown";
+}
+
+Simd simd_support() {
+  static const auto simd = detect();
+  return simd;
+}
+
+void stream_store(void *dst, const void *src, ::std::size_t size_bytes, Simd simd) {
+  simd = size_bytes < min_stream_bytes ? Simd::eNone : clamp(simd);
+#if VUML_X86
+  auto d = static_cast<char *>(dst);
+  auto s = static_cast<const char *>(src);
+  switch (simd) {
+    case Simd::eAvx512: return store_avx512(d, s, size_bytes);
+    case Simd::eAvx2: return store_avx2(d, s, size_bytes);
+    case Simd::eSse41: return store_sse41(d, s, size_bytes);
+    case Simd::eNone: break;
+  }
+#else
+  (void) simd;
+#endif
+  ::std::memcpy(dst, src, size_bytes);
+}
+
+void stream_load(void *dst, const void *src, ::std::size_t size_bytes, Simd simd) {
+  simd = size_bytes < min_stream_bytes ? Simd::eNone : clamp(simd);
+#if VUML_X86
+  auto d = static_cast<char *>(dst);
+  auto s = static_cast<const char *>(src);
+  switch (simd) {
+    case Simd::eAvx512: return load_avx512(d, s, size_bytes);
+    case Simd::eAvx2: return load_avx2(d, s, size_bytes);
+    case Simd::eSse41: return load_sse41(d, s, size_bytes);
+    case Simd::eNone: break;
+  }
+#else
+  (void) simd;
+#endif
+  ::std::memcpy(dst, src, size_bytes);
+}
+
+} // namespace vuml
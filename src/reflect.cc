@@ -0,0 +1,785 @@
+//
+// Created by Homin Su on 2023/7/2.
+//
+
+#include "vuml/reflect.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "vuml/logger.h"
+
+namespace {
+
+constexpr uint32_t kMagic = 0x07230203;
+constexpr ::std::size_t kHeaderWords = 5;
+
+// opcodes
+constexpr uint32_t kOpExecutionMode = 16;
+constexpr uint32_t kOpCapability = 17;
+constexpr uint32_t kOpTypeBool = 20;
+constexpr uint32_t kOpTypeInt = 21;
+constexpr uint32_t kOpTypeFloat = 22;
+constexpr uint32_t kOpTypeVector = 23;
+constexpr uint32_t kOpTypeMatrix = 24;
+constexpr uint32_t kOpTypeImage = 25;
+constexpr uint32_t kOpTypeSampler = 26;
+constexpr uint32_t kOpTypeSampledImage = 27;
+constexpr uint32_t kOpTypeArray = 28;
+constexpr uint32_t kOpTypeRuntimeArray = 29;
+constexpr uint32_t kOpTypeStruct = 30;
+constexpr uint32_t kOpTypePointer = 32;
+constexpr uint32_t kOpConstantTrue = 41;
+constexpr uint32_t kOpConstantFalse = 42;
+constexpr uint32_t kOpConstant = 43;
+constexpr uint32_t kOpConstantComposite = 44;
+constexpr uint32_t kOpSpecConstantTrue = 48;
+constexpr uint32_t kOpSpecConstantFalse = 49;
+constexpr uint32_t kOpSpecConstant = 50;
+constexpr uint32_t kOpSpecConstantComposite = 51;
+constexpr uint32_t kOpSpecConstantOp = 52;
+constexpr uint32_t kOpVariable = 59;
+constexpr uint32_t kOpDecorate = 71;
+constexpr uint32_t kOpMemberDecorate = 72;
+constexpr uint32_t kOpExecutionModeId = 331;
+
+// operations of OpSpecConstantOp which array lengths are computed with
+constexpr uint32_t kOpCompositeExtract = 81;
+constexpr uint32_t kOpUConvert = 113;
+constexpr uint32_t kOpSConvert = 114;
+constexpr uint32_t kOpSNegate = 126;
+constexpr uint32_t kOpIAdd = 128;
+constexpr uint32_t kOpISub = 130;
+constexpr uint32_t kOpIMul = 132;
+constexpr uint32_t kOpUDiv = 134;
+constexpr uint32_t kOpSDiv = 135;
+constexpr uint32_t kOpUMod = 137;
+constexpr uint32_t kOpSRem = 138;
+constexpr uint32_t kOpSMod = 139;
+constexpr uint32_t kOpSelect = 169;
+constexpr uint32_t kOpShiftRightLogical = 194;
+constexpr uint32_t kOpShiftRightArithmetic = 195;
+constexpr uint32_t kOpShiftLeftLogical = 196;
+constexpr uint32_t kOpBitwiseOr = 197;
+constexpr uint32_t kOpBitwiseXor = 198;
+constexpr uint32_t kOpBitwiseAnd = 199;
+
+// decorations
+constexpr uint32_t kDecSpecId = 1;
+constexpr uint32_t kDecBlock = 2;
+constexpr uint32_t kDecBufferBlock = 3;
+constexpr uint32_t kDecArrayStride = 6;
+constexpr uint32_t kDecMatrixStride = 7;
+constexpr uint32_t kDecBuiltIn = 11;
+constexpr uint32_t kDecNonWritable = 24;
+constexpr uint32_t kDecNonReadable = 25;
+constexpr uint32_t kDecBinding = 33;
+constexpr uint32_t kDecDescriptorSet = 34;
+constexpr uint32_t kDecOffset = 35;
+
+constexpr uint32_t kBuiltInWorkgroupSize = 25;
+
+constexpr uint32_t kModeLocalSize = 17;
+constexpr uint32_t kModeLocalSizeId = 38;
+
+// storage classes
+constexpr uint32_t kStorageUniformConstant = 0;
+constexpr uint32_t kStorageUniform = 2;
+constexpr uint32_t kStorageWorkgroup = 4;
+constexpr uint32_t kStoragePushConstant = 9;
+constexpr uint32_t kStorageStorageBuffer = 12;
+
+constexpr uint32_t kImageDimBuffer = 5;
+
+// the universal limit of SPIR-V on the members of a struct
+constexpr uint32_t kMaxStructMembers = 16383;
+
+// words, the opcode included, of the shortest valid instruction of the opcodes the parser reads
+uint32_t minWordCount(uint32_t opcode) {
+  switch (opcode) {
+    case kOpCapability:
+    case kOpTypeBool:
+    case kOpTypeSampler:
+    case kOpTypeStruct:return 2;
+    case kOpExecutionMode:
+    case kOpExecutionModeId:
+    case kOpDecorate:
+    case kOpTypeFloat:
+    case kOpTypeSampledImage:
+    case kOpTypeRuntimeArray:
+    case kOpConstantTrue:
+    case kOpConstantFalse:
+    case kOpSpecConstantTrue:
+    case kOpSpecConstantFalse:
+    case kOpConstantComposite:
+    case kOpSpecConstantComposite:return 3;
+    case kOpMemberDecorate:
+    case kOpTypeInt:
+    case kOpTypeVector:
+    case kOpTypeMatrix:
+    case kOpTypeArray:
+    case kOpTypePointer:
+    case kOpConstant:
+    case kOpSpecConstant:
+    case kOpSpecConstantOp:
+    case kOpVariable:return 4;
+    case kOpTypeImage:return 9;
+    default:return 1;
+  }
+}
+
+struct Decoration {
+  uint32_t binding = 0;
+  uint32_t set = 0;
+  uint32_t spec_id = -1U;
+  uint32_t array_stride = 0;
+  uint32_t builtin = -1U;
+  bool has_binding = false;
+  bool block = false;
+  bool buffer_block = false;
+  bool non_writable = false;
+  bool non_readable = false;
+};
+
+struct MemberDecoration {
+  uint32_t offset = 0;
+  uint32_t matrix_stride = 0;
+  bool non_writable = false;
+  bool non_readable = false;
+};
+
+struct Type {
+  uint32_t op = 0;
+  uint32_t width = 0;       // int / float
+  bool is_signed = false;   // int
+  uint32_t element = 0;     // vector, matrix, array, pointer, sampled image
+  uint32_t count = 0;       // vector, matrix
+  uint32_t length_id = 0;   // array
+  uint32_t storage = 0;     // pointer
+  uint32_t dim = 0;         // image
+  uint32_t sampled = 0;     // image
+  ::std::vector<uint32_t> members;  // struct
+};
+
+struct Constant {
+  uint32_t type = 0;
+  uint64_t value = 0;
+  bool spec = false;
+  uint32_t op = 0;                       // OpSpecConstantOp
+  ::std::vector<uint32_t> constituents;  // composites, operands of OpSpecConstantOp
+};
+
+struct Variable {
+  uint32_t type = 0;
+  uint32_t storage = 0;
+};
+
+[[noreturn]] void fail(const ::std::string &msg) {
+  ERROR("%s", msg.c_str());
+  throw ::std::runtime_error(msg);
+}
+
+class Parser {
+ public:
+  ::std::unordered_map<uint32_t, Decoration> decorations;
+  ::std::unordered_map<uint32_t, ::std::vector<MemberDecoration>> member_decorations;
+  ::std::unordered_map<uint32_t, Type> types;
+  ::std::unordered_map<uint32_t, Constant> constants;
+  ::std::unordered_map<uint32_t, Variable> variables;
+  ::std::vector<uint32_t> capabilities;
+  ::std::array<uint32_t, 3> local_size = {1, 1, 1};
+  ::std::array<uint32_t, 3> local_size_ids = {0, 0, 0};
+
+  Parser(const uint32_t *words, ::std::size_t n) {
+    if (n < kHeaderWords || words[0] != kMagic) {
+      fail("invalid SPIR-V module: bad magic number or truncated header");
+    }
+    for (auto i = kHeaderWords; i < n;) {
+      const auto word_count = words[i] >> 16;
+      const auto opcode = words[i] & 0xffffu;
+      if (word_count == 0 || i + word_count > n) {
+        fail("invalid SPIR-V module: truncated instruction");
+      }
+      parse(opcode, words + i, word_count);
+      i += word_count;
+    }
+  }
+
+  [[nodiscard]] uint32_t sizeOf(uint32_t type_id, uint32_t stride = 0) const {
+    auto it = types.find(type_id);
+    if (it == types.end()) { return 0; }
+    const auto &t = it->second;
+    switch (t.op) {
+      case kOpTypeBool:return 4;
+      case kOpTypeInt:
+      case kOpTypeFloat:return t.width / 8;
+      case kOpTypeVector:return t.count * sizeOf(t.element);
+      case kOpTypeMatrix:return t.count * (stride != 0 ? stride : sizeOf(t.element));
+      case kOpTypeArray: {
+        auto c = constants.find(t.length_id);
+        auto length = c == constants.end() ? 0 : static_cast<uint32_t>(c->second.value);
+        auto array_stride = decoration(type_id).array_stride;
+        return length * (array_stride != 0 ? array_stride : sizeOf(t.element));
+      }
+      case kOpTypeRuntimeArray:return 0;
+      case kOpTypeStruct: {
+        uint32_t size = 0;
+        auto md = member_decorations.find(type_id);
+        for (::std::size_t m = 0; m < t.members.size(); ++m) {
+          auto member = md != member_decorations.end() && m < md->second.size()
+                        ? md->second[m] : MemberDecoration{};
+          size = ::std::max(size, member.offset + sizeOf(t.members[m], member.matrix_stride));
+        }
+        return size;
+      }
+      default:return 0;
+    }
+  }
+
+  // workgroup variables have no explicit layout, their members are counted back to back
+  [[nodiscard]] uint32_t packedSizeOf(uint32_t type_id) const {
+    const auto *t = type(type_id);
+    if (t == nullptr) { return 0; }
+    if (t->op == kOpTypeArray) {
+      auto c = constants.find(t->length_id);
+      auto length = c == constants.end() ? 0 : static_cast<uint32_t>(c->second.value);
+      return length * packedSizeOf(t->element);
+    }
+    if (t->op == kOpTypeStruct) {
+      uint32_t size = 0;
+      for (auto member : t->members) {
+        size += packedSizeOf(member);
+      }
+      return size;
+    }
+    return sizeOf(type_id);
+  }
+
+  [[nodiscard]] Decoration decoration(uint32_t id) const {
+    auto it = decorations.find(id);
+    return it == decorations.end() ? Decoration{} : it->second;
+  }
+
+  [[nodiscard]] const Type *type(uint32_t id) const {
+    auto it = types.find(id);
+    return it == types.end() ? nullptr : &it->second;
+  }
+
+ private:
+  void parse(uint32_t opcode, const uint32_t *w, uint32_t n) {
+    if (n < minWordCount(opcode)) {
+      fail("invalid SPIR-V module: opcode " + ::std::to_string(opcode) + " of " + ::std::to_string(n)
+               + " words, it takes at least " + ::std::to_string(minWordCount(opcode)));
+    }
+    switch (opcode) {
+      case kOpCapability:capabilities.push_back(w[1]);
+        break;
+      case kOpExecutionMode:
+      case kOpExecutionModeId:
+        if (n >= 6 && (w[2] == kModeLocalSize || w[2] == kModeLocalSizeId)) {
+          auto &dst = w[2] == kModeLocalSize ? local_size : local_size_ids;
+          dst = {w[3], w[4], w[5]};
+        }
+        break;
+      case kOpDecorate:decorate(decorations[w[1]], w[2], n > 3 ? w[3] : 0);
+        break;
+      case kOpMemberDecorate: {
+        if (w[2] >= kMaxStructMembers) {
+          fail("invalid SPIR-V module: decoration of struct member " + ::std::to_string(w[2]));
+        }
+        auto &members = member_decorations[w[1]];
+        if (members.size() <= w[2]) { members.resize(w[2] + 1); }
+        auto &m = members[w[2]];
+        if (w[3] == kDecOffset && n > 4) { m.offset = w[4]; }
+        if (w[3] == kDecMatrixStride && n > 4) { m.matrix_stride = w[4]; }
+        if (w[3] == kDecNonWritable) { m.non_writable = true; }
+        if (w[3] == kDecNonReadable) { m.non_readable = true; }
+        break;
+      }
+      case kOpTypeBool:
+      case kOpTypeSampler:types[w[1]].op = opcode;
+        break;
+      case kOpTypeInt:
+      case kOpTypeFloat: {
+        auto &t = types[w[1]];
+        t.op = opcode, t.width = w[2], t.is_signed = opcode == kOpTypeInt && w[3] != 0;
+        break;
+      }
+      case kOpTypeVector:
+      case kOpTypeMatrix: {
+        auto &t = types[w[1]];
+        t.op = opcode, t.element = w[2], t.count = w[3];
+        break;
+      }
+      case kOpTypeImage: {
+        auto &t = types[w[1]];
+        t.op = opcode, t.element = w[2], t.dim = w[3], t.sampled = w[7];
+        break;
+      }
+      case kOpTypeSampledImage:
+      case kOpTypeRuntimeArray: {
+        auto &t = types[w[1]];
+        t.op = opcode, t.element = w[2];
+        break;
+      }
+      case kOpTypeArray: {
+        auto &t = types[w[1]];
+        t.op = opcode, t.element = w[2], t.length_id = w[3];
+        break;
+      }
+      case kOpTypeStruct: {
+        auto &t = types[w[1]];
+        t.op = opcode, t.members.assign(w + 2, w + n);
+        break;
+      }
+      case kOpTypePointer: {
+        auto &t = types[w[1]];
+        t.op = opcode, t.storage = w[2], t.element = w[3];
+        break;
+      }
+      case kOpConstantTrue:
+      case kOpConstantFalse:
+      case kOpSpecConstantTrue:
+      case kOpSpecConstantFalse: {
+        auto &c = constants[w[2]];
+        c.type = w[1];
+        c.value = opcode == kOpConstantTrue || opcode == kOpSpecConstantTrue;
+        c.spec = opcode == kOpSpecConstantTrue || opcode == kOpSpecConstantFalse;
+        break;
+      }
+      case kOpConstant:
+      case kOpSpecConstant: {
+        auto &c = constants[w[2]];
+        c.type = w[1];
+        c.value = w[3];
+        if (n > 4) { c.value |= static_cast<uint64_t>(w[4]) << 32; }
+        c.spec = opcode == kOpSpecConstant;
+        break;
+      }
+      case kOpConstantComposite:
+      case kOpSpecConstantComposite: {
+        auto &c = constants[w[2]];
+        c.type = w[1];
+        c.spec = opcode == kOpSpecConstantComposite;
+        c.constituents.assign(w + 3, w + n);
+        break;
+      }
+      case kOpSpecConstantOp: {
+        auto &c = constants[w[2]];
+        c.type = w[1];
+        c.spec = true;
+        c.op = w[3];
+        c.constituents.assign(w + 4, w + n);
+        break;
+      }
+      case kOpVariable:variables[w[2]] = {w[1], w[3]};
+        break;
+      default:break;
+    }
+  }
+
+  static void decorate(Decoration &d, uint32_t decoration, uint32_t operand) {
+    switch (decoration) {
+      case kDecSpecId:d.spec_id = operand;
+        break;
+      case kDecBlock:d.block = true;
+        break;
+      case kDecBufferBlock:d.buffer_block = true;
+        break;
+      case kDecArrayStride:d.array_stride = operand;
+        break;
+      case kDecBuiltIn:d.builtin = operand;
+        break;
+      case kDecNonWritable:d.non_writable = true;
+        break;
+      case kDecNonReadable:d.non_readable = true;
+        break;
+      case kDecBinding:d.binding = operand, d.has_binding = true;
+        break;
+      case kDecDescriptorSet:d.set = operand;
+        break;
+      default:break;
+    }
+  }
+};
+
+vuml::reflect::Scalar scalarKind(const Type *t) {
+  if (t == nullptr) { return vuml::reflect::Scalar::eOther; }
+  switch (t->op) {
+    case kOpTypeBool:return vuml::reflect::Scalar::eBool;
+    case kOpTypeInt:return t->is_signed ? vuml::reflect::Scalar::eInt : vuml::reflect::Scalar::eUint;
+    case kOpTypeFloat:return vuml::reflect::Scalar::eFloat;
+    default:return vuml::reflect::Scalar::eOther;
+  }
+}
+
+// copy the constant and the ones it is computed from
+void collectConstant(const Parser &p, uint32_t id, ::std::unordered_map<uint32_t, vuml::reflect::ConstantExpr> &dst) {
+  auto c = p.constants.find(id);
+  if (c == p.constants.end() || dst.count(id) != 0) { return; }
+  auto expr = vuml::reflect::ConstantExpr{};
+  expr.op = c->second.op;
+  expr.value = c->second.value;
+  if (c->second.spec && c->second.op == 0) { expr.spec_id = p.decoration(id).spec_id; }
+  const auto *t = p.type(c->second.type);
+  if (t != nullptr && t->op == kOpTypeInt) {
+    expr.width = t->width;
+    expr.is_signed = t->is_signed;
+  }
+  if (expr.op == kOpCompositeExtract && !c->second.constituents.empty()) {
+    // the composite is an id, the indexes are literals
+    expr.operands = {c->second.constituents[0]};
+    expr.indexes.assign(c->second.constituents.begin() + 1, c->second.constituents.end());
+  } else {
+    expr.operands = c->second.constituents;
+  }
+  dst.emplace(id, expr);
+  for (auto operand : expr.operands) {
+    collectConstant(p, operand, dst);
+  }
+}
+
+uint64_t truncate(uint64_t value, uint32_t width) {
+  return width == 0 || width >= 64 ? value : value & ((uint64_t{1} << width) - 1);
+}
+
+int64_t signExtend(uint64_t value, uint32_t width) {
+  if (width == 0 || width >= 64) { return static_cast<int64_t>(value); }
+  auto sign = uint64_t{1} << (width - 1);
+  return static_cast<int64_t>((truncate(value, width) ^ sign) - sign);
+}
+
+// the value of a constant with the spec values of a pipeline, nothing for operations it does not know
+class Evaluator {
+ public:
+  const ::std::unordered_map<uint32_t, vuml::reflect::ConstantExpr> &constants;
+  const vk::SpecializationInfo *spec;
+
+  [[nodiscard]] ::std::optional<uint64_t> value(uint32_t id, uint32_t depth = 0) const {
+    auto it = constants.find(id);
+    // ids are defined before they are used, deeper chains come from a malformed module
+    if (it == constants.end() || depth > 64) { return ::std::nullopt; }
+    const auto &c = it->second;
+    if (c.op == kOpCompositeExtract) {
+      return extract(c, depth);
+    }
+    if (c.op == 0) {
+      // a composite has no scalar value, only its constituents
+      if (!c.operands.empty()) { return ::std::nullopt; }
+      auto specialized = c.spec_id != -1U ? specValue(c.spec_id) : ::std::nullopt;
+      return truncate(specialized.value_or(c.value), c.width);
+    }
+    auto operands = ::std::vector<uint64_t>{};
+    for (auto operand : c.operands) {
+      auto v = value(operand, depth + 1);
+      if (!v) { return ::std::nullopt; }
+      operands.push_back(*v);
+    }
+    auto result = apply(c, operands);
+    return result ? ::std::optional<uint64_t>(truncate(*result, c.width)) : ::std::nullopt;
+  }
+
+ private:
+  // e.g. gl_WorkGroupSize.x, a constituent of the WorkgroupSize composite
+  [[nodiscard]] ::std::optional<uint64_t> extract(const vuml::reflect::ConstantExpr &c, uint32_t depth) const {
+    if (c.operands.size() != 1) { return ::std::nullopt; }
+    auto id = c.operands[0];
+    for (auto index : c.indexes) {
+      auto it = constants.find(id);
+      if (it == constants.end() || it->second.op != 0 || index >= it->second.operands.size()) {
+        return ::std::nullopt;
+      }
+      id = it->second.operands[index];
+    }
+    auto v = value(id, depth + 1);
+    return v ? ::std::optional<uint64_t>(truncate(*v, c.width)) : ::std::nullopt;
+  }
+
+  // the host and the device are little endian, a value narrower than 8 bytes is the low bytes
+  [[nodiscard]] ::std::optional<uint64_t> specValue(uint32_t spec_id) const {
+    if (spec == nullptr) { return ::std::nullopt; }
+    for (uint32_t i = 0; i < spec->mapEntryCount; ++i) {
+      const auto &entry = spec->pMapEntries[i];
+      if (entry.constantID != spec_id || entry.offset + entry.size > spec->dataSize) { continue; }
+      uint64_t v = 0;
+      ::std::memcpy(&v,
+                    static_cast<const uint8_t *>(spec->pData) + entry.offset,
+                    ::std::min<::std::size_t>(entry.size, sizeof(v)));
+      return v;
+    }
+    return ::std::nullopt;
+  }
+
+  [[nodiscard]] ::std::optional<uint64_t> apply(const vuml::reflect::ConstantExpr &c,
+                                                const ::std::vector<uint64_t> &x) const {
+    auto width_of = [&](::std::size_t i) {
+      auto it = constants.find(c.operands[i]);
+      return it == constants.end() ? c.width : it->second.width;
+    };
+    auto s = [&](::std::size_t i) { return signExtend(x[i], width_of(i)); };
+    if (c.op == kOpSelect) {
+      if (x.size() != 3) { return ::std::nullopt; }
+      return x[0] != 0 ? x[1] : x[2];
+    }
+    if (c.op == kOpUConvert || c.op == kOpSConvert || c.op == kOpSNegate) {
+      if (x.size() != 1) { return ::std::nullopt; }
+      if (c.op == kOpUConvert) { return x[0]; }
+      return c.op == kOpSConvert ? static_cast<uint64_t>(s(0)) : 0 - static_cast<uint64_t>(s(0));
+    }
+    if (x.size() != 2) { return ::std::nullopt; }
+    switch (c.op) {
+      case kOpIAdd:return x[0] + x[1];
+      case kOpISub:return x[0] - x[1];
+      case kOpIMul:return x[0] * x[1];
+      case kOpUDiv:return x[1] == 0 ? ::std::nullopt : ::std::optional<uint64_t>(x[0] / x[1]);
+      case kOpUMod:return x[1] == 0 ? ::std::nullopt : ::std::optional<uint64_t>(x[0] % x[1]);
+      case kOpSDiv:
+      case kOpSRem:
+      case kOpSMod: {
+        auto a = s(0), b = s(1);
+        if (b == 0) { return ::std::nullopt; }
+        if (b == -1) { return c.op == kOpSDiv ? 0 - static_cast<uint64_t>(a) : 0; }
+        if (c.op == kOpSDiv) { return static_cast<uint64_t>(a / b); }
+        auto r = a % b;
+        // SMod takes the sign of the divisor, SRem the one of the dividend
+        if (c.op == kOpSMod && r != 0 && (r < 0) != (b < 0)) { r += b; }
+        return static_cast<uint64_t>(r);
+      }
+      case kOpShiftLeftLogical:return x[1] >= 64 ? 0 : x[0] << x[1];
+      case kOpShiftRightLogical:return x[1] >= 64 ? 0 : truncate(x[0], width_of(0)) >> x[1];
+      case kOpShiftRightArithmetic:return static_cast<uint64_t>(s(0) >> ::std::min<uint64_t>(x[1], 63));
+      case kOpBitwiseOr:return x[0] | x[1];
+      case kOpBitwiseXor:return x[0] ^ x[1];
+      case kOpBitwiseAnd:return x[0] & x[1];
+      default:return ::std::nullopt;
+    }
+  }
+};
+
+} // namespace
+
+namespace vuml::reflect {
+
+ShaderInfo::ShaderInfo(const uint32_t *spirv, ::std::size_t size) {
+  if (size % sizeof(uint32_t) != 0) {
+    fail("invalid SPIR-V module: size " + ::std::to_string(size) + " is not a multiple of 4");
+  }
+  auto p = Parser(spirv, size / sizeof(uint32_t));
+
+  capabilities_ = p.capabilities;
+
+  for (const auto &[id, var] : p.variables) {
+    const auto *ptr = p.type(var.type);
+    if (ptr == nullptr) { continue; }
+    auto pointee_id = ptr->element;
+
+    if (var.storage == kStorageWorkgroup) {
+      auto shared = SharedVariable{};
+      const auto *t = p.type(pointee_id);
+      while (t != nullptr && t->op == kOpTypeArray) {
+        shared.lengths.push_back(t->length_id);
+        collectConstant(p, t->length_id, constants_);
+        pointee_id = t->element;
+        t = p.type(pointee_id);
+      }
+      shared.element_size = p.packedSizeOf(pointee_id);
+      shared.counted = ::std::all_of(shared.lengths.begin(), shared.lengths.end(), [&](uint32_t length) {
+        return Evaluator{constants_, nullptr}.value(length).has_value();
+      });
+      if (!shared.counted) {
+        WARN("a workgroup array length is computed by an unsupported constant operation, the array is not counted");
+      }
+      shared_.push_back(::std::move(shared));
+      continue;
+    }
+    if (var.storage == kStoragePushConstant) {
+      has_push_constants_ = true;
+      push_constant_size_ = p.sizeOf(pointee_id);
+      continue;
+    }
+    if (var.storage != kStorageUniform && var.storage != kStorageStorageBuffer
+        && var.storage != kStorageUniformConstant) {
+      continue;
+    }
+
+    auto dec = p.decoration(id);
+    if (!dec.has_binding) { continue; }
+
+    auto b = Binding{};
+    b.set = dec.set;
+    b.binding = dec.binding;
+
+    // arrays of descriptors
+    const auto *t = p.type(pointee_id);
+    if (t != nullptr && t->op == kOpTypeArray) {
+      auto c = p.constants.find(t->length_id);
+      b.count = c == p.constants.end() ? 1 : static_cast<uint32_t>(c->second.value);
+      pointee_id = t->element;
+      t = p.type(pointee_id);
+    }
+    if (t == nullptr) { continue; }
+
+    auto block_dec = p.decoration(pointee_id);
+    switch (t->op) {
+      case kOpTypeStruct: {
+        auto storage = var.storage == kStorageStorageBuffer || block_dec.buffer_block;
+        b.type = storage ? vk::DescriptorType::eStorageBuffer : vk::DescriptorType::eUniformBuffer;
+        // glslang puts readonly / writeonly on every member of the block
+        auto md = p.member_decorations.find(pointee_id);
+        auto all_members = [&](auto &&pred) {
+          return md != p.member_decorations.end() && md->second.size() == t->members.size()
+              && ::std::all_of(md->second.begin(), md->second.end(), pred);
+        };
+        b.writable = storage && !dec.non_writable
+            && !all_members([](const MemberDecoration &m) { return m.non_writable; });
+        b.readable = !dec.non_readable && !all_members([](const MemberDecoration &m) { return m.non_readable; });
+        break;
+      }
+      case kOpTypeImage:
+        if (t->dim == kImageDimBuffer) {
+          b.type = t->sampled == 2 ? vk::DescriptorType::eStorageTexelBuffer
+                                   : vk::DescriptorType::eUniformTexelBuffer;
+        } else {
+          b.type = t->sampled == 2 ? vk::DescriptorType::eStorageImage : vk::DescriptorType::eSampledImage;
+        }
+        b.writable = t->sampled == 2 && !dec.non_writable;
+        b.readable = !dec.non_readable;
+        break;
+      case kOpTypeSampledImage:b.type = vk::DescriptorType::eCombinedImageSampler;
+        b.writable = false;
+        break;
+      case kOpTypeSampler:b.type = vk::DescriptorType::eSampler;
+        b.writable = false;
+        break;
+      default:continue;
+    }
+    bindings_.push_back(b);
+  }
+  ::std::sort(bindings_.begin(), bindings_.end(), [](const Binding &l, const Binding &r) {
+    return l.set != r.set ? l.set < r.set : l.binding < r.binding;
+  });
+
+  for (const auto &[id, c] : p.constants) {
+    auto dec = p.decoration(id);
+    if (!c.spec || dec.spec_id == -1U || !c.constituents.empty()) { continue; }
+    const auto *t = p.type(c.type);
+    auto kind = scalarKind(t);
+    // booleans are passed as VkBool32
+    auto size = kind == Scalar::eBool ? 4u : p.sizeOf(c.type);
+    spec_constants_.push_back({dec.spec_id, size, kind, c.value});
+  }
+  ::std::sort(spec_constants_.begin(), spec_constants_.end(), [](const SpecConstant &l, const SpecConstant &r) {
+    return l.id < r.id;
+  });
+
+  for (::std::size_t i = 0; i < 3; ++i) {
+    local_size_[i].value = p.local_size[i];
+  }
+  auto local_size_from_ids = [&](const ::std::array<uint32_t, 3> &ids) {
+    for (::std::size_t i = 0; i < 3; ++i) {
+      auto c = p.constants.find(ids[i]);
+      if (c == p.constants.end()) { continue; }
+      local_size_[i].value = static_cast<uint32_t>(c->second.value);
+      if (c->second.spec) { local_size_[i].spec_id = p.decoration(ids[i]).spec_id; }
+    }
+  };
+  if (p.local_size_ids != ::std::array<uint32_t, 3>{0, 0, 0}) {
+    local_size_from_ids(p.local_size_ids);
+  }
+  // `layout(local_size_x_id = ...)` is lowered to a WorkgroupSize built-in which takes precedence
+  for (const auto &[id, c] : p.constants) {
+    if (p.decoration(id).builtin == kBuiltInWorkgroupSize && c.constituents.size() == 3) {
+      local_size_from_ids({c.constituents[0], c.constituents[1], c.constituents[2]});
+    }
+  }
+}
+
+const Binding *ShaderInfo::findBinding(uint32_t binding, uint32_t set) const {
+  auto it = ::std::find_if(bindings_.begin(), bindings_.end(), [&](const Binding &b) {
+    return b.set == set && b.binding == binding;
+  });
+  return it == bindings_.end() ? nullptr : &*it;
+}
+
+const SpecConstant *ShaderInfo::findSpecConstant(uint32_t id) const {
+  auto it = ::std::find_if(spec_constants_.begin(), spec_constants_.end(), [&](const SpecConstant &s) {
+    return s.id == id;
+  });
+  return it == spec_constants_.end() ? nullptr : &*it;
+}
+
+uint64_t ShaderInfo::sharedMemorySize(const vk::SpecializationInfo *spec) const {
+  auto evaluator = Evaluator{constants_, spec};
+  uint64_t total = 0;
+  for (const auto &shared : shared_) {
+    if (!shared.counted) { continue; }
+    uint64_t size = shared.element_size;
+    for (auto id : shared.lengths) {
+      auto length = evaluator.value(id);
+      // a division by zero with these spec values, the pipeline fails to compile anyway
+      if (!length) {
+        size = 0;
+        break;
+      }
+      size *= *length;
+    }
+    total += size;
+  }
+  return total;
+}
+
+void ShaderInfo::validateArguments(const vk::DescriptorType *types, ::std::size_t n) const {
+  auto declared = static_cast<::std::size_t>(::std::count_if(bindings_.begin(), bindings_.end(), [](const Binding &b) {
+    return b.set == 0;
+  }));
+  if (declared != n) {
+    fail("shader declares " + ::std::to_string(declared) + " bindings but " + ::std::to_string(n)
+             + " arguments were given");
+  }
+  for (uint32_t i = 0; i < n; ++i) {
+    const auto *b = findBinding(i);
+    if (b == nullptr) {
+      fail("shader has no binding " + ::std::to_string(i) + ", bindings must be numbered from 0 without gaps");
+    }
+    if (b->type != types[i]) {
+      fail("argument " + ::std::to_string(i) + " is a " + vk::to_string(types[i]) + " but the shader expects a "
+               + vk::to_string(b->type));
+    }
+  }
+}
+
+void ShaderInfo::validatePushConstants(::std::size_t size) const {
+  if (size == 0 && has_push_constants_) {
+    fail("shader declares a push constant block of " + ::std::to_string(push_constant_size_)
+             + " bytes but the program has no parameters");
+  }
+  if (size != 0 && !has_push_constants_) {
+    fail("program has parameters of " + ::std::to_string(size) + " bytes but the shader has no push constant block");
+  }
+  if (size < push_constant_size_) {
+    fail("parameters are " + ::std::to_string(size) + " bytes but the shader push constant block is "
+             + ::std::to_string(push_constant_size_) + " bytes");
+  }
+}
+
+void ShaderInfo::validateSpecConstants(const ::std::size_t *sizes, ::std::size_t n) const {
+  for (uint32_t i = 0; i < n; ++i) {
+    const auto *s = findSpecConstant(i);
+    if (s == nullptr) {
+      WARN("specialization constant %u is not used by the shader", i);
+      continue;
+    }
+    if (s->size != sizes[i]) {
+      fail("specialization constant " + ::std::to_string(i) + " is " + ::std::to_string(sizes[i])
+               + " bytes but the shader expects " + ::std::to_string(s->size) + " bytes");
+    }
+  }
+}
+
+} // namespace vuml::reflect
@@ -0,0 +1,58 @@
+//
+// Created by Homin Su on 2023/7/10.
+//
+
+#include "vuml/shaders.h"
+
+#include <cstring>
+
+#include <exception>
+#include <stdexcept>
+#include <string>
+
+#include "vuml/logger.h"
+#include "vuml/utils.h"
+
+namespace vuml::shaders {
+
+namespace {
+
+::std::vector<Shader> &registry() {
+  static ::std::vector<Shader> shaders;
+  return shaders;
+}
+
+} // namespace
+
+const Shader *find(const char *name) {
+  for (const auto &shader : registry()) {
+    if (::std::strcmp(shader.name, name) == 0) {
+      return &shader;
+    }
+  }
+  return nullptr;
+}
+
+const Shader &get(const char *name) {
+  auto shader = find(name);
+  if (shader == nullptr) {
+    ERROR("no embedded shader %s", name);
+    throw ::std::runtime_error(::std::string("no embedded shader ") + name);
+  }
+  return *shader;
+}
+
+const ::std::vector<Shader> &all() {
+  return registry();
+}
+
+Registration::Registration(const char *name, const uint32_t *code, ::std::size_t size) {
+  validate_spirv(code, size, name);
+  if (find(name) != nullptr) {
+    ERROR("embedded shader %s is defined twice", name);
+    throw ::std::runtime_error(::std::string("embedded shader defined twice: ") + name);
+  }
+  registry().push_back({name, code, size});
+}
+
+} // namespace vuml::shaders
@@ -0,0 +1,65 @@
+//
+// Created by Homin Su on 2023/7/11.
+//
+
+#include "vuml/thread_pool.h"
+
+#include <algorithm>
+
+namespace vuml {
+
+namespace {
+
+thread_local bool on_worker = false;
+
+} // namespace
+
+ThreadPool::ThreadPool(::std::size_t threads) {
+  if (threads == 0) {
+    threads = ::std::max(1u, ::std::thread::hardware_concurrency());
+  }
+  workers_.reserve(threads);
+  for (::std::size_t i = 0; i < threads; ++i) {
+    workers_.emplace_back(&ThreadPool::loop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() noexcept {
+  {
+    ::std::lock_guard<::std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+ThreadPool &ThreadPool::global() {
+  static ThreadPool pool;
+  return pool;
+}
+
+bool ThreadPool::onWorker() {
+  return on_worker;
+}
+
+void ThreadPool::loop() {
+  on_worker = true;
+  for (;;) {
+    auto task = ::std::function<void()>{};
+    {
+      auto lock = ::std::unique_lock<::std::mutex>(mutex_);
+      cv_.wait(lock, [&] { return stop_ || !tasks_.empty(); });
+      // queued tasks still run on shutdown, their futures may be waited on
+      if (tasks_.empty()) {
+        return;
+      }
+      task = ::std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+} // namespace vuml
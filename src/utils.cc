@@ -12,39 +12,265 @@
 #include <string>
 
 #include "vuml/logger.h"
+#include "vuml/vuml.h"
+
+#if !VUML_WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace vuml {
+
+void validate_spirv(const uint32_t *code, ::std::size_t size_bytes, const char *name) {
+  if (size_bytes < 5 * sizeof(uint32_t) || size_bytes % sizeof(uint32_t) != 0) {
+    ERROR("%s is not a SPIR-V module: size %zu", name, size_bytes);
+    throw ::std::runtime_error(::std::string(name) + " is not a SPIR-V module: bad size");
+  }
+  if (code[0] != spirv_magic) {
+    ERROR("%s is not a SPIR-V module: magic number 0x%08x", name, code[0]);
+    throw ::std::runtime_error(::std::string(name) + " is not a SPIR-V module: bad magic number");
+  }
+}
+
 ::std::vector<uint32_t> read_spirv(const char *filename) {
-  auto f = ::std::ifstream(filename, ::std::ios::binary | ::std::ios::ate);
-  if (!f.is_open()) {
-    ERROR("open %s failed", filename);
-    throw ::std::runtime_error(::std::string("open ") + filename + "failed");
+  auto file = SpirvFile(filename);
+  return {file.data(), file.data() + file.size() / sizeof(uint32_t)};
+}
+
+SpirvFile::SpirvFile(const char *filename) {
+#if !VUML_WINDOWS
+  auto fd = ::open(filename, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    SYSERR("open %s failed", filename);
+    throw ::std::runtime_error(::std::string("open ") + filename + " failed");
+  }
+  struct stat st{};
+  if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+    size_ = static_cast<::std::size_t>(st.st_size);
+    auto addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED) {
+      mapping_ = addr;
+      code_ = static_cast<const uint32_t *>(addr);
+    }
+  }
+  ::close(fd);
+#endif
+  if (mapping_ == nullptr) {
+    // not a regular file, or no mmap: read it at once
+    auto f = ::std::ifstream(filename, ::std::ios::binary | ::std::ios::ate);
+    if (!f.is_open()) {
+      ERROR("open %s failed", filename);
+      throw ::std::runtime_error(::std::string("open ") + filename + " failed");
+    }
+    size_ = static_cast<::std::size_t>(f.tellg());
+    f.seekg(0);
+    buffer_.resize((size_ + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+    f.read(reinterpret_cast<char *>(buffer_.data()), static_cast<::std::streamsize>(size_));
+    code_ = buffer_.data();
+  }
+  try {
+    validate_spirv(code_, size_, filename);
+  } catch (::std::runtime_error &) {
+    release();
+    throw;
   }
-  const auto size = static_cast<uint32_t>(f.tellg());
-  f.seekg(0);
+}
+
+SpirvFile::~SpirvFile() noexcept { release(); }
+
+SpirvFile::SpirvFile(SpirvFile &&other) noexcept
+    : code_(other.code_), size_(other.size_), mapping_(other.mapping_), buffer_(::std::move(other.buffer_)) {
+  other.code_ = nullptr;
+  other.size_ = 0;
+  other.mapping_ = nullptr;
+}
+
+SpirvFile &SpirvFile::operator=(SpirvFile &&other) noexcept {
+  release();
+  code_ = other.code_;
+  size_ = other.size_;
+  mapping_ = other.mapping_;
+  buffer_ = ::std::move(other.buffer_);
+  other.code_ = nullptr;
+  other.size_ = 0;
+  other.mapping_ = nullptr;
+  return *this;
+}
 
-  auto ret = ::std::vector<uint32_t>((size + 3) / 4, 0);  // align to 4 bytes
-  ::std::copy(::std::istreambuf_iterator<char>(f),
-              ::std::istreambuf_iterator<char>(),
-              reinterpret_cast<char *>(ret.data()));
-  return ret;
+void SpirvFile::release() noexcept {
+#if !VUML_WINDOWS
+  if (mapping_ != nullptr) {
+    ::munmap(mapping_, size_);
+  }
+#endif
+  mapping_ = nullptr;
+  code_ = nullptr;
+  size_ = 0;
+  buffer_.clear();
 }
 
 namespace array {
 
+namespace {
+
+template<typename F>
+SyncPoint submit_transfer(Device &device, const ::std::vector<SyncPoint> &waits, F &&record) {
+  // waits only when the copy submitted a ring ago still holds the command buffer
+  auto cmd_buffer = device.nextTransferCmdBuffer();
+  cmd_buffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+  record(cmd_buffer);
+  cmd_buffer.end();
+  return device.submitTransfer(cmd_buffer, waits);
+}
+
+SyncPoint submit_copy(Device &device,
+                      vk::Buffer src,
+                      vk::Buffer dst,
+                      ::std::size_t size_bytes,
+                      ::std::size_t src_offset,
+                      ::std::size_t dst_offset,
+                      const ::std::vector<SyncPoint> &waits) {
+  return submit_transfer(device, waits, [&](vk::CommandBuffer cmd_buffer) {
+    cmd_buffer.copyBuffer(src, dst, vk::BufferCopy(src_offset, dst_offset, size_bytes));
+    // the buffers are not known here, dst may be a mapped staging buffer
+    host_read_barrier(cmd_buffer, dst, dst_offset, size_bytes);
+  });
+}
+
+// texels tightly packed in the buffer, the whole first layer of the image
+vk::BufferImageCopy image_copy(vk::Extent3D extent, ::std::size_t buffer_offset) {
+  return {
+      buffer_offset,
+      0,
+      0,
+      vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
+      vk::Offset3D(0, 0, 0),
+      extent
+  };
+}
+
+} // namespace
+
+void host_read_barrier(vk::CommandBuffer cmd_buffer, vk::Buffer dst, vk::DeviceSize offset, vk::DeviceSize size) {
+  auto barrier = vk::BufferMemoryBarrier(vk::AccessFlagBits::eTransferWrite,
+                                         vk::AccessFlagBits::eHostRead,
+                                         VK_QUEUE_FAMILY_IGNORED,
+                                         VK_QUEUE_FAMILY_IGNORED,
+                                         dst,
+                                         offset,
+                                         size);
+  cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                             vk::PipelineStageFlagBits::eHost,
+                             {},
+                             {},
+                             barrier,
+                             {});
+}
+
 void copy_buf(Device &device,
               vk::Buffer src,
               vk::Buffer dst,
               ::std::size_t size_bytes,
               ::std::size_t src_offset,
               ::std::size_t dst_offset) {
-  auto cmd_buffer = device.transferCmdBuffer();
-  cmd_buffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
-  cmd_buffer.copyBuffer(src, dst, vk::BufferCopy(src_offset, dst_offset, size_bytes));
-  cmd_buffer.end();
-  auto queue = device.transferQueue();
-  queue.submit(vk::SubmitInfo(0, nullptr, nullptr, 1, &cmd_buffer), nullptr);
-  queue.waitIdle();
+  // nothing is known about the buffers, so wait for every dispatch submitted so far
+  auto waits = ::std::vector<SyncPoint>{device.lastSubmit(QueueKind::eCompute)};
+  device.wait(submit_copy(device, src, dst, size_bytes, src_offset, dst_offset, waits));
+}
+
+SyncPoint copy_buf(Device &device,
+                   vk::Buffer src,
+                   Hazards &src_hazards,
+                   vk::Buffer dst,
+                   Hazards &dst_hazards,
+                   ::std::size_t size_bytes,
+                   ::std::size_t src_offset,
+                   ::std::size_t dst_offset) {
+  auto waits = ::std::vector<SyncPoint>{};
+  src_hazards.readDependencies(waits);
+  dst_hazards.writeDependencies(waits);
+  auto point = submit_copy(device, src, dst, size_bytes, src_offset, dst_offset, waits);
+  src_hazards.read(point, QueueKind::eTransfer);
+  dst_hazards.write(point);
+  return point;
+}
+
+SyncPoint fill_buf(Device &device,
+                   vk::Buffer dst,
+                   Hazards &dst_hazards,
+                   uint32_t value,
+                   ::std::size_t size_bytes,
+                   ::std::size_t dst_offset) {
+  auto waits = ::std::vector<SyncPoint>{};
+  dst_hazards.writeDependencies(waits);
+  auto point = submit_transfer(device, waits, [&](vk::CommandBuffer cmd_buffer) {
+    cmd_buffer.fillBuffer(dst, dst_offset, size_bytes, value);
+  });
+  dst_hazards.write(point);
+  return point;
+}
+
+SyncPoint init_image_layout(Device &device, vk::Image image, Hazards &hazards) {
+  auto waits = ::std::vector<SyncPoint>{};
+  hazards.writeDependencies(waits);
+  auto point = submit_transfer(device, waits, [&](vk::CommandBuffer cmd_buffer) {
+    auto barrier = vk::ImageMemoryBarrier({},
+                                          vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite,
+                                          vk::ImageLayout::eUndefined,
+                                          vk::ImageLayout::eGeneral,
+                                          VK_QUEUE_FAMILY_IGNORED,
+                                          VK_QUEUE_FAMILY_IGNORED,
+                                          image,
+                                          vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+    cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+                               vk::PipelineStageFlagBits::eTransfer,
+                               {},
+                               {},
+                               {},
+                               barrier);
+  });
+  // the content is undefined, but later accesses must not overtake the transition
+  hazards.write(point);
+  return point;
+}
+
+SyncPoint copy_buf_to_image(Device &device,
+                            vk::Buffer src,
+                            Hazards &src_hazards,
+                            vk::Image dst,
+                            Hazards &dst_hazards,
+                            vk::Extent3D extent,
+                            ::std::size_t src_offset) {
+  auto waits = ::std::vector<SyncPoint>{};
+  src_hazards.readDependencies(waits);
+  dst_hazards.writeDependencies(waits);
+  auto point = submit_transfer(device, waits, [&](vk::CommandBuffer cmd_buffer) {
+    cmd_buffer.copyBufferToImage(src, dst, vk::ImageLayout::eGeneral, image_copy(extent, src_offset));
+  });
+  src_hazards.read(point, QueueKind::eTransfer);
+  dst_hazards.write(point);
+  return point;
+}
+
+SyncPoint copy_image_to_buf(Device &device,
+                            vk::Image src,
+                            Hazards &src_hazards,
+                            vk::Buffer dst,
+                            Hazards &dst_hazards,
+                            vk::Extent3D extent,
+                            ::std::size_t dst_offset) {
+  auto waits = ::std::vector<SyncPoint>{};
+  src_hazards.readDependencies(waits);
+  dst_hazards.writeDependencies(waits);
+  auto point = submit_transfer(device, waits, [&](vk::CommandBuffer cmd_buffer) {
+    cmd_buffer.copyImageToBuffer(src, vk::ImageLayout::eGeneral, dst, image_copy(extent, dst_offset));
+    host_read_barrier(cmd_buffer, dst, dst_offset);
+  });
+  src_hazards.read(point, QueueKind::eTransfer);
+  dst_hazards.write(point);
+  return point;
 }
 
 } // namespace array